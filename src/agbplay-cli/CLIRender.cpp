@@ -1,19 +1,36 @@
 #include "CLIRender.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <csignal>
 #include <cstdint>
+#include <cstdio>
+#include <exception>
 #include <filesystem>
 #include <format>
+#include <fstream>
 #include <limits>
+#include <map>
+#include <span>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <tuple>
 #include <vector>
 #include <fmt/core.h>
+#include <nlohmann/json.hpp>
+#include <zlib.h>
 
+#include "OS.hpp"
 #include "ProfileManager.hpp"
 #include "Rom.hpp"
 #include "Settings.hpp"
 #include "SoundExporter.hpp"
+#include "Util.hpp"
+#include "Version.hpp"
 #include "Xcept.hpp"
 
 static std::vector<std::string_view> Split(const std::string &input, const std::string &sep)
@@ -36,57 +53,390 @@ static std::vector<std::string_view> Split(const std::string &input, const std::
     }
 }
 
-void CLI::Render(const std::string &songId, const std::string &outputPath, bool stems)
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void InterruptHandler(int)
 {
-    std::vector<std::string_view> songIds = Split(songId, ";");
-    std::vector<std::string_view> outputPaths = Split(outputPath, ";");
+    interrupted = 1;
+}
 
-    if (songIds.size() == 0)
+static void PrintProgress(FILE *stream, const ExportProgress &progress)
+{
+    if (progress.IsEstimating()) {
+        fmt::print(stream, "Estimating song lengths...\n");
         return;
+    }
 
-    if (outputPath.size() == 0)
-        throw Xcept("Cannot render to file. Output path is blank.");
+    std::string remaining;
+    if (progress.secondsRemaining >= 0.0) {
+        const auto secondsRemaining = static_cast<unsigned int>(std::ceil(progress.secondsRemaining));
+        remaining = fmt::format(", {}:{:02} remaining", secondsRemaining / 60, secondsRemaining % 60);
+    }
 
-    std::vector<uint16_t> songIdsParsed;
-    std::vector<std::filesystem::path> outputPathsParsed;
+    fmt::print(
+        stream,
+        "{:3}% - {} of {} songs done{}\n",
+        static_cast<unsigned int>(progress.GetFraction() * 100.0),
+        progress.songsDone,
+        progress.songs.size(),
+        remaining
+    );
+}
+
+struct RenderJob
+{
+    uint16_t id;
+    std::string name;
+    std::filesystem::path outputPath;
+};
+
+static uint16_t CheckSongId(long long id)
+{
+    if (id < std::numeric_limits<uint16_t>::min() || id > std::numeric_limits<uint16_t>::max())
+        throw Xcept("Cannot render song ID, which is not a 16 bit value");
+    return static_cast<uint16_t>(id);
+}
+
+static uint16_t ParseSongId(std::string_view songId)
+{
+    return CheckSongId(std::stoll(std::string(songId)));
+}
+
+/* A job file lists the songs to render:
+ * { "songs": [ { "id": 1, "name": "Title", "output": "path/%SONGID%.wav" }, ... ] }
+ * "name" and "output" are optional, the output path of the command line is used by default. */
+static std::vector<RenderJob> LoadJobFile(const std::filesystem::path &filePath, std::string_view defaultOutputPath)
+{
+    using nlohmann::json;
+
+    std::ifstream ifs(filePath);
+    if (!ifs.is_open())
+        throw Xcept("Failed to open job file: {}", filePath.string());
+
+    const json j = json::parse(ifs, nullptr, false);
+    if (!j.is_object() || !j.contains("songs") || !j["songs"].is_array())
+        throw Xcept("Job file does not contain a song list: {}", filePath.string());
 
-    // Parse song IDs
-    for (size_t i = 0; i < songIds.size(); i++) {
-        long long id = std::stoll(std::string(songIds.at(i)));
-        if (id < std::numeric_limits<uint16_t>::min() || id > std::numeric_limits<uint16_t>::max())
+    std::vector<RenderJob> jobs;
+    for (const json &jsong : j["songs"]) {
+        if (!jsong.is_object() || !jsong.contains("id") || !jsong["id"].is_number_integer())
+            throw Xcept("Job file contains a song without a valid ID: {}", filePath.string());
+
+        /* IDs beyond the range of long long are rejected as well */
+        const json &jid = jsong["id"];
+        if (jid.is_number_unsigned() && jid.get<unsigned long long>() > std::numeric_limits<uint16_t>::max())
             throw Xcept("Cannot render song ID, which is not a 16 bit value");
-        songIdsParsed.emplace_back(static_cast<uint16_t>(id));
+        RenderJob &job = jobs.emplace_back(CheckSongId(jid.get<long long>()), "unnamed song", "");
+        if (jsong.contains("name") && jsong["name"].is_string())
+            job.name = jsong["name"];
+        if (jsong.contains("output") && jsong["output"].is_string())
+            job.outputPath = StrToU8Str(jsong["output"].get<std::string>());
+        else
+            job.outputPath = std::filesystem::path(defaultOutputPath);
     }
+    return jobs;
+}
 
-    // Parse output paths
-    if (outputPaths.size() == 1) {
-        // assert outputPath must be a pattern
-        if (songIdsParsed.size() > 1 && outputPaths.back().find(SoundExporter::SONG_ID_PATTERN.string()) == outputPaths.back().npos)
-            throw Xcept("Single output path for multiple songs must contain a pattern {}", SoundExporter::SONG_ID_PATTERN.string());
+/* "i/N" with 0 <= i < N */
+static void ParseShard(const std::string &shard, size_t &index, size_t &count)
+{
+    const size_t sep = shard.find('/');
+    try {
+        if (sep == std::string::npos)
+            throw std::invalid_argument(shard);
+        index = std::stoull(shard.substr(0, sep));
+        count = std::stoull(shard.substr(sep + 1));
+    } catch (const std::exception &) {
+        throw Xcept("Invalid shard: {}, expected i/N", shard);
+    }
+    if (count == 0 || index >= count)
+        throw Xcept("Invalid shard: {}, the index has to be less than the shard count", shard);
+}
 
-        for (size_t i = 0; i < songIds.size(); i++)
-            outputPathsParsed.emplace_back(outputPaths.back());
-    } else if (outputPaths.size() == songIds.size()) {
-        for (size_t i = 0; i < songIds.size(); i++)
-            outputPathsParsed.emplace_back(outputPaths.at(i));
-    } else {
-        throw Xcept("Song ID count ({}) output path count ({}) mismatch.", songIds.size(), outputPaths.size());
+/* CRC-32 of the file content */
+static uint32_t HashFile(const std::filesystem::path &filePath)
+{
+    std::ifstream ifs(filePath, std::ios::binary);
+    if (!ifs.is_open())
+        throw Xcept("Failed to open file for hashing: {}", filePath.string());
+
+    uLong crc = crc32_z(0, nullptr, 0);
+    std::vector<char> buffer(1024 * 1024);
+    while (ifs) {
+        ifs.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        const size_t n = static_cast<size_t>(ifs.gcount());
+        crc = crc32_z(crc, reinterpret_cast<const Bytef *>(buffer.data()), n);
+    }
+    if (ifs.bad())
+        throw Xcept("Failed to read file for hashing: {}", filePath.string());
+    return static_cast<uint32_t>(crc);
+}
+
+static const char *SongStateName(ExportProgress::SongState state)
+{
+    switch (state) {
+    case ExportProgress::SongState::QUEUED:
+        return "queued";
+    case ExportProgress::SongState::RENDERING:
+        return "rendering";
+    case ExportProgress::SongState::DONE:
+        return "done";
+    case ExportProgress::SongState::SKIPPED:
+        return "skipped";
+    case ExportProgress::SongState::FAILED:
+        return "failed";
+    case ExportProgress::SongState::CANCELLED:
+        return "cancelled";
+    }
+    return "unknown";
+}
+
+/* Writes the result manifest of a shard. Songs are sorted by ID, so the manifests of all shards can be merged
+ * by simply concatenating their song lists. */
+static void SaveResults(
+    const std::filesystem::path &filePath,
+    size_t shardIndex,
+    size_t shardCount,
+    const Settings &settings,
+    std::span<const RenderJob> jobs,
+    std::span<const ExportResult> results,
+    double seconds
+)
+{
+    using nlohmann::json;
+
+    auto pathToUtf8 = [](const std::filesystem::path &path) {
+        const std::u8string tmp = path.generic_u8string();
+        return std::string(reinterpret_cast<const char *>(tmp.data()), tmp.size());
+    };
+    /* silence is reported as -inf, which JSON cannot represent */
+    auto level = [](double value) { return std::isfinite(value) ? json(value) : json(nullptr); };
+
+    std::vector<size_t> order(results.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return std::tie(jobs[a].id, jobs[a].outputPath) < std::tie(jobs[b].id, jobs[b].outputPath);
+    });
+
+    json songs = json::array();
+    for (const size_t i : order) {
+        const ExportResult &result = results[i];
+
+        json files = json::array();
+        for (const std::filesystem::path &file : result.files) {
+            files.push_back({
+                {"path", pathToUtf8(file)},
+                {"crc32", fmt::format("{:08x}", HashFile(file))},
+            });
+        }
+
+        json song = {
+            {"id", jobs[i].id},
+            {"name", jobs[i].name},
+            {"state", SongStateName(result.state)},
+            {"files", files},
+            {"samples", result.samplesRendered},
+            {"duration", static_cast<double>(result.samplesRendered) / settings.exportSampleRate},
+            {"renderSeconds", result.secondsRendering},
+        };
+        if (result.state == ExportProgress::SongState::DONE) {
+            song["loudness"] = level(result.loudness);
+            song["truePeak"] = level(result.truePeak);
+            song["gain"] = result.gain;
+        }
+        songs.push_back(song);
     }
 
-    assert(songIds.size() == outputPathsParsed.size());
+    json j;
+    j["version"] = 1;
+    j["agbplay"] = GIT_VERSION_STRING;
+    j["rom"] = Rom::Instance().GetROMCode();
+    j["shard"] = {{"index", shardIndex}, {"count", shardCount}};
+    j["sampleRate"] = settings.exportSampleRate;
+    j["seconds"] = seconds;
+    j["songs"] = songs;
+
+    const std::string text = j.dump(2) + "\n";
+    if (!OS::WriteFileAtomic(filePath, std::span(reinterpret_cast<const uint8_t *>(text.data()), text.size())))
+        throw Xcept("Failed to write result manifest: {}", filePath.string());
+}
+
+void CLI::Render(
+    const std::string &songId,
+    const std::string &outputPath,
+    const std::string &format,
+    const std::string &normalizeLoudness,
+    const std::string &shard,
+    const std::string &resultPath,
+    bool stems,
+    bool stemsSingleFile,
+    bool incremental
+)
+{
+    std::vector<std::string_view> outputPaths = Split(outputPath, ";");
+
+    if (outputPath.size() == 0)
+        throw Xcept("Cannot render to file. Output path is blank.");
 
     ProfileManager pm;
     pm.LoadProfiles();
 
+    // Make a copy of the profile, so we don't destroy the playlist accidentally
+    Profile p = *pm.GetCLIDefaultProfile(Rom::Instance());
+
+    std::vector<RenderJob> jobs;
+    if (songId == "all") {
+        if (outputPaths.size() != 1)
+            throw Xcept("Rendering all songs requires a single output path");
+        for (size_t i = 0; i < p.songTableInfoPlayback.count; i++)
+            jobs.emplace_back(static_cast<uint16_t>(i), "unnamed song", std::filesystem::path(outputPaths.back()));
+    } else if (songId.starts_with("@")) {
+        if (outputPaths.size() != 1)
+            throw Xcept("Rendering a job file requires a single output path");
+        jobs = LoadJobFile(StrToU8Str(songId.substr(1)), outputPaths.back());
+    } else {
+        std::vector<std::string_view> songIds = Split(songId, ";");
+        if (outputPaths.size() != 1 && outputPaths.size() != songIds.size())
+            throw Xcept("Song ID count ({}) output path count ({}) mismatch.", songIds.size(), outputPaths.size());
+
+        for (size_t i = 0; i < songIds.size(); i++) {
+            const std::string_view songOutputPath = outputPaths.size() == 1 ? outputPaths.back() : outputPaths.at(i);
+            jobs.emplace_back(ParseSongId(songIds.at(i)), "unnamed song", std::filesystem::path(songOutputPath));
+        }
+    }
+
+    size_t shardIndex = 0;
+    size_t shardCount = 1;
+    if (!shard.empty()) {
+        ParseShard(shard, shardIndex, shardCount);
+        std::erase_if(jobs, [&](const RenderJob &job) {
+            return SoundExporter::GetShard(job.id, shardCount) != shardIndex;
+        });
+    }
+
+    // Output paths, which are used for multiple songs, have to contain the song ID
+    std::map<std::filesystem::path, size_t> outputPathUses;
+    for (const RenderJob &job : jobs)
+        outputPathUses[job.outputPath]++;
+    for (const auto &[path, uses] : outputPathUses) {
+        if (uses > 1 && path.string().find(SoundExporter::SONG_ID_PATTERN.string()) == std::string::npos)
+            throw Xcept(
+                "Single output path for multiple songs must contain a pattern {}",
+                SoundExporter::SONG_ID_PATTERN.string()
+            );
+    }
+
+    /* audio written to stdout must not be mixed with any other output */
+    const bool streaming = std::any_of(jobs.begin(), jobs.end(), [](const RenderJob &job) {
+        return job.outputPath == SoundExporter::STDOUT_PATH;
+    });
+    if (streaming && (jobs.size() != 1 || stems))
+        throw Xcept("Only the master mix of a single song can be rendered to stdout");
+
     Settings s;
     s.Load();
 
-    // Make a copy of the profile, so we don't destroy the playlist accidentally
-    Profile p = *pm.GetCLIDefaultProfile(Rom::Instance());
+    /* Without an explicit format, the format is chosen by the file extension and only falls back to the
+     * format from the settings if the extension is unknown. */
+    StreamFormat streamFormat = StreamFormat::WAV;
+    if (streaming) {
+        if (!format.empty()) {
+            streamFormat = str2streamFormat(format);
+            if (streamFormat2str(streamFormat) != format)
+                throw Xcept("Unknown stream format: {}", format);
+        }
+    } else if (!format.empty()) {
+        s.exportFormat = str2exportFormat(format);
+        if (exportFormat2str(s.exportFormat) != format)
+            throw Xcept("Unknown export format: {}", format);
+    } else if (!jobs.empty()) {
+        const std::string extension = jobs.front().outputPath.extension().string();
+        for (ExportFormat f : {ExportFormat::WAV, ExportFormat::FLAC, ExportFormat::VORBIS, ExportFormat::OPUS}) {
+            if (extension == "." + SoundExporter::GetFileExtension(f))
+                s.exportFormat = f;
+        }
+    }
+
+    s.exportStemsSingleFile = stemsSingleFile;
+    s.exportSkipUnchanged = incremental;
+
+    if (!normalizeLoudness.empty()) {
+        s.exportNormalize = true;
+        try {
+            s.exportNormalizeLoudness = std::stod(normalizeLoudness);
+        } catch (const std::exception &) {
+            throw Xcept("Invalid loudness: {}", normalizeLoudness);
+        }
+        if (s.exportNormalizeLoudness < -70.0 || s.exportNormalizeLoudness > 0.0)
+            throw Xcept("Loudness has to be between -70 and 0 LUFS");
+    }
+
+    const auto startTime = std::chrono::steady_clock::now();
+
+    /* An empty shard is not an error, its result manifest simply contains no songs */
+    if (jobs.empty()) {
+        if (!resultPath.empty())
+            SaveResults(StrToU8Str(resultPath), shardIndex, shardCount, s, jobs, {}, 0.0);
+        return;
+    }
+
+    std::vector<std::filesystem::path> outputPathsParsed;
     p.playlist.clear();
-    for (size_t i = 0; i < songIds.size(); i++)
-        p.playlist.emplace_back("unnamed song", songIdsParsed.at(i));
+    for (const RenderJob &job : jobs) {
+        p.playlist.emplace_back(job.name, job.id);
+        outputPathsParsed.emplace_back(job.outputPath);
+    }
+
+    SoundExporter se("", outputPathsParsed, s, p, false, stems, streamFormat);
+
+    /* Export on a separate thread, so the progress can be reported and Ctrl+C cancels the export
+     * without leaving incomplete files behind. */
+    interrupted = 0;
+    std::signal(SIGINT, InterruptHandler);
+
+    std::exception_ptr error;
+    std::atomic<bool> done = false;
+    std::thread exportThread([&]() {
+        try {
+            se.Export();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        done = true;
+    });
+
+    auto lastReport = std::chrono::steady_clock::now();
+    while (!done) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (interrupted)
+            se.Cancel();
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now - lastReport >= std::chrono::seconds(2)) {
+            lastReport = now;
+            PrintProgress(streaming ? stderr : stdout, se.GetProgress());
+        }
+    }
+
+    exportThread.join();
+    std::signal(SIGINT, SIG_DFL);
+
+    if (error)
+        std::rethrow_exception(error);
+
+    const std::vector<ExportResult> results = se.GetResults();
+    if (!resultPath.empty()) {
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        SaveResults(StrToU8Str(resultPath), shardIndex, shardCount, s, jobs, results, seconds);
+    }
 
-    SoundExporter se("", outputPathsParsed, s, p, false, stems);
-    se.Export();
+    /* the result manifest is written anyway, so the failed songs can be looked up there */
+    const auto songFailed = [](const ExportResult &result) {
+        return result.state == ExportProgress::SongState::FAILED
+            || result.state == ExportProgress::SongState::CANCELLED;
+    };
+    const size_t failed = static_cast<size_t>(std::count_if(results.begin(), results.end(), songFailed));
+    if (failed > 0)
+        throw Xcept("{} of {} songs failed or were cancelled", failed, results.size());
 }
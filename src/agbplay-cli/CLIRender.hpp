@@ -4,5 +4,15 @@
 
 namespace CLI
 {
-    void Render(const std::string &songId, const std::string &outputPath, bool stems);
+    void Render(
+        const std::string &songId,
+        const std::string &outputPath,
+        const std::string &format,
+        const std::string &normalizeLoudness,
+        const std::string &shard,
+        const std::string &resultPath,
+        bool stems,
+        bool stemsSingleFile,
+        bool incremental
+    );
 }
@@ -48,6 +48,31 @@ void CLI::SonglistShow(const std::string &songId)
     assert(player.tracksUsed <= player.tracks.size());
     for (size_t i = 0; i < player.tracksUsed; i++)
         fmt::print("  - [{:02d}] {:#x}\n", i, player.tracks.at(i).pos);
+
+    const MP2KSongAnalysis analysis = ctx.AnalyzeSong(static_cast<uint16_t>(songIdLL));
+    const double sampleRate = static_cast<double>(s.exportSampleRate);
+
+    fmt::print(
+        "  Length: {} ticks, {:.2f} s\n",
+        analysis.lengthTicks,
+        static_cast<double>(analysis.lengthSamples) / sampleRate
+    );
+    fmt::print("  Length with fade out: {:.2f} s\n", static_cast<double>(analysis.totalSamples) / sampleRate);
+    if (analysis.loopFound) {
+        fmt::print(
+            "  Loop: ticks {} - {}, {:.2f} s - {:.2f} s\n",
+            analysis.loopStartTick,
+            analysis.loopEndTick,
+            static_cast<double>(analysis.loopStartSample) / sampleRate,
+            static_cast<double>(analysis.loopEndSample) / sampleRate
+        );
+    } else {
+        fmt::print("  Loop: none\n");
+    }
+    fmt::print("  Max polyphony: {}\n", analysis.maxPolyphony);
+    fmt::print("  Tempo changes (count: {}):\n", analysis.tempoChanges.size());
+    for (const MP2KSongAnalysis::TempoChange &tc : analysis.tempoChanges)
+        fmt::print("  - tick {}: {} BPM\n", tc.tick, tc.bpm);
 }
 
 void CLI::SonglistList()
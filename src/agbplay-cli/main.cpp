@@ -7,6 +7,7 @@
 #include "CLIRender.hpp"
 #include "CLISonglist.hpp"
 
+#include "Debug.hpp"
 #include "Version.hpp"
 #include "Rom.hpp"
 #include "Util.hpp"
@@ -17,6 +18,17 @@ namespace
     std::string outputPath;
     std::string songName;
     std::string playlistIdx;
+    std::string exportFormat;
+    std::string normalizeLoudness;
+    std::string shard;
+    std::string resultPath;
+    bool stemsSingleFile = false;
+    bool incremental = false;
+}
+
+static void LogToStderr(const std::string &msg, void *)
+{
+    std::cerr << msg << std::endl;
 }
 
 int main(int argc, char *argv[])
@@ -30,8 +42,13 @@ int main(int argc, char *argv[])
     // $ agbplay render
     argparse::ArgumentParser pRender("render", VER);
     pRender.add_description("Render song audio to files");
-    pRender.add_argument("song-id").store_into(songId).help("Song ID(s) to render. For multiple, separate with ';'").required();
-    pRender.add_argument("output-path").store_into(outputPath).help("File path(s) to render to. For multiple, separate with ';'").required();
+    pRender.add_argument("song-id").store_into(songId).help("Song ID(s) to render. For multiple, separate with ';'. Use 'all' for the whole song table or '@<file>' for a JSON job file").required();
+    pRender.add_argument("output-path").store_into(outputPath).help("File path(s) to render to. For multiple, separate with ';'. Use '-' to write a single song to stdout").required();
+    pRender.add_argument("--format").store_into(exportFormat).help("Output format: wav, flac, vorbis or opus. Default: derived from the output path. For stdout: wav, f32le or s16le. Default: wav");
+    pRender.add_argument("--normalize").store_into(normalizeLoudness).help("Normalize the integrated loudness of each song to the given LUFS, e.g. -23");
+    pRender.add_argument("--shard").store_into(shard).help("Only render the songs of shard i/N (0 <= i < N). Songs are assigned to shards by their ID");
+    pRender.add_argument("--result").store_into(resultPath).help("Write a JSON manifest with the output files, hashes, durations and timings of the rendered songs");
+    pRender.add_argument("--incremental").store_into(incremental).help("Skip songs, which have already been rendered with the same song data and settings");
     program.add_subparser(pRender);
 
     // $ agbplay render master
@@ -42,6 +59,7 @@ int main(int argc, char *argv[])
     // $ agbplay render stems
     argparse::ArgumentParser pRenderStems("stems", VER);
     pRenderStems.add_description("Render stems (multitrack) to files");
+    pRenderStems.add_argument("--single-file").store_into(stemsSingleFile).help("Render all tracks of a song to one multichannel WAV file");
     pRender.add_subparser(pRenderStems);
 
     // $ agbplay songlist
@@ -133,9 +151,31 @@ int main(int argc, char *argv[])
     // Determine command
     if (program.is_subcommand_used("render")) {
         if (pRender.is_subcommand_used("master")) {
-            commandHandler = std::bind(CLI::Render, songId, outputPath, false);
+            commandHandler = std::bind(
+                CLI::Render,
+                songId,
+                outputPath,
+                exportFormat,
+                normalizeLoudness,
+                shard,
+                resultPath,
+                false,
+                false,
+                incremental
+            );
         } else if (pRender.is_subcommand_used("stems")) {
-            commandHandler = std::bind(CLI::Render, songId, outputPath, true);
+            commandHandler = std::bind(
+                CLI::Render,
+                songId,
+                outputPath,
+                exportFormat,
+                normalizeLoudness,
+                shard,
+                resultPath,
+                true,
+                stemsSingleFile,
+                incremental
+            );
         } else {
             parseErrorParser = std::cref(pRender);
         }
@@ -187,6 +227,12 @@ int main(int argc, char *argv[])
         return 1;
     } else {
         try {
+            /* Rendering may stream audio to stdout, which must not be mixed with any messages. Whether it does
+             * is only known after the job file has been parsed, while loading the ROM and the profiles already
+             * logs. Hence all messages of the render command go to stderr. */
+            if (program.is_subcommand_used("render"))
+                Debug::set_callback(LogToStderr, nullptr);
+
             Rom::CreateInstance(StrToU8Str(program.get<std::string>("image")));
 
             commandHandler();
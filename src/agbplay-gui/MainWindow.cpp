@@ -1,6 +1,7 @@
 #include "MainWindow.hpp"
 
 #include "AboutWindow.hpp"
+#include "Constants.hpp"
 #include "Debug.hpp"
 #include "FileReader.hpp"
 #include "Gsf.hpp"
@@ -15,6 +16,7 @@
 
 #include <algorithm>
 #include <array>
+#include <cmath>
 #include <fmt/format.h>
 #include <fstream>
 #include <QCloseEvent>
@@ -76,6 +78,8 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
     connect(&statusWidget, &StatusWidget::audibilityChanged, this, &MainWindow::UpdateMute);
 
     new QShortcut(QKeySequence(Qt::ControlModifier | Qt::Key_G), this, [this]() { JumpSong(); });
+    new QShortcut(QKeySequence(Qt::ControlModifier | Qt::Key_Left), this, [this]() { SeekBackward(); });
+    new QShortcut(QKeySequence(Qt::ControlModifier | Qt::Key_Right), this, [this]() { SeekForward(); });
 
     setWindowTitle("agbplay");
     setWindowIcon(QIcon(":/icons/main-logo.ico"));
@@ -142,6 +146,14 @@ void MainWindow::SetupMenuBar()
     benchmarkSelectedAction->setEnabled(false);
     connect(benchmarkSelectedAction, &QAction::triggered, [this](bool) { ExportAudio(true, false, false); });
 
+    cancelExportAction = fileMenu->addAction("Cancel Export");
+    cancelExportAction->setToolTip("Stop the export, which is currently running. Unfinished files are removed.");
+    cancelExportAction->setEnabled(false);
+    connect(cancelExportAction, &QAction::triggered, [this](bool) {
+        if (exportBusy && exporter)
+            exporter->Cancel();
+    });
+
     fileMenu->addSeparator();
 
     QAction *fileQuit = fileMenu->addAction("Quit");
@@ -527,6 +539,22 @@ void MainWindow::SpeedDouble()
     playbackEngine->SpeedDouble();
 }
 
+void MainWindow::SeekBackward()
+{
+    if (!playbackEngine)
+        return;
+
+    playbackEngine->SeekRelative(-SEEK_STEP_TIME);
+}
+
+void MainWindow::SeekForward()
+{
+    if (!playbackEngine)
+        return;
+
+    playbackEngine->SeekRelative(SEEK_STEP_TIME);
+}
+
 void MainWindow::PlaylistAdd()
 {
     QList<QListWidgetItem *> items = songlistWidget.listWidget.selectedItems();
@@ -607,24 +635,31 @@ void MainWindow::ProfileImportGsfPlaylist(const std::filesystem::path &gameFileP
         }
     }
 
-    /* Store all songs together with their original file name (for sorting later) */
-    std::vector<std::tuple<std::filesystem::path, std::string, uint16_t>> songs;
+    /* Read all files first, so they can be parsed in parallel afterwards. */
+    std::vector<std::filesystem::path> gsfPaths;
+    std::vector<std::vector<uint8_t>> gsfFiles;
 
-    auto op = [&songs](const std::filesystem::path &p, FileReader &fileReader) {
-        std::string title;
-        uint16_t id;
-        std::vector<uint8_t> gsfData(fileReader.size());
+    auto op = [&gsfPaths, &gsfFiles](const std::filesystem::path &p, FileReader &fileReader) {
+        std::vector<uint8_t> &gsfData = gsfFiles.emplace_back(fileReader.size());
         fileReader.read(gsfData);
-        Gsf::GetSongInfo(gsfData, title, id);
-        songs.emplace_back(p, std::move(title), id);
+        gsfPaths.emplace_back(p);
         return true;
     };
 
     /* FileReader::forEachIn will run 'op' if 'miniGsfFilterFunc' returns true
-     * for a specific path. In our case 'op' will populate our song list to load. */
+     * for a specific path. In our case 'op' will populate our file list to load. */
     for (const std::filesystem::path &p : pathsToLoad)
         FileReader::forEachInZipOrRaw(p, miniGsfFilterFunc, op);
 
+    std::vector<std::string> titles;
+    std::vector<uint16_t> ids;
+    Gsf::GetSongInfos(gsfFiles, titles, ids);
+
+    /* Store all songs together with their original file name (for sorting later) */
+    std::vector<std::tuple<std::filesystem::path, std::string, uint16_t>> songs;
+    for (size_t i = 0; i < gsfPaths.size(); i++)
+        songs.emplace_back(gsfPaths[i], std::move(titles[i]), ids[i]);
+
     /* Playlist order may be random, so sort by filename like normal for MINIGSFs. */
     auto pathCmp = [](const auto &ta, const auto &tb) { return std::get<0>(ta).stem() < std::get<0>(tb).stem(); };
     std::sort(songs.begin(), songs.end(), pathCmp);
@@ -866,6 +901,7 @@ void MainWindow::ExportAudio(bool benchmarkOnly, bool separateTracks, bool quick
     if (exportThread) {
         exportThread->join();
         exportThread.reset();
+        exporter.reset();
     }
 
     /* Select directory to export to. */
@@ -930,31 +966,22 @@ void MainWindow::ExportAudio(bool benchmarkOnly, bool separateTracks, bool quick
         }
     }
 
+    /* The exporter is created here, so the progress can be queried from the UI thread. */
+    exportSettings = std::make_unique<Settings>(*settings);
+    exportProfile = std::make_unique<Profile>(profileToExport);
+    exporter = std::make_unique<SoundExporter>(
+        directory, std::vector<std::filesystem::path>{}, *exportSettings, *exportProfile, benchmarkOnly, separateTracks
+    );
     exportBusy = true;
 
-    // TODO implement progress bar
-    exportThread = std::make_unique<std::thread>(
-        [this](
-            std::filesystem::path tDirectory,
-            Settings tSettings,
-            Profile tProfile,
-            bool tBenchmarkOnly,
-            bool tSeparateTracks
-        ) {
-            try {
-                SoundExporter se(tDirectory, {}, tSettings, tProfile, tBenchmarkOnly, tSeparateTracks);
-                se.Export();
-            } catch (std::exception &e) {
-                Debug::print("Export failed:\n{}", e.what());
-            }
-            exportBusy = false;
-        },
-        directory,
-        *settings,
-        profileToExport,
-        benchmarkOnly,
-        separateTracks
-    );
+    exportThread = std::make_unique<std::thread>([this]() {
+        try {
+            exporter->Export();
+        } catch (std::exception &e) {
+            Debug::print("Export failed:\n{}", e.what());
+        }
+        exportBusy = false;
+    });
 #ifdef __linux__
     pthread_setname_np(exportThread->native_handle(), "export thread");
 #endif
@@ -1104,6 +1131,8 @@ void MainWindow::UpdateMute(size_t trackNo, bool audible, bool visualOnly)
 
 void MainWindow::StatusUpdate()
 {
+    ExportProgressUpdate();
+
     if (!playbackEngine || !visualizerState)
         return;
 
@@ -1122,6 +1151,36 @@ void MainWindow::StatusUpdate()
     }
 }
 
+void MainWindow::ExportProgressUpdate()
+{
+    if (!exportBusy || !exporter) {
+        progressBar.hide();
+        cancelExportAction->setEnabled(false);
+        return;
+    }
+
+    progressBar.show();
+    cancelExportAction->setEnabled(true);
+
+    const ExportProgress progress = exporter->GetProgress();
+    if (progress.IsEstimating()) {
+        /* busy indicator until the song lengths are known */
+        progressBar.setRange(0, 0);
+        progressBar.setToolTip("Estimating song lengths...");
+        return;
+    }
+
+    progressBar.setRange(0, 1000);
+    progressBar.setValue(static_cast<int>(progress.GetFraction() * 1000.0));
+
+    std::string toolTip = fmt::format("Exported {} of {} songs", progress.songsDone, progress.songs.size());
+    if (progress.secondsRemaining >= 0.0) {
+        const auto secondsRemaining = static_cast<unsigned int>(std::ceil(progress.secondsRemaining));
+        toolTip += fmt::format(", {}:{:02} remaining", secondsRemaining / 60, secondsRemaining % 60);
+    }
+    progressBar.setToolTip(QString::fromStdString(toolTip));
+}
+
 void MainWindow::LogCallback(const std::string &msg, void *void_this)
 {
     MainWindow *_this = static_cast<MainWindow *>(void_this);
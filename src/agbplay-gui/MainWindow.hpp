@@ -23,6 +23,7 @@ class PlaybackEngine;
 class ProfileManager;
 struct Settings;
 struct Profile;
+class SoundExporter;
 namespace std
 {
     class thread;
@@ -52,6 +53,8 @@ private:
     void LoadSong(const std::string &title, uint16_t id);
     void SpeedHalve();
     void SpeedDouble();
+    void SeekBackward();
+    void SeekForward();
 
     void PlaylistAdd();
     void PlaylistRemove();
@@ -77,6 +80,7 @@ private:
     void UpdateSoundMode();
     void UpdateMute(size_t trackNo, bool audible, bool visualOnly);
     void StatusUpdate();
+    void ExportProgressUpdate();
     static void LogCallback(const std::string &msg, void *void_this);
     Q_INVOKABLE void LogAppend(std::string msg);
 
@@ -89,6 +93,7 @@ private:
     QAction *quickExportSongAction = nullptr;
     QAction *quickExportStemsAction = nullptr;
     QAction *benchmarkSelectedAction = nullptr;
+    QAction *cancelExportAction = nullptr;
     QAction *saveProfileAction = nullptr;
     QAction *profileSettings = nullptr;
     QAction *profileMinigsfImport = nullptr;
@@ -155,6 +160,10 @@ private:
     /* File Export */
     std::unique_ptr<std::thread> exportThread;
     std::atomic<bool> exportBusy = false;
+    /* owned by the export thread while exportBusy is set */
+    std::unique_ptr<Settings> exportSettings;
+    std::unique_ptr<Profile> exportProfile;
+    std::unique_ptr<SoundExporter> exporter;
 
 signals:
     /* Use a signal instead of QMetaObject::invokeMethod for pre Qt 6.7 compatibility. */
@@ -8,11 +8,18 @@
 #include <QFileDialog>
 #include <QInputDialog>
 #include <QStandardPaths>
+#include <utility>
 #include <vector>
 
 static const std::vector<uint32_t> standardRates = {22050, 32000, 44100, 48000, 96000, 192000};
 static const uint32_t RATE_CUSTOM = 0u;
 static const std::vector<uint32_t> standardBits = {8, 16, 24, 32};
+static const std::vector<std::pair<ExportFormat, const char *>> exportFormats = {
+    {ExportFormat::WAV, "WAV"},
+    {ExportFormat::FLAC, "FLAC"},
+    {ExportFormat::VORBIS, "Ogg Vorbis"},
+    {ExportFormat::OPUS, "Opus"},
+};
 
 SettingsWindow::SettingsWindow(QWidget *parent, Settings &settings) :
 QDialog(parent), ui(new Ui::SettingsWindow), settings(settings)
@@ -64,6 +71,21 @@ QDialog(parent), ui(new Ui::SettingsWindow), settings(settings)
     exportComboBoxIndex = ui->exportBitDepthComboBox->findData(QVariant(settings.exportBitDepth));
     ui->exportBitDepthComboBox->setCurrentIndex(exportComboBoxIndex);
 
+    /* init format combo box, the bit depth is only used by lossless formats and single file stems require WAV */
+    for (const auto &[f, name] : exportFormats)
+        ui->exportFormatComboBox->addItem(name, QVariant(static_cast<int>(f)));
+
+    ui->exportFormatComboBox->setCurrentIndex(
+        ui->exportFormatComboBox->findData(QVariant(static_cast<int>(settings.exportFormat)))
+    );
+    auto updateBitDepthEnabled = [this]() {
+        const auto f = static_cast<ExportFormat>(ui->exportFormatComboBox->currentData().toInt());
+        ui->exportBitDepthComboBox->setEnabled(f == ExportFormat::WAV || f == ExportFormat::FLAC);
+        ui->exportStemsSingleFileCheckBox->setEnabled(f == ExportFormat::WAV);
+    };
+    updateBitDepthEnabled();
+    connect(ui->exportFormatComboBox, &QComboBox::currentIndexChanged, this, updateBitDepthEnabled);
+
     /* init other fields */
     ui->playbackOutputNumBuffersSpinBox->setValue(static_cast<int>(settings.playbackOutputNumBuffers));
     ui->playbackMaxLoopsSpinBox->setValue(settings.playbackMaxLoops);
@@ -73,6 +95,12 @@ QDialog(parent), ui(new Ui::SettingsWindow), settings(settings)
     ui->exportMaxLoopsSpinBox->setValue(settings.exportMaxLoops);
     ui->exportPadStartSpinBox->setValue(settings.exportPadStart);
     ui->exportPadEndSpinBox->setValue(settings.exportPadEnd);
+    ui->exportCutSilentTailCheckBox->setChecked(settings.exportCutSilentTail);
+    ui->exportStemsSingleFileCheckBox->setChecked(settings.exportStemsSingleFile);
+    ui->exportSkipUnchangedCheckBox->setChecked(settings.exportSkipUnchanged);
+    ui->exportNormalizeCheckBox->setChecked(settings.exportNormalize);
+    ui->exportNormalizeLoudnessSpinBox->setValue(settings.exportNormalizeLoudness);
+    ui->exportNormalizeLoudnessSpinBox->setEnabled(settings.exportNormalize);
 
     ui->exportFolderGroupBox->setChecked(!settings.exportQuickExportAsk);
     ui->exportFolderLineEdit->setText(QString::fromStdWString(settings.exportQuickExportDirectory.wstring()));
@@ -91,6 +119,7 @@ QDialog(parent), ui(new Ui::SettingsWindow), settings(settings)
         ui->exportFolderLineEdit->setEnabled(on);
         ui->exportFolderPushButton->setEnabled(on);
     });
+    connect(ui->exportNormalizeCheckBox, &QCheckBox::toggled, ui->exportNormalizeLoudnessSpinBox, &QWidget::setEnabled);
     connect(ui->exportFolderPushButton, &QPushButton::clicked, this, &SettingsWindow::exportPushButtonPressed);
     connect(ui->buttonBox, &QDialogButtonBox::accepted, this, &QDialog::accept);
     connect(ui->buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
@@ -198,9 +227,16 @@ void SettingsWindow::buttonBoxButtonPressed(QAbstractButton *button)
     settings.playbackLoopIndefinitely = ui->playbackLoopIndefinitelyCheckBox->checkState() == Qt::Checked;
     settings.exportSampleRate = std::max(1u, ui->exportSampleRateComboBox->currentData().toUInt());
     settings.exportBitDepth = std::max(1u, ui->exportBitDepthComboBox->currentData().toUInt());
+    settings.exportFormat = static_cast<ExportFormat>(ui->exportFormatComboBox->currentData().toInt());
     settings.exportMaxLoops = static_cast<int8_t>(std::clamp(ui->exportMaxLoopsSpinBox->value(), 0, 127));
     settings.exportPadStart = std::clamp(ui->exportPadStartSpinBox->value(), 0.0, 100.0);
     settings.exportPadEnd = std::clamp(ui->exportPadEndSpinBox->value(), 0.0, 100.0);
+    settings.exportCutSilentTail = ui->exportCutSilentTailCheckBox->checkState() == Qt::Checked;
+    settings.exportStemsSingleFile = ui->exportStemsSingleFileCheckBox->checkState() == Qt::Checked
+        && settings.exportFormat == ExportFormat::WAV;
+    settings.exportSkipUnchanged = ui->exportSkipUnchangedCheckBox->checkState() == Qt::Checked;
+    settings.exportNormalize = ui->exportNormalizeCheckBox->checkState() == Qt::Checked;
+    settings.exportNormalizeLoudness = std::clamp(ui->exportNormalizeLoudnessSpinBox->value(), -70.0, 0.0);
     settings.exportQuickExportDirectory = ui->exportFolderLineEdit->text().toStdWString();
     settings.exportQuickExportAsk = !ui->exportFolderGroupBox->isChecked();
     settings.dirty = true;
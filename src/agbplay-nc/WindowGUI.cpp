@@ -197,6 +197,12 @@ bool WindowGUI::Handle()
         case '-':
             mplay->SpeedHalve();
             break;
+        case '[':
+            mplay->SeekRelative(-SEEK_STEP_TIME);
+            break;
+        case ']':
+            mplay->SeekRelative(SEEK_STEP_TIME);
+            break;
         case 'n':
             playUI->Leave();
             rename();
@@ -14,6 +14,7 @@
 #include <pa_jack.h>
 #endif
 
+#include "Constants.hpp"
 #include "Debug.hpp"
 #include "PlaybackEngine.hpp"
 #include "Util.hpp"
@@ -67,6 +68,7 @@ PlaybackEngine::PlaybackEngine(uint32_t sampleRate, float volume, const Profile
         profile.songTableInfoPlayback,
         profile.playerTablePlayback
     );
+    seeker = std::make_unique<SongSeeker>(*ctx, SEEK_CHECKPOINT_INTERVAL);
     ctx->m4aSongNumStart(0);
     ctx->m4aSongNumStop(0);
     portaudioOpen();
@@ -99,6 +101,7 @@ void PlaybackEngine::LoadSong(uint16_t songIdx)
         ctx->m4aMPlayAllStop();
         ctx->m4aSongNumStart(songIdx);
         ctx->m4aMPlayStop(ctx->primaryPlayer);
+        seeker->Restart();
         paused = false;
     };
 
@@ -112,15 +115,10 @@ void PlaybackEngine::Play()
         if (playerIdx >= ctx->players.size())
             return;
 
-        if (paused) {
+        if (paused)
             paused = false;
-        } else {
-            MP2KPlayer &player = ctx->players.at(playerIdx);
-            ctx->m4aMPlayStart(playerIdx, player.songHeaderPos);
-            for (size_t i = 0; i < std::min(player.tracks.size(), trackMuted.size()); i++)
-                player.tracks.at(i).muted = trackMuted[i];
-            songEnded = false;
-        }
+        else
+            restartPlayer();
     };
 
     InvokeAsPlayer(func);
@@ -137,11 +135,7 @@ bool PlaybackEngine::Pause()
         if (playing) {
             paused = !paused;
         } else {
-            MP2KPlayer &player = ctx->players.at(playerIdx);
-            ctx->m4aMPlayStart(playerIdx, ctx->players.at(playerIdx).songHeaderPos);
-            for (size_t i = 0; i < std::min(player.tracks.size(), trackMuted.size()); i++)
-                player.tracks.at(i).muted = trackMuted[i];
-            songEnded = false;
+            restartPlayer();
             paused = false;
         }
         // paused = !paused;
@@ -163,6 +157,7 @@ void PlaybackEngine::Stop()
         ctx->m4aMPlayAllStop();
         ctx->m4aMPlayStart(playerIdx, ctx->players.at(playerIdx).songHeaderPos);
         ctx->m4aMPlayStop(playerIdx);
+        seeker->Restart();
         songEnded = false;
         paused = false;
     };
@@ -198,6 +193,20 @@ void PlaybackEngine::SpeedHalve()
     InvokeAsPlayer(func);
 }
 
+void PlaybackEngine::Seek(double seconds)
+{
+    auto func = [this, seconds]() { seekPlayer(seconds); };
+
+    InvokeAsPlayer(func);
+}
+
+void PlaybackEngine::SeekRelative(double seconds)
+{
+    auto func = [this, seconds]() { seekPlayer(seeker->GetPosition() + seconds); };
+
+    InvokeAsPlayer(func);
+}
+
 bool PlaybackEngine::SongEnded() const
 {
     return songEnded;
@@ -276,6 +285,8 @@ void PlaybackEngine::UpdateSoundMode()
         ctx->m4aSoundModePCMVol(profile.mp2kSoundModePlayback.vol);
         ctx->m4aSoundModePCMFreq(profile.mp2kSoundModePlayback.freq);
         ctx->m4aSoundModeDacConfig(profile.mp2kSoundModePlayback.dacConfig);
+        /* Checkpoints saved with the old sound mode can't be restored. */
+        seeker->Invalidate();
         /* Do not update the playertable since it may cause playback issues.
          * The user is supposed to reload the game if that was changed with the
          * profile editor. */
@@ -329,6 +340,7 @@ void PlaybackEngine::threadWorker()
             } else {
                 /* Run sound engine. */
                 ctx->m4aSoundMain();
+                seeker->Advance();
                 updateVisualizerState();
 
                 /* Write audio data to portaudio ringbuffer. */
@@ -354,6 +366,46 @@ void PlaybackEngine::threadWorker()
     playerThreadQuitComplete = true;
 }
 
+void PlaybackEngine::seekPlayer(double seconds)
+{
+    /* This function must be called from within the player thread only! */
+    const uint8_t playerIdx = ctx->primaryPlayer;
+    if (playerIdx >= ctx->players.size())
+        return;
+
+    /* Do not start playback if the song is stopped. */
+    if (!ctx->m4aMPlayIsPlaying(playerIdx) && !songEnded)
+        return;
+
+    try {
+        /* Seeking backwards without checkpoint requires rendering from the start. */
+        if (!seeker->Seek(seconds)) {
+            ctx->m4aSoundClear();
+            restartPlayer();
+            seeker->Seek(seconds);
+        }
+    } catch (const Xcept &e) {
+        Debug::print("Seeking failed, restarting song: {}", e.what());
+        ctx->m4aMPlayAllStop();
+        ctx->m4aSoundClear();
+        restartPlayer();
+    }
+
+    songEnded = false;
+}
+
+void PlaybackEngine::restartPlayer()
+{
+    /* This function must be called from within the player thread only! */
+    const uint8_t playerIdx = ctx->primaryPlayer;
+    MP2KPlayer &player = ctx->players.at(playerIdx);
+    ctx->m4aMPlayStart(playerIdx, player.songHeaderPos);
+    for (size_t i = 0; i < std::min(player.tracks.size(), trackMuted.size()); i++)
+        player.tracks.at(i).muted = trackMuted[i];
+    seeker->Restart();
+    songEnded = false;
+}
+
 void PlaybackEngine::updateVisualizerState()
 {
     /* We assume that GetVisualizerState may be more expensive than a simple copy.
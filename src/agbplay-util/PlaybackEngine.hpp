@@ -3,6 +3,7 @@
 #include "LowLatencyRingbuffer.hpp"
 #include "MP2KContext.hpp"
 #include "Profile.hpp"
+#include "SongSeeker.hpp"
 
 #include <atomic>
 #include <bitset>
@@ -29,6 +30,8 @@ public:
     void Stop();
     void SpeedDouble();
     void SpeedHalve();
+    void Seek(double seconds);
+    void SeekRelative(double seconds);
     bool SongEnded() const;
     void ToggleMute(size_t index);
     void Mute(size_t index, bool mute);
@@ -41,6 +44,8 @@ public:
 
 private:
     void threadWorker();
+    void seekPlayer(double seconds);
+    void restartPlayer();
     void updateVisualizerState();
     void InvokeAsPlayer(const std::function<void(void)> &func);
     void InvokeRun();
@@ -63,6 +68,7 @@ private:
     std::bitset<16> trackMuted;    // TODO replace 16 with constant
     bool paused = false;
     std::unique_ptr<MP2KContext> ctx;
+    std::unique_ptr<SongSeeker> seeker;
 
     MP2KVisualizerState visualizerStatePlayer;
     MP2KVisualizerState visualizerStateObserver;
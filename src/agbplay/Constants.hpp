@@ -18,6 +18,34 @@ namespace {
 
 #define SONG_FADE_OUT_TIME 10000
 #define SONG_FINISH_TIME   1000
+// limit for MP2KContext::AnalyzeSong in seconds
+#define SONG_ANALYSIS_MAX_TIME 3600
+// -96 dBFS, everything below is considered silent for tail detection
+#define SONG_SILENCE_THRESHOLD 1.5849e-5f
+// interval in seconds in which SongSeeker saves engine checkpoints
+#define SEEK_CHECKPOINT_INTERVAL 10.0
+// max number of checkpoints per song, the interval is doubled if exceeded
+#define SEEK_CHECKPOINT_MAX 64
+// seek distance in seconds for the seek controls
+#define SEEK_STEP_TIME 10.0
+// has to be incremented whenever the saved engine state changes
+#define SNAPSHOT_VERSION 1
+// max size of the decompressed gsflib cache in bytes
+#define GSF_CACHE_MAX_SIZE (2ull * 1024 * 1024 * 1024)
+// min number of minigsf files per thread for parallel parsing
+#define GSF_FILES_PER_THREAD 16
+// number of profile files indexed by one thread at once
+#define PROFILE_FILES_PER_THREAD 16
+// has to be incremented whenever MP2KScanner results change, so cached scan results are discarded
+#define SCANNER_VERSION 1
+// number of ROM bytes scanned by one thread at once (multiple of 32)
+#define SCAN_CHUNK_SIZE (1024 * 1024)
+// size of the sample blocks, which are passed from the export render threads to the writer threads
+#define EXPORT_BLOCK_SIZE (2 * 1024 * 1024)
+// max number of blocks waiting to be written before rendering is paused
+#define EXPORT_MAX_QUEUED_BLOCKS 64
+// max true peak in dBTP of loudness normalized exports, the gain is reduced if necessary
+#define EXPORT_NORMALIZE_MAX_TRUE_PEAK -1.0
 
 #define WINDOW_MIN_WIDTH  80
 #define WINDOW_MIN_HEIGHT 24
@@ -0,0 +1,273 @@
+#include "ExportFile.hpp"
+
+#include "Constants.hpp"
+#include "Debug.hpp"
+#include "OS.hpp"
+#include "Xcept.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fmt/core.h>
+#include <sndfile.h>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+/*
+ * public ExportFile
+ */
+
+ExportFile::ExportFile(size_t channels) : channels(channels)
+{
+}
+
+/*
+ * public SndfileExportFile
+ */
+
+SndfileExportFile::SndfileExportFile(
+    const std::filesystem::path &filePath,
+    int format,
+    uint32_t sampleRate,
+    size_t channels,
+    std::span<const std::string> channelNames
+) :
+    ExportFile(channels)
+{
+    SF_INFO oinfo{};
+    oinfo.samplerate = static_cast<int>(sampleRate);
+    oinfo.channels = static_cast<int>(channels);
+    oinfo.format = format;
+
+#ifdef _WIN32
+    sndfile = sf_wchar_open(filePath.wstring().c_str(), SFM_WRITE, &oinfo);
+#else
+    sndfile = sf_open(filePath.string().c_str(), SFM_WRITE, &oinfo);
+#endif
+    if (sndfile == NULL)
+        throw Xcept("Failed to open file for export: {}", sf_strerror(nullptr));
+
+    if ((format & SF_FORMAT_SUBMASK) != SF_FORMAT_FLOAT)
+        sf_command(sndfile, SFC_SET_CLIPPING, NULL, SF_TRUE);
+
+    /* RF64 is only required for files larger than 4 GiB, all others are written as regular WAV */
+    if ((format & SF_FORMAT_TYPEMASK) == SF_FORMAT_RF64)
+        sf_command(sndfile, SFC_RF64_AUTO_DOWNGRADE, NULL, SF_TRUE);
+
+    if (!channelNames.empty()) {
+        assert(channelNames.size() == channels);
+        std::string comment;
+        for (const std::string &name : channelNames) {
+            if (!comment.empty())
+                comment += ", ";
+            comment += name;
+        }
+        if (sf_set_string(sndfile, SF_STR_COMMENT, comment.c_str()) != SF_ERR_NO_ERROR)
+            Debug::print("Unable to store channel names: {}", sf_strerror(sndfile));
+    }
+}
+
+SndfileExportFile::~SndfileExportFile()
+{
+    /* only reached without Finish if the export failed */
+    if (sndfile)
+        sf_close(sndfile);
+}
+
+/*
+ * private SndfileExportFile
+ */
+
+void SndfileExportFile::WriteBlock(std::span<const float> samples)
+{
+    const sf_count_t frames = static_cast<sf_count_t>(samples.size() / GetChannels());
+    const sf_count_t processed = sf_writef_float(sndfile, samples.data(), frames);
+    if (processed < frames)
+        throw Xcept("sf_writef_float failed: {}", sf_strerror(sndfile));
+}
+
+void SndfileExportFile::Finish()
+{
+    const int err = sf_close(sndfile);
+    sndfile = nullptr;
+    if (err != SF_ERR_NO_ERROR)
+        throw Xcept("Unable to close file: {}", sf_error_number(err));
+}
+
+/*
+ * public StreamExportFile
+ */
+
+StreamExportFile::StreamExportFile(
+    FILE *stream,
+    StreamFormat format,
+    uint32_t bitDepth,
+    uint32_t sampleRate,
+    size_t channels
+) :
+    ExportFile(channels),
+    stream(stream),
+    s16(format == StreamFormat::S16LE || (format == StreamFormat::WAV && bitDepth == 16))
+{
+#ifdef _WIN32
+    /* otherwise line endings are converted */
+    _setmode(_fileno(stream), _O_BINARY);
+#endif
+
+    if (format == StreamFormat::WAV)
+        WriteHeader(sampleRate);
+}
+
+/*
+ * private StreamExportFile
+ */
+
+void StreamExportFile::WriteBlock(std::span<const float> samples)
+{
+    /* all stream formats are little endian */
+    constexpr bool swap = std::endian::native != std::endian::little;
+
+    if (!s16) {
+        if constexpr (!swap) {
+            WriteBytes(samples.data(), samples.size_bytes());
+        } else {
+            f32Block.resize(samples.size());
+            for (size_t i = 0; i < samples.size(); i++)
+                f32Block[i] = std::byteswap(std::bit_cast<uint32_t>(samples[i]));
+            WriteBytes(f32Block.data(), f32Block.size() * sizeof(uint32_t));
+        }
+        return;
+    }
+
+    s16Block.resize(samples.size());
+    for (size_t i = 0; i < samples.size(); i++) {
+        const float s = std::clamp(samples[i] * 32768.0f, -32768.0f, 32767.0f);
+        const uint16_t value = static_cast<uint16_t>(static_cast<int16_t>(std::lround(s)));
+        s16Block[i] = swap ? std::byteswap(value) : value;
+    }
+    WriteBytes(s16Block.data(), s16Block.size() * sizeof(uint16_t));
+}
+
+void StreamExportFile::Finish()
+{
+    if (fflush(stream) != 0)
+        throw Xcept("Unable to flush output stream");
+}
+
+void StreamExportFile::WriteHeader(uint32_t sampleRate)
+{
+    const uint16_t channels = static_cast<uint16_t>(GetChannels());
+    const uint16_t bitsPerSample = s16 ? 16 : 32;
+    const uint16_t blockAlign = static_cast<uint16_t>(channels * bitsPerSample / 8);
+
+    std::vector<uint8_t> header;
+    auto put = [&header](uint32_t value, size_t bytes) {
+        for (size_t i = 0; i < bytes; i++)
+            header.emplace_back(static_cast<uint8_t>(value >> (i * 8)));
+    };
+    auto putTag = [&header](const char *tag) { header.insert(header.end(), tag, tag + 4); };
+
+    putTag("RIFF");
+    put(0xFFFFFFFF, 4);
+    putTag("WAVE");
+    putTag("fmt ");
+    /* non PCM formats require the extension size field */
+    put(s16 ? 16 : 18, 4);
+    put(s16 ? 1 : 3, 2);    // WAVE_FORMAT_PCM or WAVE_FORMAT_IEEE_FLOAT
+    put(channels, 2);
+    put(sampleRate, 4);
+    put(sampleRate * blockAlign, 4);
+    put(blockAlign, 2);
+    put(bitsPerSample, 2);
+    if (!s16)
+        put(0, 2);
+    putTag("data");
+    put(0xFFFFFFFF, 4);
+
+    WriteBytes(header.data(), header.size());
+}
+
+void StreamExportFile::WriteBytes(const void *data, size_t size)
+{
+    if (fwrite(data, 1, size, stream) != size)
+        throw Xcept("Unable to write to output stream");
+}
+
+/*
+ * public SpoolExportFile
+ */
+
+SpoolExportFile::SpoolExportFile(std::unique_ptr<ExportFile> target) :
+    ExportFile(target->GetChannels()),
+    target(std::move(target))
+{
+    /* opened exclusively, so the spool of another process is never truncated */
+    spoolPath = std::filesystem::temp_directory_path() / fmt::format("agbplay-{}.spool", OS::GetUniqueName());
+
+#ifdef _WIN32
+    spool = _wfopen(spoolPath.wstring().c_str(), L"w+bx");
+#else
+    spool = fopen(spoolPath.string().c_str(), "w+bx");
+#endif
+    if (spool == nullptr)
+        throw Xcept("Failed to create temporary file {}: {}", spoolPath.string(), strerror(errno));
+}
+
+SpoolExportFile::~SpoolExportFile()
+{
+    CloseSpool();
+}
+
+void SpoolExportFile::SetGain(float gain)
+{
+    this->gain = gain;
+}
+
+/*
+ * private SpoolExportFile
+ */
+
+void SpoolExportFile::WriteBlock(std::span<const float> samples)
+{
+    if (fwrite(samples.data(), sizeof(float), samples.size(), spool) != samples.size())
+        throw Xcept("Unable to write temporary file {}", spoolPath.string());
+}
+
+void SpoolExportFile::Finish()
+{
+    if (fflush(spool) != 0 || fseek(spool, 0, SEEK_SET) != 0)
+        throw Xcept("Unable to read temporary file {}", spoolPath.string());
+
+    const size_t blockFrames = std::max<size_t>(EXPORT_BLOCK_SIZE / sizeof(float) / GetChannels(), 1);
+    std::vector<float> block(blockFrames * GetChannels());
+    while (true) {
+        const size_t samplesRead = fread(block.data(), sizeof(float), block.size(), spool);
+        if (samplesRead == 0)
+            break;
+        for (size_t i = 0; i < samplesRead; i++)
+            block[i] *= gain;
+        target->WriteBlock(std::span<const float>(block.data(), samplesRead));
+    }
+    if (ferror(spool))
+        throw Xcept("Unable to read temporary file {}", spoolPath.string());
+
+    CloseSpool();
+    target->Finish();
+}
+
+void SpoolExportFile::CloseSpool()
+{
+    if (spool == nullptr)
+        return;
+
+    fclose(spool);
+    spool = nullptr;
+    std::error_code ec;
+    std::filesystem::remove(spoolPath, ec);
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "Types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+struct sf_private_tag;
+
+/* ExportFile is an output file of the SoundExporter. Samples are written by the threads of an ExportWriter,
+ * which never call WriteBlock of the same file concurrently and always keep the order of the blocks. */
+class ExportFile
+{
+public:
+    ExportFile(size_t channels);
+    ExportFile(const ExportFile &) = delete;
+    ExportFile &operator=(const ExportFile &) = delete;
+    virtual ~ExportFile() = default;
+
+    size_t GetChannels() const { return channels; }
+
+protected:
+    /* samples are interleaved, i.e. the size is always a multiple of the channel count */
+    virtual void WriteBlock(std::span<const float> samples) = 0;
+    /* Called by a writer thread after all blocks have been written. Errors while finalizing the file have to be
+     * thrown here. */
+    virtual void Finish() = 0;
+
+private:
+    friend class ExportWriter;
+    friend class SpoolExportFile;
+
+    const size_t channels;
+
+    /* state of the ExportWriter, protected by its mutex */
+    std::vector<float> currentBlock;
+    std::deque<std::vector<float>> queuedBlocks;
+    bool busy = false;
+    bool closing = false;
+    bool finished = false;
+    std::exception_ptr error;
+};
+
+/* ExportFile, which is encoded by libsndfile. format is a combination of SF_FORMAT_* flags. libsndfile has no
+ * notion of channel names, so if channelNames are given, they are stored as comment separated by ", ". */
+class SndfileExportFile : public ExportFile
+{
+public:
+    SndfileExportFile(
+        const std::filesystem::path &filePath,
+        int format,
+        uint32_t sampleRate,
+        size_t channels,
+        std::span<const std::string> channelNames = {}
+    );
+    ~SndfileExportFile() override;
+
+private:
+    void WriteBlock(std::span<const float> samples) override;
+    void Finish() override;
+
+    sf_private_tag *sndfile = nullptr;
+};
+
+/* ExportFile, which writes to a stream like stdout, so the output can be piped into other tools. Since the
+ * length is not known in advance and the stream cannot seek, WAV streams are written with the maximum size in
+ * the RIFF and data chunk headers, which is understood by most tools reading from pipes. WAV streams contain
+ * 16 bit samples if bitDepth is 16 and 32 bit float samples otherwise. The stream is not closed. */
+class StreamExportFile : public ExportFile
+{
+public:
+    StreamExportFile(FILE *stream, StreamFormat format, uint32_t bitDepth, uint32_t sampleRate, size_t channels);
+
+private:
+    void WriteBlock(std::span<const float> samples) override;
+    void Finish() override;
+    void WriteHeader(uint32_t sampleRate);
+    void WriteBytes(const void *data, size_t size);
+
+    FILE *const stream;
+    const bool s16;
+    std::vector<uint16_t> s16Block;
+    std::vector<uint32_t> f32Block;    // only used on big endian hosts
+};
+
+/* ExportFile, which stores the samples in a temporary file and writes them to the target file, once the file is
+ * finished. This allows applying a gain, which is only known after the song has been rendered completely (e.g. for
+ * loudness normalization), without rendering it a second time. SetGain has to be called before the file is closed. */
+class SpoolExportFile : public ExportFile
+{
+public:
+    SpoolExportFile(std::unique_ptr<ExportFile> target);
+    ~SpoolExportFile() override;
+
+    void SetGain(float gain);
+
+private:
+    void WriteBlock(std::span<const float> samples) override;
+    void Finish() override;
+    void CloseSpool();
+
+    std::unique_ptr<ExportFile> target;
+    std::filesystem::path spoolPath;
+    FILE *spool = nullptr;
+    float gain = 1.0f;
+};
@@ -0,0 +1,153 @@
+#include "ExportManifest.hpp"
+
+#include "Debug.hpp"
+#include "OS.hpp"
+
+#include <fmt/core.h>
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+static const int MANIFEST_VERSION = 1;
+
+static std::string pathToUtf8(const std::filesystem::path &path)
+{
+    const std::u8string tmp = path.generic_u8string();
+    return std::string(reinterpret_cast<const char *>(tmp.data()), tmp.size());
+}
+
+static std::filesystem::path utf8ToPath(const std::string &str)
+{
+    return std::u8string(reinterpret_cast<const char8_t *>(str.data()), str.size());
+}
+
+/*
+ * public ExportManifest
+ */
+
+const std::filesystem::path ExportManifest::FILE_NAME = "agbplay-export.json";
+
+ExportManifest::ExportManifest(const std::filesystem::path &directory) : directory(directory)
+{
+    Load();
+}
+
+bool ExportManifest::IsUpToDate(const std::string &song, uint64_t key) const
+{
+    if (key == 0)
+        return false;
+
+    std::scoped_lock l(mtx);
+    const auto it = entries.find(song);
+    if (it == entries.end() || it->second.key != key)
+        return false;
+
+    for (const std::filesystem::path &file : it->second.files) {
+        std::error_code ec;
+        if (!std::filesystem::is_regular_file(directory / file, ec))
+            return false;
+    }
+    return true;
+}
+
+std::vector<std::filesystem::path> ExportManifest::GetFiles(const std::string &song) const
+{
+    std::vector<std::filesystem::path> files;
+
+    std::scoped_lock l(mtx);
+    const auto it = entries.find(song);
+    if (it != entries.end()) {
+        for (const std::filesystem::path &file : it->second.files)
+            files.emplace_back(directory / file);
+    }
+    return files;
+}
+
+void ExportManifest::Put(const std::string &song, uint64_t key, const std::vector<std::filesystem::path> &files)
+{
+    Entry entry;
+    entry.key = key;
+    for (const std::filesystem::path &file : files)
+        entry.files.emplace_back(file.filename());
+
+    std::scoped_lock l(mtx);
+    entries[song] = std::move(entry);
+    dirty = true;
+}
+
+void ExportManifest::Remove(const std::string &song)
+{
+    std::scoped_lock l(mtx);
+    if (entries.erase(song) != 0)
+        dirty = true;
+}
+
+void ExportManifest::Save()
+{
+    using nlohmann::json;
+
+    std::scoped_lock l(mtx);
+    if (!dirty)
+        return;
+
+    json songs = json::object();
+    for (const auto &[song, entry] : entries) {
+        json files = json::array();
+        for (const std::filesystem::path &file : entry.files)
+            files.emplace_back(pathToUtf8(file));
+        songs[song] = {
+            {"key", fmt::format("{:016x}", entry.key)},
+            {"files", files},
+        };
+    }
+
+    json j;
+    j["version"] = MANIFEST_VERSION;
+    j["songs"] = songs;
+
+    const std::filesystem::path manifestPath = directory / FILE_NAME;
+    const std::string text = j.dump(2) + "\n";
+    if (!OS::WriteFileAtomic(manifestPath, std::span(reinterpret_cast<const uint8_t *>(text.data()), text.size()))) {
+        Debug::print("Failed to save export manifest: {}", manifestPath.string());
+        return;
+    }
+
+    dirty = false;
+}
+
+/*
+ * private ExportManifest
+ */
+
+void ExportManifest::Load()
+{
+    using nlohmann::json;
+
+    std::ifstream ifs(directory / FILE_NAME);
+    if (!ifs.is_open())
+        return;
+
+    /* An unreadable manifest is treated like a missing one. It is replaced after the export. */
+    const json j = json::parse(ifs, nullptr, false);
+    if (!j.is_object() || !j.contains("version") || j["version"] != MANIFEST_VERSION)
+        return;
+    if (!j.contains("songs") || !j["songs"].is_object())
+        return;
+
+    for (const auto &[song, jentry] : j["songs"].items()) {
+        if (!jentry.is_object() || !jentry.contains("key") || !jentry["key"].is_string() || !jentry.contains("files")
+            || !jentry["files"].is_array())
+            continue;
+
+        Entry entry;
+        try {
+            entry.key = std::stoull(jentry["key"].get<std::string>(), nullptr, 16);
+        } catch (const std::exception &) {
+            continue;
+        }
+        for (const json &file : jentry["files"]) {
+            if (file.is_string())
+                entry.files.emplace_back(utf8ToPath(file.get<std::string>()));
+        }
+        entries[song] = std::move(entry);
+    }
+}
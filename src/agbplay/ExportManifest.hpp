@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* The ExportManifest records, which songs have been exported to a directory and the key they were exported
+ * with. The key is a hash of everything the rendered audio depends on (song data, sound modes and export
+ * settings), so songs with an unchanged key do not have to be exported again. The manifest is stored as JSON
+ * in the directory it describes. Put and Remove may be called from multiple threads. */
+class ExportManifest
+{
+public:
+    ExportManifest(const std::filesystem::path &directory);
+    ExportManifest(const ExportManifest &) = delete;
+    ExportManifest &operator=(const ExportManifest &) = delete;
+
+    /* Returns true if the song has been exported with the same key and all of its files still exist.
+     * A key of 0 is never up to date. */
+    bool IsUpToDate(const std::string &song, uint64_t key) const;
+    /* full paths of the files of a song, empty if the song is unknown */
+    std::vector<std::filesystem::path> GetFiles(const std::string &song) const;
+    /* files have to be located in the directory of the manifest */
+    void Put(const std::string &song, uint64_t key, const std::vector<std::filesystem::path> &files);
+    void Remove(const std::string &song);
+
+    /* Writes the manifest if entries were changed. Errors are only logged, since a missing manifest only
+     * causes songs to be exported again. */
+    void Save();
+
+    static const std::filesystem::path FILE_NAME;
+
+private:
+    struct Entry
+    {
+        uint64_t key = 0;
+        std::vector<std::filesystem::path> files;    // relative to the directory
+    };
+
+    void Load();
+
+    const std::filesystem::path directory;
+    mutable std::mutex mtx;
+    std::map<std::string, Entry> entries;
+    bool dirty = false;
+};
@@ -0,0 +1,197 @@
+#include "ExportWriter.hpp"
+
+#include "ExportFile.hpp"
+#include "OS.hpp"
+
+#include <algorithm>
+
+/*
+ * public ExportWriter
+ */
+
+ExportWriter::ExportWriter(size_t numThreads, size_t blockSize, size_t maxQueuedBlocks) :
+    blockSize(blockSize), maxQueuedBlocks(std::max<size_t>(maxQueuedBlocks, 1))
+{
+    for (size_t i = 0; i < std::max<size_t>(numThreads, 1); i++)
+        workers.emplace_back(&ExportWriter::threadWorker, this);
+}
+
+ExportWriter::~ExportWriter()
+{
+    {
+        std::scoped_lock l(mtx);
+        quit = true;
+    }
+    workAvailable.notify_all();
+    for (auto &w : workers)
+        w.join();
+}
+
+void ExportWriter::Write(ExportFile &file, std::span<const float> samples)
+{
+    /* The block size is rounded to whole frames, so blocks never split a frame. */
+    const size_t channels = file.GetChannels();
+    const size_t blockSamples = std::max<size_t>(blockSize / sizeof(float) / channels, 1) * channels;
+
+    while (!samples.empty()) {
+        if (file.currentBlock.capacity() == 0) {
+            std::scoped_lock l(mtx);
+            ThrowError(file);
+            if (!freeBlocks.empty()) {
+                file.currentBlock = std::move(freeBlocks.back());
+                freeBlocks.pop_back();
+            }
+        }
+        file.currentBlock.reserve(blockSamples);
+
+        const size_t count = std::min(samples.size(), blockSamples - file.currentBlock.size());
+        file.currentBlock.insert(
+            file.currentBlock.end(), samples.begin(), samples.begin() + static_cast<ptrdiff_t>(count)
+        );
+        samples = samples.subspan(count);
+
+        if (file.currentBlock.size() >= blockSamples)
+            Submit(file);
+    }
+}
+
+void ExportWriter::WriteSilence(ExportFile &file, size_t frames)
+{
+    const std::vector<float> silence(std::min<size_t>(frames, 4096) * file.GetChannels(), 0.0f);
+    while (frames > 0) {
+        const size_t count = std::min(frames, silence.size() / file.GetChannels());
+        Write(file, std::span<const float>(silence).first(count * file.GetChannels()));
+        frames -= count;
+    }
+}
+
+void ExportWriter::StartClose(ExportFile &file)
+{
+    if (!file.currentBlock.empty())
+        Submit(file);
+
+    std::scoped_lock l(mtx);
+    if (file.closing)
+        return;
+
+    file.closing = true;
+    if (file.currentBlock.capacity() != 0)
+        freeBlocks.emplace_back(std::move(file.currentBlock));
+    file.currentBlock = {};
+
+    /* Finish is queued behind the remaining blocks, so it may be run by a different writer thread than the
+     * render thread closing the file. Encoding files, which finish slowly (e.g. spooled ones), thus overlaps. */
+    if (!file.busy && file.queuedBlocks.empty())
+        readyFiles.push_back(&file);
+    workAvailable.notify_one();
+}
+
+void ExportWriter::Close(ExportFile &file)
+{
+    StartClose(file);
+
+    std::unique_lock l(mtx);
+    workDone.wait(l, [&file]() { return file.finished; });
+    ThrowError(file);
+}
+
+void ExportWriter::Discard(ExportFile &file)
+{
+    std::unique_lock l(mtx);
+    std::erase(readyFiles, &file);
+    for (std::vector<float> &block : file.queuedBlocks) {
+        block.clear();
+        freeBlocks.emplace_back(std::move(block));
+    }
+    queuedBlocks -= file.queuedBlocks.size();
+    file.queuedBlocks.clear();
+    file.currentBlock = {};
+    // prevents a pending Finish from being queued again
+    file.finished = true;
+    workDone.notify_all();
+
+    /* the block, which is currently written, cannot be interrupted */
+    workDone.wait(l, [&file]() { return !file.busy; });
+}
+
+/*
+ * private ExportWriter
+ */
+
+void ExportWriter::Submit(ExportFile &file)
+{
+    std::unique_lock l(mtx);
+    ThrowError(file);
+    workDone.wait(l, [this]() { return queuedBlocks < maxQueuedBlocks; });
+
+    file.queuedBlocks.emplace_back(std::move(file.currentBlock));
+    file.currentBlock = {};
+    queuedBlocks++;
+    if (!file.busy && file.queuedBlocks.size() == 1)
+        readyFiles.push_back(&file);
+    workAvailable.notify_one();
+}
+
+void ExportWriter::ThrowError(ExportFile &file)
+{
+    /* mtx has to be locked */
+    if (file.error)
+        std::rethrow_exception(file.error);
+}
+
+void ExportWriter::threadWorker()
+{
+    OS::LowerThreadPriority();
+
+    std::unique_lock l(mtx);
+    while (true) {
+        workAvailable.wait(l, [this]() { return quit || !readyFiles.empty(); });
+        if (readyFiles.empty())
+            return;
+
+        ExportFile &file = *readyFiles.front();
+        readyFiles.pop_front();
+        file.busy = true;
+
+        if (!file.queuedBlocks.empty()) {
+            std::vector<float> block = std::move(file.queuedBlocks.front());
+            file.queuedBlocks.pop_front();
+
+            if (!file.error) {
+                l.unlock();
+                try {
+                    file.WriteBlock(block);
+                } catch (...) {
+                    l.lock();
+                    file.error = std::current_exception();
+                    l.unlock();
+                }
+                l.lock();
+            }
+
+            block.clear();
+            freeBlocks.emplace_back(std::move(block));
+            queuedBlocks--;
+        }
+        // all blocks of a closing file have been written
+        else {
+            if (!file.error) {
+                l.unlock();
+                try {
+                    file.Finish();
+                } catch (...) {
+                    l.lock();
+                    file.error = std::current_exception();
+                    l.unlock();
+                }
+                l.lock();
+            }
+            file.finished = true;
+        }
+
+        file.busy = false;
+        if (!file.queuedBlocks.empty() || (file.closing && !file.finished))
+            readyFiles.push_back(&file);
+        workDone.notify_all();
+    }
+}
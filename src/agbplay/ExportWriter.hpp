@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+class ExportFile;
+
+/* The ExportWriter decouples rendering from encoding and file I/O. Samples written by the render threads are
+ * collected in large blocks per file. Full blocks are handed to the writer threads, which encode and write
+ * them. If too many blocks are queued, Write blocks until the writer threads have caught up. */
+class ExportWriter
+{
+public:
+    ExportWriter(size_t numThreads, size_t blockSize, size_t maxQueuedBlocks);
+    ExportWriter(const ExportWriter &) = delete;
+    ExportWriter &operator=(const ExportWriter &) = delete;
+    ~ExportWriter();
+
+    /* samples are interleaved with the channel count of the file */
+    void Write(ExportFile &file, std::span<const float> samples);
+    void WriteSilence(ExportFile &file, size_t frames);
+    /* Queues finishing the file after its remaining samples without waiting. The file must not be written
+     * afterwards. */
+    void StartClose(ExportFile &file);
+    /* Waits until all samples of the file have been written and the file has been finished by a writer thread.
+     * Errors, which occurred while writing, are rethrown here (or by any Write call after the error). */
+    void Close(ExportFile &file);
+    /* Drops all samples of the file, which have not been written yet. This has to be called before a file,
+     * which was not closed, is destroyed. Calling it for a closed file does nothing. */
+    void Discard(ExportFile &file);
+
+private:
+    void Submit(ExportFile &file);
+    void ThrowError(ExportFile &file);
+    void threadWorker();
+
+    const size_t blockSize;    // in bytes
+    const size_t maxQueuedBlocks;
+
+    std::mutex mtx;
+    std::condition_variable workAvailable;
+    std::condition_variable workDone;
+    std::deque<ExportFile *> readyFiles;    // files with queued blocks or pending Finish, which are not busy
+    std::vector<std::vector<float>> freeBlocks;
+    size_t queuedBlocks = 0;
+    bool quit = false;
+
+    std::vector<std::thread> workers;
+};
@@ -1,18 +1,30 @@
 #include "Gsf.hpp"
 
+#include "AgbTypes.hpp"
+#include "Constants.hpp"
+#include "Debug.hpp"
+#include "OS.hpp"
+#include "Util.hpp"
 #include "Xcept.hpp"
 
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <exception>
+#include <fmt/core.h>
+#include <fstream>
 #include <memory>
 #include <regex>
 #include <sstream>
 #include <zlib.h>
 
-static void Decompress(std::span<const uint8_t> compressedData, std::vector<uint8_t> &decompressedData)
+/* sizeHint is the expected size of the decompressed data. If it is exceeded, the output grows geometrically. */
+static void Decompress(
+    std::span<const uint8_t> compressedData, std::vector<uint8_t> &decompressedData, size_t sizeHint = 0
+)
 {
     int error = Z_OK;
-    const size_t CHUNK_SIZE = 4096;
+    const size_t MIN_CHUNK_SIZE = 4096;
     decompressedData.clear();
 
     z_stream strm{};
@@ -26,80 +38,250 @@ static void Decompress(std::span<const uint8_t> compressedData, std::vector<uint
     auto streamDel = [](z_stream *strm) { inflateEnd(strm); };
     std::unique_ptr<z_stream, decltype(streamDel)> strmRaii(&strm, streamDel);
 
+    /* Reserve one byte more than expected, otherwise zlib cannot signal the stream end without growing. */
+    size_t chunkSize = sizeHint > 0 ? sizeHint + 1 : std::max(compressedData.size() * 4, MIN_CHUNK_SIZE);
+
     while (true) {
-        decompressedData.resize(decompressedData.size() + CHUNK_SIZE);
+        decompressedData.resize(decompressedData.size() + chunkSize);
         strm.next_out = reinterpret_cast<Bytef *>(&decompressedData[strm.total_out]);
-        strm.avail_out = CHUNK_SIZE;
+        strm.avail_out = static_cast<unsigned int>(decompressedData.size() - strm.total_out);
 
         error = inflate(&strm, Z_NO_FLUSH);
         if (error == Z_STREAM_END)
             break;
         else if (error != Z_OK)
             throw Xcept("inflate() failed: {}", zError(error));
+
+        chunkSize = std::max(decompressedData.size(), MIN_CHUNK_SIZE);
     }
 
     decompressedData.resize(strm.total_out);
 }
 
-static bool ReadGsfData(
-    std::span<const uint8_t> gsfData,
-    std::vector<uint8_t> &reservedData,
-    std::vector<uint8_t> &programData,
-    std::string &tagData
-)
+/* The program data of a gsflib starts with a 12 byte header, which contains the ROM size.
+ * Only decompress the header to size the output buffer. Returns 0 if the header is invalid. */
+static size_t PeekProgramSize(std::span<const uint8_t> compressedProgramData)
 {
-    if (gsfData.size() < 16)
-        return false;
+    const size_t PROGRAM_HEADER_SIZE = 12;
+    std::array<uint8_t, PROGRAM_HEADER_SIZE> header;
 
+    z_stream strm{};
+    strm.next_in = reinterpret_cast<Bytef *>(const_cast<uint8_t *>(compressedProgramData.data()));
+    strm.avail_in = static_cast<unsigned int>(compressedProgramData.size());
+    if (inflateInit(&strm) != Z_OK)
+        return 0;
+
+    strm.next_out = header.data();
+    strm.avail_out = static_cast<unsigned int>(header.size());
+    const int error = inflate(&strm, Z_NO_FLUSH);
+    const size_t decompressedSize = strm.total_out;
+    inflateEnd(&strm);
+
+    if ((error != Z_OK && error != Z_STREAM_END) || decompressedSize != header.size())
+        return 0;
+
+    const size_t romSize =
+        static_cast<size_t>((header[8] << 0) | (header[9] << 8) | (header[10] << 16) | (header[11] << 24));
+    if (romSize > AGB_ROM_SIZE)
+        return 0;
+    return PROGRAM_HEADER_SIZE + romSize;
+}
+
+struct GsfSections
+{
+    std::span<const uint8_t> compReservedData;
+    std::span<const uint8_t> compProgramData;
+    std::span<const uint8_t> tagData;
+    uint32_t compProgramCrc32;
+};
+
+/* Returns false if the data is not a GSF file. */
+bool Gsf::IsGsf(std::span<const uint8_t> header)
+{
     const uint8_t GSF_VERSION_BYTE = 0x22;
-    if (gsfData[0] != 'P' || gsfData[1] != 'S' || gsfData[2] != 'F' || gsfData[3] != GSF_VERSION_BYTE)
+    return header.size() >= 4 && header[0] == 'P' && header[1] == 'S' && header[2] == 'F'
+        && header[3] == GSF_VERSION_BYTE;
+}
+
+static bool ReadGsfSections(std::span<const uint8_t> gsfData, GsfSections &sections)
+{
+    if (gsfData.size() < 16 || !Gsf::IsGsf(gsfData))
         return false;
 
     const size_t compReservedSize =
         static_cast<size_t>((gsfData[4] << 0) | (gsfData[5] << 8) | (gsfData[6] << 16) | (gsfData[7] << 24));
     const size_t compProgramSize =
         static_cast<size_t>((gsfData[8] << 0) | (gsfData[9] << 8) | (gsfData[10] << 16) | (gsfData[11] << 24));
-    const uint32_t compProgramCrc32 =
+    sections.compProgramCrc32 =
         static_cast<uint32_t>((gsfData[12] << 0) | (gsfData[13] << 8) | (gsfData[14] << 16) | (gsfData[15] << 24));
 
     if (gsfData.size() < (16 + compReservedSize + compProgramSize))
         throw Xcept("ReadGsfData(): ill-formed gsflib, size in header larger than available");
 
     size_t dataOffset = 16;
-    if (compReservedSize > 0) {
-        Decompress(gsfData.subspan(dataOffset, compReservedSize), reservedData);
-        dataOffset += compReservedSize;
-    } else {
-        reservedData.clear();
-    }
+    sections.compReservedData = gsfData.subspan(dataOffset, compReservedSize);
+    dataOffset += compReservedSize;
 
+    sections.compProgramData = gsfData.subspan(dataOffset, compProgramSize);
     unsigned long crc = crc32_z(0, nullptr, 0);
-    crc = crc32_z(crc, reinterpret_cast<const Bytef *>(&gsfData[dataOffset]), compProgramSize);
-    if (crc != compProgramCrc32)
+    crc = crc32_z(crc, sections.compProgramData.data(), sections.compProgramData.size());
+    if (crc != sections.compProgramCrc32)
         throw Xcept(
-            "ReadGsfData(): program data crc32 mismatch: expected={:#08x} calculated={:#08x}", compProgramCrc32, crc
+            "ReadGsfData(): program data crc32 mismatch: expected={:#08x} calculated={:#08x}",
+            sections.compProgramCrc32,
+            crc
         );
-
-    Decompress(gsfData.subspan(dataOffset, compProgramSize), programData);
     dataOffset += compProgramSize;
 
     size_t tagDataSize = gsfData.size() - dataOffset;
     if (tagDataSize > 50000)
         tagDataSize = 50000;    // do I understand Neill Corlett's doc right that this is limited to 50k bytes?
+    sections.tagData = gsfData.subspan(dataOffset, tagDataSize);
+    return true;
+}
+
+static bool ReadGsfData(
+    std::span<const uint8_t> gsfData,
+    std::vector<uint8_t> &reservedData,
+    std::vector<uint8_t> &programData,
+    std::string &tagData
+)
+{
+    GsfSections sections;
+    if (!ReadGsfSections(gsfData, sections))
+        return false;
 
-    tagData.assign(reinterpret_cast<const char *>(&gsfData[dataOffset]), tagDataSize);
+    if (sections.compReservedData.size() > 0)
+        Decompress(sections.compReservedData, reservedData);
+    else
+        reservedData.clear();
+
+    Decompress(sections.compProgramData, programData);
+    tagData.assign(reinterpret_cast<const char *>(sections.tagData.data()), sections.tagData.size());
     return true;
 }
 
+/*
+ * gsflib cache
+ *
+ * Decompressing a gsflib takes a noticeable amount of time, so the decompressed ROM data is cached on disk.
+ * Cache files are named by a hash of the compressed program data. The least recently used files are removed
+ * if the cache exceeds GSF_CACHE_MAX_SIZE.
+ */
+
+static const std::array<char, 8> GSF_CACHE_MAGIC = {'A', 'G', 'B', 'P', 'G', 'S', 'F', 'C'};
+
+static std::filesystem::path GsfCacheDirectory()
+{
+    return OS::GetLocalConfigDirectory() / "agbplay" / "gsf-cache";
+}
+
+static std::filesystem::path GsfCachePath(const GsfSections &sections)
+{
+    /* CRC32 is already verified by ReadGsfSections, Adler-32 makes accidental collisions very unlikely */
+    const uint32_t adler = static_cast<uint32_t>(
+        adler32_z(adler32_z(0, nullptr, 0), sections.compProgramData.data(), sections.compProgramData.size())
+    );
+    return GsfCacheDirectory()
+        / fmt::format("{:08x}{:08x}-{:x}.bin", sections.compProgramCrc32, adler, sections.compProgramData.size());
+}
+
+static bool GsfCacheLoad(const std::filesystem::path &cachePath, std::vector<uint8_t> &romData)
+{
+    std::ifstream ifs(cachePath, std::ios::binary);
+    if (!ifs.is_open())
+        return false;
+
+    std::array<char, 8> magic;
+    uint64_t size;
+    ifs.read(magic.data(), magic.size());
+    ifs.read(reinterpret_cast<char *>(&size), sizeof(size));
+    if (!ifs || magic != GSF_CACHE_MAGIC || size > AGB_ROM_SIZE)
+        return false;
+
+    romData.resize(static_cast<size_t>(size));
+    ifs.read(reinterpret_cast<char *>(romData.data()), static_cast<std::streamsize>(romData.size()));
+    if (!ifs || ifs.peek() != std::ifstream::traits_type::eof()) {
+        romData.clear();
+        return false;
+    }
+
+    /* mark as recently used */
+    std::error_code ec;
+    std::filesystem::last_write_time(cachePath, std::filesystem::file_time_type::clock::now(), ec);
+    return true;
+}
+
+static void GsfCacheStore(const std::filesystem::path &cachePath, std::span<const uint8_t> romData)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(cachePath.parent_path(), ec);
+    if (ec)
+        return;
+
+    std::vector<uint8_t> data(GSF_CACHE_MAGIC.begin(), GSF_CACHE_MAGIC.end());
+    const uint64_t size = romData.size();
+    const uint8_t *sizeBytes = reinterpret_cast<const uint8_t *>(&size);
+    data.insert(data.end(), sizeBytes, sizeBytes + sizeof(size));
+    data.insert(data.end(), romData.begin(), romData.end());
+    if (!OS::WriteFileAtomic(cachePath, data))
+        return;
+
+    /* remove least recently used files */
+    struct CacheFile
+    {
+        std::filesystem::path path;
+        std::filesystem::file_time_type time;
+        uintmax_t size;
+    };
+    std::vector<CacheFile> cacheFiles;
+    uintmax_t totalSize = 0;
+    for (const auto &dirEnt : std::filesystem::directory_iterator(cachePath.parent_path(), ec)) {
+        if (!dirEnt.is_regular_file(ec) || dirEnt.path().extension() != ".bin")
+            continue;
+        cacheFiles.emplace_back(dirEnt.path(), dirEnt.last_write_time(ec), dirEnt.file_size(ec));
+        totalSize += cacheFiles.back().size;
+    }
+
+    std::sort(cacheFiles.begin(), cacheFiles.end(), [](const CacheFile &a, const CacheFile &b) {
+        return a.time < b.time;
+    });
+    for (const CacheFile &cacheFile : cacheFiles) {
+        if (totalSize <= GSF_CACHE_MAX_SIZE)
+            break;
+        if (cacheFile.path == cachePath)
+            continue;
+        if (std::filesystem::remove(cacheFile.path, ec))
+            totalSize -= cacheFile.size;
+    }
+}
+
+/*
+ * public Gsf
+ */
+
 bool Gsf::GetRomData(std::span<const uint8_t> gsfData, std::vector<uint8_t> &resultRomData)
 {
-    std::vector<uint8_t> reservedData;
-    std::string tagData;
-    if (!ReadGsfData(gsfData, reservedData, resultRomData, tagData)) {
+    GsfSections sections;
+    if (!ReadGsfSections(gsfData, sections)) {
         resultRomData.clear();
         return false;
     }
 
+    /* The reserved section is not used for GBA, so it is not decompressed. */
+    std::filesystem::path cachePath;
+    try {
+        cachePath = GsfCachePath(sections);
+        if (GsfCacheLoad(cachePath, resultRomData))
+            return true;
+    } catch (const std::exception &e) {
+        /* continue without cache if the cache directory cannot be determined */
+        Debug::print("Gsf::GetRomData(): Unable to use gsflib cache: {}", e.what());
+        cachePath.clear();
+    }
+
+    Decompress(sections.compProgramData, resultRomData, PeekProgramSize(sections.compProgramData));
+
     if (resultRomData.size() < 12)
         throw Xcept("Gsf::GetRomData(): program data is ill-formed (size < 12)");
 
@@ -129,6 +311,9 @@ bool Gsf::GetRomData(std::span<const uint8_t> gsfData, std::vector<uint8_t> &res
     //    ofs.close();
     //}
 
+    if (!cachePath.empty())
+        GsfCacheStore(cachePath, resultRomData);
+
     return true;
 }
 
@@ -173,6 +358,20 @@ void Gsf::GetSongInfo(std::span<const uint8_t> gsfData, std::string &name, uint1
         name = "<no title in GSF>";
 }
 
+void Gsf::GetSongInfos(
+    std::span<const std::vector<uint8_t>> gsfFiles, std::vector<std::string> &names, std::vector<uint16_t> &ids
+)
+{
+    names.assign(gsfFiles.size(), std::string());
+    ids.assign(gsfFiles.size(), 0);
+
+    /* Only the first error is reported, like when parsing the files one by one. */
+    ParallelForChunks(0, gsfFiles.size(), GSF_FILES_PER_THREAD, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            GetSongInfo(gsfFiles[i], names[i], ids[i]);
+    });
+}
+
 std::string Gsf::GuessGameCodeFromPath(const std::filesystem::path &p)
 {
     /* This is not unicode safe, but game codes are 4 byte ASCII anyway,
@@ -8,7 +8,13 @@
 
 namespace Gsf
 {
+    /* Checks for the GSF magic, which is in the first 4 bytes of the file. */
+    bool IsGsf(std::span<const uint8_t> header);
     bool GetRomData(std::span<const uint8_t> gsfData, std::vector<uint8_t> &resultRomData);
     void GetSongInfo(std::span<const uint8_t> gsfData, std::string &name, uint16_t &id);
+    /* Same as GetSongInfo for multiple minigsf files, which are parsed in parallel. */
+    void GetSongInfos(
+        std::span<const std::vector<uint8_t>> gsfFiles, std::vector<std::string> &names, std::vector<uint16_t> &ids
+    );
     std::string GuessGameCodeFromPath(const std::filesystem::path &p);
 }    // namespace Gsf
@@ -0,0 +1,137 @@
+#include "InstrumentCache.hpp"
+
+#include "Debug.hpp"
+#include "Rom.hpp"
+#include "SoundData.hpp"
+#include "Xcept.hpp"
+
+/*
+ * public InstrumentCache
+ */
+
+InstrumentCache::InstrumentCache(const Rom &rom) : rom(rom)
+{
+}
+
+const InstrumentDescriptor &InstrumentCache::Get(size_t bankPos, uint8_t prog, uint8_t key)
+{
+    const auto [it, inserted] = instruments.try_emplace(MakeKey(bankPos, prog, key));
+    if (inserted) {
+        try {
+            Resolve(it->second, bankPos, prog, key);
+        } catch (const Xcept &e) {
+            it->second.playable = false;
+            it->second.error = e.what();
+        }
+    }
+    return it->second;
+}
+
+/*
+ * private InstrumentCache
+ */
+
+void InstrumentCache::Resolve(InstrumentDescriptor &instr, size_t bankPos, uint8_t prog, uint8_t key) const
+{
+    // find instrument definition
+    size_t instrPos = bankPos + prog * 12;
+    if (const uint8_t bankDataType = rom.ReadU8(instrPos + 0x0); bankDataType & BANKDATA_TYPE_SPLIT) {
+        const size_t subBankPos = rom.ReadAgbPtrToPos(instrPos + 0x4);
+        const size_t subKeyMap = rom.ReadAgbPtrToPos(instrPos + 0x8);
+        instrPos = subBankPos + rom.ReadU8(subKeyMap + key) * 12;
+        if (rom.ReadU8(instrPos + 0x0) & (BANKDATA_TYPE_SPLIT | BANKDATA_TYPE_RHYTHM)) {
+            Debug::print("cmdPlayNote: attempting to play recursive key split");
+            return;
+        }
+        instr.midiKeyPitch = key;
+    } else if (bankDataType == BANKDATA_TYPE_RHYTHM) {
+        const size_t subBankPos = rom.ReadAgbPtrToPos(instrPos + 0x4);
+        instrPos = subBankPos + key * 12;
+        if (rom.ReadU8(instrPos + 0x0) & (BANKDATA_TYPE_SPLIT | BANKDATA_TYPE_RHYTHM)) {
+            Debug::print("cmdPlayNote: attempting to play recursive rhythm part");
+            return;
+        }
+        if (const uint8_t instrPan = rom.ReadU8(instrPos + 0x3); instrPan & 0x80)
+            instr.rhythmPan = static_cast<int8_t>((instrPan - 0xC0) * 2);
+        instr.midiKeyPitch = rom.ReadU8(instrPos + 0x1);
+    } else {
+        instr.midiKeyPitch = key;
+    }
+
+    instr.keyResolved = true;
+    instr.instrPos = instrPos;
+    instr.psgLength = rom.ReadU8(instrPos + 0x2);
+    instr.adsr.att = rom.ReadU8(instrPos + 0x8);
+    instr.adsr.dec = rom.ReadU8(instrPos + 0x9);
+    instr.adsr.sus = rom.ReadU8(instrPos + 0xA);
+    instr.adsr.rel = rom.ReadU8(instrPos + 0xB);
+    instr.instrType = rom.ReadU8(instrPos);
+
+    if (instr.instrType & BANKDATA_TYPE_CGB) {
+        instr.sweep = rom.ReadU8(instrPos + 0x3);
+        instr.instrDutyWaveNp = rom.ReadU32(instrPos + 0x4);
+
+        switch (instr.instrType & BANKDATA_TYPE_CGB) {
+        case BANKDATA_TYPE_SQ1:
+        case BANKDATA_TYPE_SQ2:
+        case BANKDATA_TYPE_WAVE:
+        case BANKDATA_TYPE_NOISE:
+            instr.playable = true;
+            break;
+        default:
+            Debug::print(
+                "CGB Error: Invalid CGB Type: [{:08X}]={:02X}, instrument: [{:08X}]",
+                instrPos,
+                instr.instrType,
+                instrPos
+            );
+            break;
+        }
+    } else {
+        ResolveSample(instr);
+    }
+}
+
+void InstrumentCache::ResolveSample(InstrumentDescriptor &instr) const
+{
+    const size_t instrPos = instr.instrPos;
+    const size_t samplePos = rom.ReadAgbPtrToPos(instrPos + 0x4);
+    SampleInfo &sinfo = instr.sInfo;
+
+    if (rom.ReadU8(samplePos + 0x0) == 0) {
+        sinfo.gamefreakCompressed = false;
+    } else if (rom.ReadU8(samplePos + 0x0) == 1) {
+        sinfo.gamefreakCompressed = true;
+    } else {
+        Debug::print(
+            "Sample Error: Unknown/unsupported sample mode: [{:08X}]={:02X}, instrument: [{:08X}]",
+            samplePos,
+            rom.ReadU8(samplePos),
+            instrPos
+        );
+        return;
+    }
+
+    sinfo.loopEnabled = rom.ReadU8(samplePos + 0x3) & 0xC0;
+    sinfo.midCfreq = static_cast<float>(rom.ReadU32(samplePos + 4)) / 1024.0f;
+    sinfo.loopPos = rom.ReadU32(samplePos + 8);
+    sinfo.endPos = rom.ReadU32(samplePos + 12);
+
+    /* Fix malformed loops found in some romhacks */
+    if (sinfo.loopPos > sinfo.endPos) {
+        Debug::print("Sample Warning: Loop start is after loop end, instrument: [{:#08X}]", samplePos);
+        sinfo.loopPos = 0;
+    }
+    if (sinfo.loopPos == sinfo.endPos) {
+        sinfo.loopEnabled = false;
+    }
+
+    if (!rom.ValidRange(samplePos, 16)) {
+        Debug::print("Sample Error: Sample header reaches beyond end of file: instrument: [{:08X}]", instrPos);
+        return;
+    }
+
+    sinfo.samplePos = samplePos;
+    sinfo.samplePtr = static_cast<const int8_t *>(rom.GetPtr(samplePos + 16));
+    instr.playable = true;
+}
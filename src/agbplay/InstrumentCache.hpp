@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+class Rom;
+
+/* A voicegroup entry with key split and rhythm indirection already resolved,
+ * including the decoded sample header of PCM instruments. */
+struct InstrumentDescriptor
+{
+    /* keyResolved is set if key split and rhythm lookup succeeded, which is the point after which
+     * MP2K resets the LFO. playable is set if a voice has to be created for the note. If an error
+     * is set, playing the note has to throw it, keyResolved tells whether before or after the LFO reset. */
+    bool keyResolved = false;
+    bool playable = false;
+    std::string error;
+
+    size_t instrPos = 0;
+    uint8_t instrType = 0;
+    uint8_t midiKeyPitch = 0;
+    int8_t rhythmPan = 0;
+    uint8_t psgLength = 0;
+    ADSR adsr;
+
+    /* CGB instruments */
+    uint8_t sweep = 0;
+    uint32_t instrDutyWaveNp = 0;
+
+    /* PCM instruments */
+    SampleInfo sInfo{};
+};
+
+/* The InstrumentCache resolves the instrument, which is used for a note, from the ROM once and
+ * caches it for the lifetime of the cache. */
+class InstrumentCache
+{
+public:
+    InstrumentCache(const Rom &rom);
+    InstrumentCache(const InstrumentCache &) = delete;
+    InstrumentCache &operator=(const InstrumentCache &) = delete;
+
+    const InstrumentDescriptor &Get(size_t bankPos, uint8_t prog, uint8_t key);
+
+private:
+    static uint64_t MakeKey(size_t bankPos, uint8_t prog, uint8_t key)
+    {
+        return (static_cast<uint64_t>(bankPos) << 16) | (static_cast<uint64_t>(prog) << 8) | key;
+    }
+
+    void Resolve(InstrumentDescriptor &instr, size_t bankPos, uint8_t prog, uint8_t key) const;
+    void ResolveSample(InstrumentDescriptor &instr) const;
+
+    const Rom &rom;
+    std::unordered_map<uint64_t, InstrumentDescriptor> instruments;
+};
@@ -1,6 +1,8 @@
 #include "LoudnessCalculator.hpp"
 
 #include "Constants.hpp"
+#include "RenderProfiler.hpp"
+#include "StateStream.hpp"
 #include "Util.hpp"
 
 #include <cassert>
@@ -14,6 +16,7 @@ LoudnessCalculator::LoudnessCalculator(float lowpassFreq, uint32_t sampleRate) :
 
 void LoudnessCalculator::CalcLoudness(std::span<const sample> buffer)
 {
+    PROFILE_STAGE(LOUDNESS);
     using std::numbers::sqrt2_v;
 
     for (size_t i = 0; i < buffer.size(); i++) {
@@ -52,6 +55,26 @@ void LoudnessCalculator::Reset()
     peakRight = 0.0f;
 }
 
+void LoudnessCalculator::SaveState(StateWriter &w) const
+{
+    w.Write(avgVolLeftSq);
+    w.Write(avgVolRightSq);
+    w.Write(rmsLeft);
+    w.Write(rmsRight);
+    w.Write(peakLeft);
+    w.Write(peakRight);
+}
+
+void LoudnessCalculator::LoadState(StateReader &r)
+{
+    r.Read(avgVolLeftSq);
+    r.Read(avgVolRightSq);
+    r.Read(rmsLeft);
+    r.Read(rmsRight);
+    r.Read(peakLeft);
+    r.Read(peakRight);
+}
+
 float LoudnessCalculator::calcAlpha(float lowpassFreq, uint32_t sampleRate)
 {
     const float rc = 1.0f / (lowpassFreq * 2.0f * std::numbers::pi_v<float>);
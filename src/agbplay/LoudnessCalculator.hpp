@@ -6,6 +6,9 @@
 #include <cstdint>
 #include <span>
 
+class StateWriter;
+class StateReader;
+
 class LoudnessCalculator
 {
 public:
@@ -17,6 +20,8 @@ public:
     void CalcLoudness(std::span<const sample> buffer);
     void GetLoudness(float &rmsLeft, float &rmsRight, float &peakLeft, float &peakRight) const;
     void Reset();
+    void SaveState(StateWriter &w) const;
+    void LoadState(StateReader &r);
 
 private:
     static float calcAlpha(float lowpassFreq, uint32_t sampleRate);
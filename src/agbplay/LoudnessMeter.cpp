@@ -0,0 +1,170 @@
+#include "LoudnessMeter.hpp"
+
+#include "RenderProfiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <numeric>
+
+static const double LOUDNESS_OFFSET = -0.691;
+static const double ABSOLUTE_GATE = -70.0;    // LUFS
+static const double RELATIVE_GATE = -10.0;    // LU
+
+static double powerToLoudness(double power)
+{
+    if (power <= 0.0)
+        return LoudnessMeter::SILENCE;
+    return LOUDNESS_OFFSET + 10.0 * std::log10(power);
+}
+
+static double loudnessToPower(double loudness)
+{
+    return std::pow(10.0, (loudness - LOUDNESS_OFFSET) / 10.0);
+}
+
+LoudnessMeter::LoudnessMeter(uint32_t sampleRate) :
+    stepLength(std::max<size_t>(static_cast<size_t>(std::lround(sampleRate * 0.1)), 1)),
+    oversampling(sampleRate < 96000 ? 4 : (sampleRate < 192000 ? 2 : 1))
+{
+    using std::numbers::pi;
+
+    /* The filters of BS.1770 are specified for 48 kHz only. These are the analog prototypes of the specified
+     * filters, so they can be used at any sample rate. */
+    const double fs = static_cast<double>(sampleRate);
+    {
+        const double f0 = 1681.974450955533;
+        const double gain = 3.999843853973347;
+        const double q = 0.7071752369554196;
+        const double k = std::tan(pi * f0 / fs);
+        const double vh = std::pow(10.0, gain / 20.0);
+        const double vb = std::pow(vh, 0.4996667741545416);
+        const double a0 = 1.0 + k / q + k * k;
+        Biquad shelf;
+        shelf.b0 = (vh + vb * k / q + k * k) / a0;
+        shelf.b1 = 2.0 * (k * k - vh) / a0;
+        shelf.b2 = (vh - vb * k / q + k * k) / a0;
+        shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+        shelf.a2 = (1.0 - k / q + k * k) / a0;
+        shelfFilter.fill(shelf);
+    }
+    {
+        const double f0 = 38.13547087602444;
+        const double q = 0.5003270373238773;
+        const double k = std::tan(pi * f0 / fs);
+        const double a0 = 1.0 + k / q + k * k;
+        Biquad highpass;
+        highpass.b0 = 1.0;
+        highpass.b1 = -2.0;
+        highpass.b2 = 1.0;
+        highpass.a1 = 2.0 * (k * k - 1.0) / a0;
+        highpass.a2 = (1.0 - k / q + k * k) / a0;
+        highpassFilter.fill(highpass);
+    }
+
+    /* Hann windowed sinc, which interpolates between the samples. Each phase is normalized to unity gain. */
+    if (oversampling > 1) {
+        const size_t numTaps = TRUE_PEAK_TAPS * oversampling;
+        truePeakCoeffs.resize(numTaps);
+        for (size_t phase = 0; phase < oversampling; phase++) {
+            double sum = 0.0;
+            for (size_t tap = 0; tap < TRUE_PEAK_TAPS; tap++) {
+                const size_t n = tap * oversampling + phase;
+                const double t = (static_cast<double>(n) - static_cast<double>(numTaps - 1) / 2.0)
+                    / static_cast<double>(oversampling);
+                const double sinc = t == 0.0 ? 1.0 : std::sin(pi * t) / (pi * t);
+                const double window =
+                    std::pow(std::sin(pi * (static_cast<double>(n) + 0.5) / static_cast<double>(numTaps)), 2.0);
+                truePeakCoeffs[phase * TRUE_PEAK_TAPS + tap] = static_cast<float>(sinc * window);
+                sum += sinc * window;
+            }
+            for (size_t tap = 0; tap < TRUE_PEAK_TAPS; tap++)
+                truePeakCoeffs[phase * TRUE_PEAK_TAPS + tap] /= static_cast<float>(sum);
+        }
+    }
+}
+
+void LoudnessMeter::Process(std::span<const sample> buffer)
+{
+    PROFILE_STAGE(LOUDNESS);
+
+    for (const sample &s : buffer) {
+        const std::array<float, 2> channels = {s.left, s.right};
+
+        for (size_t c = 0; c < channels.size(); c++) {
+            const double y = highpassFilter[c].Process(shelfFilter[c].Process(channels[c]));
+            stepPower += y * y;
+            truePeak = std::max(truePeak, std::abs(channels[c]));
+        }
+
+        if (++stepPos == stepLength) {
+            stepPowers[stepsDone % BLOCK_STEPS] = stepPower;
+            stepsDone++;
+            stepPos = 0;
+            stepPower = 0.0;
+
+            if (stepsDone >= BLOCK_STEPS) {
+                const double blockSum = std::accumulate(stepPowers.begin(), stepPowers.end(), 0.0);
+                blockPowers.emplace_back(blockSum / static_cast<double>(BLOCK_STEPS * stepLength));
+            }
+        }
+
+        if (oversampling == 1)
+            continue;
+
+        truePeakPos = (truePeakPos + TRUE_PEAK_TAPS - 1) % TRUE_PEAK_TAPS;
+        for (size_t c = 0; c < channels.size(); c++) {
+            std::array<float, TRUE_PEAK_TAPS * 2> &history = truePeakHistory[c];
+            history[truePeakPos] = channels[c];
+            history[truePeakPos + TRUE_PEAK_TAPS] = channels[c];
+
+            for (size_t phase = 0; phase < oversampling; phase++) {
+                const float *coeffs = &truePeakCoeffs[phase * TRUE_PEAK_TAPS];
+                float y = 0.0f;
+                for (size_t tap = 0; tap < TRUE_PEAK_TAPS; tap++)
+                    y += coeffs[tap] * history[truePeakPos + tap];
+                truePeak = std::max(truePeak, std::abs(y));
+            }
+        }
+    }
+}
+
+double LoudnessMeter::GetIntegratedLoudness() const
+{
+    const double absoluteThreshold = loudnessToPower(ABSOLUTE_GATE);
+
+    double sum = 0.0;
+    size_t count = 0;
+    for (const double power : blockPowers) {
+        if (power > absoluteThreshold) {
+            sum += power;
+            count++;
+        }
+    }
+    if (count == 0)
+        return SILENCE;
+
+    const double relativeThreshold = std::max(
+        absoluteThreshold, loudnessToPower(powerToLoudness(sum / static_cast<double>(count)) + RELATIVE_GATE)
+    );
+
+    sum = 0.0;
+    count = 0;
+    for (const double power : blockPowers) {
+        if (power > relativeThreshold) {
+            sum += power;
+            count++;
+        }
+    }
+    if (count == 0)
+        return SILENCE;
+
+    return powerToLoudness(sum / static_cast<double>(count));
+}
+
+double LoudnessMeter::GetTruePeak() const
+{
+    if (truePeak <= 0.0f)
+        return SILENCE;
+    return 20.0 * std::log10(static_cast<double>(truePeak));
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Types.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+/* Loudness and true peak meter according to ITU-R BS.1770-4 (EBU R128), which measures a whole song while it is
+ * rendered. Unlike the LoudnessCalculator, which follows the current volume for visualization, the results are
+ * only meaningful after the complete song has been processed. */
+class LoudnessMeter
+{
+public:
+    static constexpr double SILENCE = -std::numeric_limits<double>::infinity();
+
+    LoudnessMeter(uint32_t sampleRate);
+    LoudnessMeter(const LoudnessMeter &) = delete;
+    LoudnessMeter &operator=(const LoudnessMeter &) = delete;
+
+    void Process(std::span<const sample> buffer);
+    /* gated integrated loudness in LUFS, SILENCE if no block is above the absolute gate */
+    double GetIntegratedLoudness() const;
+    /* in dBTP, SILENCE if only zero samples have been processed */
+    double GetTruePeak() const;
+
+private:
+    struct Biquad
+    {
+        double b0, b1, b2, a1, a2;
+        double z1 = 0.0;
+        double z2 = 0.0;
+
+        double Process(double x)
+        {
+            const double y = b0 * x + z1;
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+            return y;
+        }
+    };
+
+    static const size_t TRUE_PEAK_TAPS = 12;    // per phase
+    static const size_t BLOCK_STEPS = 4;        // 400 ms gating blocks with 100 ms steps
+
+    /* K-weighting, i.e. high shelf and high pass, per channel */
+    std::array<Biquad, 2> shelfFilter;
+    std::array<Biquad, 2> highpassFilter;
+
+    size_t stepLength;
+    size_t stepPos = 0;
+    double stepPower = 0.0;
+    std::array<double, BLOCK_STEPS> stepPowers{};
+    size_t stepsDone = 0;
+    std::vector<double> blockPowers;    // mean square of each gating block
+
+    /* polyphase interpolation filter, the history of each channel is stored twice to avoid wrapping */
+    size_t oversampling;
+    std::vector<float> truePeakCoeffs;    // [phase][tap]
+    std::array<std::array<float, TRUE_PEAK_TAPS * 2>, 2> truePeakHistory{};
+    size_t truePeakPos = 0;
+    float truePeak = 0.0f;
+};
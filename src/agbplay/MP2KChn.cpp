@@ -1,6 +1,7 @@
 #include "MP2KChn.hpp"
 
 #include "MP2KTrack.hpp"
+#include "StateStream.hpp"
 
 #include <cassert>
 
@@ -54,3 +55,39 @@ void MP2KChn::Kill() noexcept
     envState = EnvState::DEAD;
     RemoveFromTrack();
 }
+
+void MP2KChn::SaveState(StateWriter &w) const
+{
+    w.Write(note);
+    w.Write(env);
+    w.Write(envState);
+    w.Write(pos);
+    w.Write(interPos);
+    w.Write(freq);
+    w.Write(stop);
+
+    w.Write<bool>(rs != nullptr);
+    if (rs) {
+        w.Write(rs->GetType());
+        rs->SaveState(w);
+    }
+}
+
+void MP2KChn::LoadState(StateReader &r)
+{
+    r.Read(note);
+    r.Read(env);
+    r.Read(envState);
+    r.Read(pos);
+    r.Read(interPos);
+    r.Read(freq);
+    r.Read(stop);
+
+    /* The resampler type may depend on the settings at note start, so do not rely on the constructor. */
+    if (r.Read<bool>()) {
+        rs = Resampler::MakeResampler(r.Read<ResamplerType>());
+        rs->LoadState(r);
+    } else {
+        rs.reset();
+    }
+}
@@ -6,6 +6,8 @@
 #include <memory>
 
 struct MP2KTrack;
+class StateWriter;
+class StateReader;
 
 struct MP2KChn
 {
@@ -23,6 +25,10 @@ struct MP2KChn
     virtual bool TickNote() noexcept = 0;
     virtual VoiceFlags GetVoiceType() const noexcept = 0;
 
+    /* Track linkage is not part of the channel state and has to be restored by the caller. */
+    void SaveState(StateWriter &w) const;
+    void LoadState(StateReader &r);
+
     /* linked list of channels inside a track. */
     MP2KChn *prev = nullptr;
     MP2KChn *next = nullptr;
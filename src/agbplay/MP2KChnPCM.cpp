@@ -3,6 +3,8 @@
 #include "Constants.hpp"
 #include "Debug.hpp"
 #include "MP2KContext.hpp"
+#include "RenderProfiler.hpp"
+#include "StateStream.hpp"
 #include "Util.hpp"
 #include "Xcept.hpp"
 
@@ -70,6 +72,72 @@ MP2KChnPCM::MP2KChnPCM(MP2KContext &ctx, MP2KTrack *track, SampleInfo sInfo, ADS
     }
 }
 
+void MP2KChnPCM::SaveState(StateWriter &w) const
+{
+    /* constructor arguments */
+    w.Write(type);
+    w.Write(sInfo.samplePos);
+    w.Write(sInfo.midCfreq);
+    w.Write(sInfo.loopPos);
+    w.Write(sInfo.endPos);
+    w.Write(sInfo.loopEnabled);
+    w.Write(sInfo.gamefreakCompressed);
+    w.Write(fixed);
+
+    MP2KChn::SaveState(w);
+    w.Write(isSynth);
+    w.Write(levelMPTcompressed);
+    w.Write(shiftMPTcompressed);
+    w.Write(envInterStep);
+    w.Write(envLevelCur);
+    w.Write(envLevelPrev);
+    w.Write(leftVolCur);
+    w.Write(leftVolPrev);
+    w.Write(rightVolCur);
+    w.Write(rightVolPrev);
+}
+
+MP2KChnPCM &
+    MP2KChnPCM::Restore(std::list<MP2KChnPCM> &channels, MP2KContext &ctx, MP2KTrack *track, StateReader &r)
+{
+    const Type type = r.Read<Type>();
+    SampleInfo sInfo;
+    r.Read(sInfo.samplePos);
+    r.Read(sInfo.midCfreq);
+    r.Read(sInfo.loopPos);
+    r.Read(sInfo.endPos);
+    r.Read(sInfo.loopEnabled);
+    r.Read(sInfo.gamefreakCompressed);
+    const bool fixed = r.Read<bool>();
+
+    if (!ctx.rom.ValidRange(sInfo.samplePos, 16))
+        throw Xcept("Cannot restore PCM channel: Invalid sample position [{:#08x}]", sInfo.samplePos);
+    sInfo.samplePtr = static_cast<const int8_t *>(ctx.rom.GetPtr(sInfo.samplePos + 16));
+
+    /* The constructor flips the length of Camelot ADPCM samples, so pass the original length. */
+    SampleInfo ctorInfo = sInfo;
+    if (type == Type::CAMELOT_ADPCM)
+        ctorInfo.endPos = -ctorInfo.endPos;
+
+    MP2KChnPCM &chn = channels.emplace_back(ctx, track, ctorInfo, ADSR{}, Note{}, fixed);
+    chn.type = type;
+    chn.sInfo = sInfo;
+
+    chn.MP2KChn::LoadState(r);
+    r.Read(chn.isSynth);
+    r.Read(chn.levelMPTcompressed);
+    r.Read(chn.shiftMPTcompressed);
+    r.Read(chn.envInterStep);
+    r.Read(chn.envLevelCur);
+    r.Read(chn.envLevelPrev);
+    r.Read(chn.leftVolCur);
+    r.Read(chn.leftVolPrev);
+    r.Read(chn.rightVolCur);
+    r.Read(chn.rightVolPrev);
+
+    return chn;
+}
+
 void MP2KChnPCM::Process(std::span<sample> buffer, const MixingArgs &args)
 {
     if (envState == EnvState::DEAD)
@@ -309,7 +377,11 @@ void MP2KChnPCM::processNormal(std::span<sample> buffer, ProcArgs &cargs)
     else
         assert(false);
 
-    const bool running = rs->Process(ctx.mixer.scratchBuffer, cargs.interStep, cb);
+    bool running;
+    {
+        PROFILE_STAGE(RESAMPLER);
+        running = rs->Process(ctx.mixer.scratchBuffer, cargs.interStep, cb);
+    }
 
     for (size_t i = 0; i < buffer.size(); i++) {
         const float samp = ctx.mixer.scratchBuffer[i];
@@ -5,10 +5,13 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <list>
 #include <memory>
 #include <span>
 
 struct MP2KContext;
+class StateWriter;
+class StateReader;
 
 class MP2KChnPCM : public MP2KChn
 {
@@ -35,6 +38,10 @@ public:
     bool TickNote() noexcept override;
     VoiceFlags GetVoiceType() const noexcept override;
 
+    void SaveState(StateWriter &w) const;
+    static MP2KChnPCM &
+        Restore(std::list<MP2KChnPCM> &channels, MP2KContext &ctx, MP2KTrack *track, StateReader &r);
+
 private:
     void stepEnvelope();
     void updateVolFade();
@@ -66,10 +73,10 @@ private:
 
     /* all of these values have pairs of new and old value to allow smooth fades */
     uint8_t envInterStep = 0;
-    uint8_t envLevelCur;
-    uint8_t envLevelPrev;
+    uint8_t envLevelCur = 0;
+    uint8_t envLevelPrev = 0;
     uint8_t leftVolCur = 0;
-    uint8_t leftVolPrev;
+    uint8_t leftVolPrev = 0;
     uint8_t rightVolCur = 0;
-    uint8_t rightVolPrev;
+    uint8_t rightVolPrev = 0;
 };
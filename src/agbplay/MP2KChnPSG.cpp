@@ -4,6 +4,8 @@
 #include "Constants.hpp"
 #include "Debug.hpp"
 #include "MP2KContext.hpp"
+#include "RenderProfiler.hpp"
+#include "StateStream.hpp"
 #include "Util.hpp"
 #include "Xcept.hpp"
 
@@ -116,6 +118,46 @@ bool MP2KChnPSG::IsChn3() const
     return false;
 }
 
+void MP2KChnPSG::SaveState(StateWriter &w) const
+{
+    MP2KChn::SaveState(w);
+    w.Write(fastRelease);
+    w.Write(vol);
+    w.Write(pan);
+    w.Write(mp2k_sus_vol_bug_update);
+    w.Write(psgLengthCount);
+    w.Write(psgLengthActive);
+    w.Write(envInterStep);
+    w.Write(envLevelCur);
+    w.Write(envPeak);
+    w.Write(envSustain);
+    w.Write(envFrameCount);
+    w.Write(envFadeLevel);
+    w.Write(volFade);
+    w.Write(panCur);
+    w.Write(panPrev);
+}
+
+void MP2KChnPSG::LoadState(StateReader &r)
+{
+    MP2KChn::LoadState(r);
+    r.Read(fastRelease);
+    r.Read(vol);
+    r.Read(pan);
+    r.Read(mp2k_sus_vol_bug_update);
+    r.Read(psgLengthCount);
+    r.Read(psgLengthActive);
+    r.Read(envInterStep);
+    r.Read(envLevelCur);
+    r.Read(envPeak);
+    r.Read(envSustain);
+    r.Read(envFrameCount);
+    r.Read(envFadeLevel);
+    r.Read(volFade);
+    r.Read(panCur);
+    r.Read(panPrev);
+}
+
 void MP2KChnPSG::stepEnvelope()
 {
     if (envState == EnvState::INIT) {
@@ -446,7 +488,10 @@ void MP2KChnPSGSquare::Process(std::span<sample> buffer, MixingArgs &args)
     assert(buffer.size() == ctx.mixer.scratchBuffer.size());
     FetchCallback cb =
         std::bind(&MP2KChnPSGSquare::sampleFetchCallback, this, std::placeholders::_1, std::placeholders::_2);
-    rs->Process(ctx.mixer.scratchBuffer, interStep, cb);
+    {
+        PROFILE_STAGE(RESAMPLER);
+        rs->Process(ctx.mixer.scratchBuffer, interStep, cb);
+    }
 
     for (size_t i = 0; i < buffer.size(); i++) {
         const float samp = ctx.mixer.scratchBuffer[i];
@@ -499,6 +544,32 @@ VoiceFlags MP2KChnPSGSquare::GetVoiceType() const noexcept
     }
 }
 
+void MP2KChnPSGSquare::SaveState(StateWriter &w) const
+{
+    /* constructor arguments */
+    w.Write(instrDuty);
+    w.Write(sweep);
+
+    MP2KChnPSG::SaveState(w);
+    w.Write(sweepStartCount);
+    w.Write(sweepTimer);
+}
+
+MP2KChnPSGSquare &MP2KChnPSGSquare::Restore(
+    std::list<MP2KChnPSGSquare> &channels, MP2KContext &ctx, MP2KTrack *track, StateReader &r
+)
+{
+    const uint32_t instrDuty = r.Read<uint32_t>();
+    const uint8_t sweep = r.Read<uint8_t>();
+
+    MP2KChnPSGSquare &chn = channels.emplace_back(ctx, track, instrDuty, ADSR{}, Note{}, sweep);
+    chn.MP2KChnPSG::LoadState(r);
+    r.Read(chn.sweepStartCount);
+    r.Read(chn.sweepTimer);
+
+    return chn;
+}
+
 bool MP2KChnPSGSquare::sampleFetchCallback(std::vector<float> &fetchBuffer, size_t samplesRequired)
 {
     if (fetchBuffer.size() >= samplesRequired)
@@ -586,7 +657,7 @@ uint8_t MP2KChnPSGSquare::sweepTime(uint8_t sweep)
 MP2KChnPSGWave::MP2KChnPSGWave(
     MP2KContext &ctx, MP2KTrack *track, uint32_t instrWave, ADSR env, Note note, bool useStairstep
 ) :
-    MP2KChnPSG(ctx, track, env, note, useStairstep)
+    MP2KChnPSG(ctx, track, env, note, useStairstep), instrWave(instrWave)
 {
     static const uint8_t dummyWave[16] = {0};
     if (instrWave < AGB_MAP_ROM) {
@@ -675,7 +746,10 @@ void MP2KChnPSGWave::Process(std::span<sample> buffer, MixingArgs &args)
     assert(ctx.mixer.scratchBuffer.size() == buffer.size());
     FetchCallback cb =
         std::bind(&MP2KChnPSGWave::sampleFetchCallback, this, std::placeholders::_1, std::placeholders::_2);
-    rs->Process(ctx.mixer.scratchBuffer, interStep, cb);
+    {
+        PROFILE_STAGE(RESAMPLER);
+        rs->Process(ctx.mixer.scratchBuffer, interStep, cb);
+    }
 
     for (size_t i = 0; i < buffer.size(); i++) {
         const float samp = ctx.mixer.scratchBuffer[i];
@@ -691,6 +765,36 @@ VoiceFlags MP2KChnPSGWave::GetVoiceType() const noexcept
     return VoiceFlags::PSG_WAVE;
 }
 
+void MP2KChnPSGWave::SaveState(StateWriter &w) const
+{
+    /* constructor arguments */
+    w.Write(instrWave);
+    w.Write(useStairstep);
+
+    /* DC correction depends on the quantization setting at note start */
+    MP2KChnPSG::SaveState(w);
+    w.Write(dcCorrection100);
+    w.Write(dcCorrection75);
+    w.Write(dcCorrection50);
+    w.Write(dcCorrection25);
+}
+
+MP2KChnPSGWave &
+    MP2KChnPSGWave::Restore(std::list<MP2KChnPSGWave> &channels, MP2KContext &ctx, MP2KTrack *track, StateReader &r)
+{
+    const uint32_t instrWave = r.Read<uint32_t>();
+    const bool useStairstep = r.Read<bool>();
+
+    MP2KChnPSGWave &chn = channels.emplace_back(ctx, track, instrWave, ADSR{}, Note{}, useStairstep);
+    chn.MP2KChnPSG::LoadState(r);
+    r.Read(chn.dcCorrection100);
+    r.Read(chn.dcCorrection75);
+    r.Read(chn.dcCorrection50);
+    r.Read(chn.dcCorrection25);
+
+    return chn;
+}
+
 bool MP2KChnPSGWave::IsChn3() const
 {
     return true;
@@ -882,7 +986,10 @@ void MP2KChnPSGNoise::Process(std::span<sample> buffer, MixingArgs &args)
         return rs->Process({&fetchBuffer[i], samplesToFetch}, interStep, cbNearest);
     };
 
-    srs->Process(ctx.mixer.scratchBuffer, noiseFreq / float(ctx.sampleRate), cbSinc);
+    {
+        PROFILE_STAGE(RESAMPLER);
+        srs->Process(ctx.mixer.scratchBuffer, noiseFreq / float(ctx.sampleRate), cbSinc);
+    }
 
     for (size_t i = 0; i < buffer.size(); i++) {
         const float samp = ctx.mixer.scratchBuffer[i];
@@ -901,6 +1008,31 @@ VoiceFlags MP2KChnPSGNoise::GetVoiceType() const noexcept
         return VoiceFlags::PSG_NOISE_7;
 }
 
+void MP2KChnPSGNoise::SaveState(StateWriter &w) const
+{
+    /* constructor arguments */
+    w.Write(instrNp);
+
+    MP2KChnPSG::SaveState(w);
+    w.Write(noiseState);
+    w.Write(noiseLfsrMask);
+    srs->SaveState(w);
+}
+
+MP2KChnPSGNoise &
+    MP2KChnPSGNoise::Restore(std::list<MP2KChnPSGNoise> &channels, MP2KContext &ctx, MP2KTrack *track, StateReader &r)
+{
+    const uint32_t instrNp = r.Read<uint32_t>();
+
+    MP2KChnPSGNoise &chn = channels.emplace_back(ctx, track, instrNp, ADSR{}, Note{});
+    chn.MP2KChnPSG::LoadState(r);
+    r.Read(chn.noiseState);
+    r.Read(chn.noiseLfsrMask);
+    chn.srs->LoadState(r);
+
+    return chn;
+}
+
 bool MP2KChnPSGNoise::sampleFetchCallback(std::vector<float> &fetchBuffer, size_t samplesRequired)
 {
     if (fetchBuffer.size() >= samplesRequired)
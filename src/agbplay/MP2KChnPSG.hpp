@@ -5,11 +5,14 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <list>
 #include <memory>
 #include <span>
 
 struct MP2KContext;
 struct MP2KTrack;
+class StateWriter;
+class StateReader;
 
 class MP2KChnPSG : public MP2KChn
 {
@@ -29,6 +32,8 @@ public:
 
 protected:
     virtual bool IsChn3() const;
+    void SaveState(StateWriter &w) const;
+    void LoadState(StateReader &r);
     void stepEnvelope();
     void updateVolFade();
     void applyVol();
@@ -70,6 +75,10 @@ public:
     void Process(std::span<sample> buffer, MixingArgs &args) override;
     VoiceFlags GetVoiceType() const noexcept override;
 
+    void SaveState(StateWriter &w) const;
+    static MP2KChnPSGSquare &
+        Restore(std::list<MP2KChnPSGSquare> &channels, MP2KContext &ctx, MP2KTrack *track, StateReader &r);
+
 private:
     bool sampleFetchCallback(std::vector<float> &fetchBuffer, size_t samplesRequired);
 
@@ -99,14 +108,19 @@ public:
     void Process(std::span<sample> buffer, MixingArgs &args) override;
     VoiceFlags GetVoiceType() const noexcept override;
 
+    void SaveState(StateWriter &w) const;
+    static MP2KChnPSGWave &
+        Restore(std::list<MP2KChnPSGWave> &channels, MP2KContext &ctx, MP2KTrack *track, StateReader &r);
+
 private:
     bool IsChn3() const override;
     VolumeFade getVol() const;
     bool sampleFetchCallback(std::vector<float> &fetchBuffer, size_t samplesRequired);
+    const uint32_t instrWave;
     float dcCorrection100;
-    float dcCorrection75;
-    float dcCorrection50;
-    float dcCorrection25;
+    float dcCorrection75 = 0.0f;
+    float dcCorrection50 = 0.0f;
+    float dcCorrection25 = 0.0f;
     const uint8_t *wavePtr;
 };
 
@@ -119,6 +133,10 @@ public:
     void Process(std::span<sample> buffer, MixingArgs &args) override;
     VoiceFlags GetVoiceType() const noexcept override;
 
+    void SaveState(StateWriter &w) const;
+    static MP2KChnPSGNoise &
+        Restore(std::list<MP2KChnPSGNoise> &channels, MP2KContext &ctx, MP2KTrack *track, StateReader &r);
+
 private:
     bool sampleFetchCallback(std::vector<float> &fetchBuffer, size_t samplesRequired);
     std::unique_ptr<Resampler> srs;
@@ -2,9 +2,41 @@
 
 #include "Constants.hpp"
 #include "Debug.hpp"
+#include "RenderProfiler.hpp"
+#include "StateStream.hpp"
+#include "Xcept.hpp"
 
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <type_traits>
+
+/*
+ * MP2KContext snapshot format
+ */
+
+static const std::array<char, 8> SNAPSHOT_MAGIC = {'A', 'G', 'B', 'P', 'S', 'N', 'A', 'P'};
+static const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+// position in the channel list of a track, which marks channels not linked to their track
+static const uint32_t TRACK_LIST_POS_UNLINKED = 0xFFFFFFFF;
+
+/* Everything which is not part of the saved state, but which the state depends on. The ROM is only
+ * identified by size and header, since hashing the whole ROM would be too slow for frequent snapshots. */
+static void writeSnapshotConfig(StateWriter &w, const MP2KContext &ctx)
+{
+    w.Write<uint8_t>(sizeof(size_t));
+    w.Write<uint8_t>(sizeof(sample));
+    w.Write<uint32_t>(ctx.sampleRate);
+    w.Write<uint64_t>(ctx.rom.Size());
+    for (size_t i = 0xA0; i < 0xC0 && i < ctx.rom.Size(); i++)
+        w.Write<uint8_t>(ctx.rom[i]);
+    w.Write(ctx.agbplaySoundMode.reverbType);
+    w.Write<uint8_t>(static_cast<uint8_t>(ctx.players.size()));
+    for (const MP2KPlayer &player : ctx.players) {
+        w.Write<uint8_t>(static_cast<uint8_t>(player.tracks.size()));
+        w.Write(player.usePriority);
+    }
+}
 
 MP2KContext::MP2KContext(
     uint32_t sampleRate,
@@ -37,8 +69,17 @@ MP2KContext::MP2KContext(
 
 void MP2KContext::m4aSoundMain()
 {
-    reader.Process();
+    PROFILE_MICROFRAME();
+
+    {
+        PROFILE_STAGE(SEQUENCER);
+        reader.Process();
+    }
     mixer.Process();
+
+    PROFILE_VOICES(
+        sndChannels.size() + sq1Channels.size() + sq2Channels.size() + waveChannels.size() + noiseChannels.size()
+    );
 }
 
 void MP2KContext::m4aSoundMode(uint32_t mode)
@@ -202,11 +243,7 @@ void MP2KContext::m4aSoundClear()
     waveChannels.clear();
     noiseChannels.clear();
 
-    for (MP2KPlayer &player : players) {
-        for (MP2KTrack &trk : player.tracks) {
-            trk.reverb->Reset();
-        }
-    }
+    mixer.ResetReverb();
 }
 
 uint8_t MP2KContext::m4aSongNumPlayerGet(uint16_t songId) const
@@ -229,6 +266,264 @@ bool MP2KContext::SongEnded() const
     return reader.EndReached() && mixer.IsFadeDone();
 }
 
+MP2KSongAnalysis MP2KContext::AnalyzeSong(uint16_t songId)
+{
+    /* Run the sequencer only. No voices are created and no audio is mixed.
+     * Any song playing in this context is stopped. */
+    MP2KSongAnalysis analysis;
+
+    m4aMPlayAllStop();
+    m4aSoundClear();
+
+    /* Detaches the analysis and stops the song on every exit including exceptions, since the context may be
+     * reused for other songs afterwards. */
+    struct AnalysisGuard
+    {
+        MP2KContext &ctx;
+
+        ~AnalysisGuard()
+        {
+            ctx.reader.SetAnalysis(nullptr);
+            ctx.m4aMPlayAllStop();
+            ctx.m4aSoundClear();
+        }
+    };
+
+    reader.SetAnalysis(&analysis);
+    const AnalysisGuard guard{*this};
+    m4aSongNumStart(songId);
+
+    const size_t samplesPerBuffer = mixer.GetSamplesPerBuffer();
+    const size_t maxMicroframes = static_cast<size_t>(SONG_ANALYSIS_MAX_TIME * AGB_EXACT_FPS * INTERFRAMES);
+    const MP2KPlayer &player = players.at(primaryPlayer);
+    size_t microframes = 0;
+    bool endReached = false;
+
+    while (true) {
+        reader.Process();
+        mixer.SkipMicroframe();
+
+        if (!endReached && reader.EndReached()) {
+            endReached = true;
+            analysis.lengthTicks = player.tickCount;
+            analysis.lengthSamples = microframes * samplesPerBuffer;
+        }
+
+        /* same termination as in SoundExporter */
+        if (SongEnded())
+            break;
+
+        microframes++;
+
+        if ((maxLoops < 0 && analysis.loopFound) || microframes >= maxMicroframes) {
+            analysis.truncated = true;
+            if (!endReached) {
+                analysis.lengthTicks = player.tickCount;
+                analysis.lengthSamples = microframes * samplesPerBuffer;
+            }
+            break;
+        }
+    }
+
+    analysis.totalSamples = microframes * samplesPerBuffer;
+    analysis.dataHash = reader.AnalysisDataHash();
+
+    return analysis;
+}
+
+bool MP2KContext::SongTailSilent() const
+{
+    PROFILE_STAGE(LOUDNESS);
+
+    /* Only consider the song finished early if no more notes can be started.
+     * Otherwise a looped song may be cut during a rest while fading out. */
+    if (!reader.EndReached())
+        return false;
+
+    for (const MP2KPlayer &player : players) {
+        if (player.playing && !player.finished)
+            return false;
+    }
+
+    if (!sndChannels.empty() || !sq1Channels.empty() || !sq2Channels.empty() || !waveChannels.empty()
+        || !noiseChannels.empty())
+        return false;
+
+    return mixer.IsSilent(SONG_SILENCE_THRESHOLD);
+}
+
+void MP2KContext::SaveState(StateWriter &w) const
+{
+    w.Write(mp2kSoundMode);
+    w.WriteVector(memaccArea);
+    w.Write(primaryPlayer);
+    w.Write(maxLoops);
+    reader.SaveState(w);
+    mixer.SaveState(w);
+
+    w.Write<uint8_t>(static_cast<uint8_t>(players.size()));
+    for (const MP2KPlayer &player : players)
+        player.SaveState(w);
+
+    w.WriteVector(masterAudioBuffer);
+    masterLoudnessCalculator.SaveState(w);
+
+    /* Channels refer to their track by pointer, so save the player and track index instead.
+     * The channel order within a track is significant (e.g. for EOT), so save it as well. */
+    auto saveChannels = [&](const auto &channels) {
+        w.Write<uint32_t>(static_cast<uint32_t>(channels.size()));
+        for (const auto &chn : channels) {
+            const MP2KTrack *trk = chn.trackOrg;
+            const auto playerIt = std::find_if(players.begin(), players.end(), [trk](const MP2KPlayer &player) {
+                return !player.tracks.empty() && trk >= &player.tracks.front() && trk <= &player.tracks.back();
+            });
+            assert(playerIt != players.end());
+
+            uint32_t trackListPos = TRACK_LIST_POS_UNLINKED;
+            if (chn.track != nullptr) {
+                trackListPos = 0;
+                for (const MP2KChn *c = trk->channels; c != &chn; c = c->next)
+                    trackListPos++;
+            }
+
+            w.Write(playerIt->playerIdx);
+            w.Write(trk->trackIdx);
+            w.Write(trackListPos);
+            chn.SaveState(w);
+        }
+    };
+
+    saveChannels(sndChannels);
+    saveChannels(sq1Channels);
+    saveChannels(sq2Channels);
+    saveChannels(waveChannels);
+    saveChannels(noiseChannels);
+}
+
+void MP2KContext::LoadState(StateReader &r)
+{
+    /* Destroy all channels first, they unlink themselves from the tracks. */
+    m4aSoundClear();
+
+    /* The sound mode has to be restored before the mixer recreates the reverbs. */
+    r.Read(mp2kSoundMode);
+    r.ReadVector(memaccArea);
+    r.Read(primaryPlayer);
+    r.Read(maxLoops);
+    reader.LoadState(r);
+    mixer.LoadState(r);
+
+    const uint8_t numPlayers = r.Read<uint8_t>();
+    if (numPlayers != players.size())
+        throw Xcept(
+            "Cannot restore state: Player count {} does not match player table ({})", numPlayers, players.size()
+        );
+    for (MP2KPlayer &player : players)
+        player.LoadState(r);
+
+    r.ReadVector(masterAudioBuffer);
+    masterLoudnessCalculator.LoadState(r);
+
+    if (memaccArea.size() != 256)
+        throw Xcept("Cannot restore state: Invalid MEMACC area size {}", memaccArea.size());
+
+    struct TrackLink
+    {
+        MP2KTrack *trk;
+        uint32_t trackListPos;
+        MP2KChn *chn;
+    };
+
+    std::vector<TrackLink> links;
+    std::vector<MP2KChn *> unlinked;
+
+    auto loadChannels = [&](auto &channels) {
+        const uint32_t numChannels = r.Read<uint32_t>();
+        for (uint32_t i = 0; i < numChannels; i++) {
+            const uint8_t playerIdx = r.Read<uint8_t>();
+            const uint8_t trackIdx = r.Read<uint8_t>();
+            const uint32_t trackListPos = r.Read<uint32_t>();
+            if (playerIdx >= players.size() || trackIdx >= players[playerIdx].tracks.size())
+                throw Xcept("Cannot restore state: Invalid channel track {}/{}", playerIdx, trackIdx);
+
+            MP2KTrack *trk = &players[playerIdx].tracks[trackIdx];
+            MP2KChn &chn = std::remove_reference_t<decltype(channels.front())>::Restore(channels, *this, trk, r);
+            if (trackListPos == TRACK_LIST_POS_UNLINKED)
+                unlinked.push_back(&chn);
+            else
+                links.emplace_back(trk, trackListPos, &chn);
+        }
+    };
+
+    loadChannels(sndChannels);
+    loadChannels(sq1Channels);
+    loadChannels(sq2Channels);
+    loadChannels(waveChannels);
+    loadChannels(noiseChannels);
+
+    /* Restoring a channel links it to the front of its track. Rebuild the original order instead. */
+    for (MP2KPlayer &player : players) {
+        for (MP2KTrack &trk : player.tracks)
+            trk.channels = nullptr;
+    }
+
+    for (MP2KChn *chn : unlinked)
+        chn->track = nullptr;
+
+    std::sort(links.begin(), links.end(), [](const TrackLink &a, const TrackLink &b) {
+        return a.trackListPos > b.trackListPos;
+    });
+
+    for (const TrackLink &link : links) {
+        link.chn->prev = nullptr;
+        link.chn->next = link.trk->channels;
+        if (link.trk->channels)
+            link.trk->channels->prev = link.chn;
+        link.trk->channels = link.chn;
+    }
+}
+
+std::vector<uint8_t> MP2KContext::Snapshot() const
+{
+    StateWriter w;
+    w.Write(SNAPSHOT_MAGIC);
+    w.Write<uint32_t>(SNAPSHOT_VERSION);
+    w.Write<uint32_t>(SNAPSHOT_BYTE_ORDER);
+    writeSnapshotConfig(w, *this);
+    SaveState(w);
+    return std::move(w.GetData());
+}
+
+void MP2KContext::Restore(std::span<const uint8_t> snapshot)
+{
+    StateReader r(snapshot);
+
+    if (r.Read<std::remove_const_t<decltype(SNAPSHOT_MAGIC)>>() != SNAPSHOT_MAGIC)
+        throw Xcept("Cannot restore snapshot: Invalid snapshot data");
+    if (const uint32_t version = r.Read<uint32_t>(); version != SNAPSHOT_VERSION)
+        throw Xcept("Cannot restore snapshot: Unsupported version {} (expected {})", version, SNAPSHOT_VERSION);
+    if (r.Read<uint32_t>() != SNAPSHOT_BYTE_ORDER)
+        throw Xcept("Cannot restore snapshot: Snapshot was made on a machine with different byte order");
+
+    /* Compare the configuration before touching any state, so a mismatching snapshot leaves the context intact. */
+    StateWriter config;
+    writeSnapshotConfig(config, *this);
+    for (uint8_t expected : config.GetData()) {
+        if (r.Read<uint8_t>() != expected)
+            throw Xcept("Cannot restore snapshot: Snapshot was made with a different ROM or configuration");
+    }
+
+    try {
+        LoadState(r);
+        if (!r.AtEnd())
+            throw Xcept("Cannot restore snapshot: Unexpected data after end of snapshot");
+    } catch (const Xcept &) {
+        m4aMPlayAllStop();
+        m4aSoundClear();
+        throw;
+    }
+}
+
 void MP2KContext::GetVisualizerState(MP2KVisualizerState &visualizerState)
 {
     visualizerState.activeChannels = sndChannels.size();
@@ -10,8 +10,12 @@
 
 #include <cstdint>
 #include <list>
+#include <span>
 #include <vector>
 
+class StateWriter;
+class StateReader;
+
 /* Instead of defining lots of global objects, we define
  * a context with all the things we need. So anything which
  * needs anything out of this context only needs a reference
@@ -57,8 +61,22 @@ struct MP2KContext
     void m4aSetMaxLoops(int8_t maxLoops);
 
     bool SongEnded() const;
+    bool SongTailSilent() const;
+    MP2KSongAnalysis AnalyzeSong(uint16_t songId);
     void GetVisualizerState(MP2KVisualizerState &visualizerState);
 
+    /* Save and restore the complete engine state. Configuration (ROM, sample rate, player table and
+     * agbplay sound mode) is not saved and must match. If restoring fails, m4aSoundClear and
+     * m4aMPlayAllStop have to be used before the context can be used again. */
+    void SaveState(StateWriter &w) const;
+    void LoadState(StateReader &r);
+
+    /* Snapshots contain the engine state like SaveState, but with a versioned header, which
+     * identifies the configuration they were made with. Restore throws if the snapshot does not
+     * match this context. A failed restore leaves the context cleared and stopped. */
+    std::vector<uint8_t> Snapshot() const;
+    void Restore(std::span<const uint8_t> snapshot);
+
     const Rom &rom;
     SequenceReader reader;
     SoundMixer mixer;
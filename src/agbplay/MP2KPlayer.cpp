@@ -3,6 +3,8 @@
 #include "MP2KTrack.hpp"
 #include "ReverbEffect.hpp"
 #include "Rom.hpp"    // TODO remove once Rom is deglobalized
+#include "StateStream.hpp"
+#include "Xcept.hpp"
 
 MP2KPlayer::MP2KPlayer(const MP2KContext &ctx, const PlayerInfo &playerInfo, uint8_t playerIdx) :
     trackLimit(playerInfo.maxTracks), playerIdx(playerIdx), usePriority(playerInfo.usePriority)
@@ -48,3 +50,45 @@ void MP2KPlayer::Init(const Rom &rom, size_t songHeaderPos)
     frameCount = 0;
     interframeCount = 0;
 }
+
+void MP2KPlayer::SaveState(StateWriter &w) const
+{
+    w.Write(playing);
+    w.Write(finished);
+    w.Write(interframeCount);
+    w.Write(frameCount);
+    w.Write(tickCount);
+    w.Write(tickProgress_32_32);
+    w.Write(bpm);
+    w.Write(songHeaderPos);
+    w.Write(bankPos);
+    w.Write(tracksUsed);
+    w.Write(reverb);
+    w.Write(priority);
+
+    w.Write<uint8_t>(static_cast<uint8_t>(tracks.size()));
+    for (const MP2KTrack &trk : tracks)
+        trk.SaveState(w);
+}
+
+void MP2KPlayer::LoadState(StateReader &r)
+{
+    r.Read(playing);
+    r.Read(finished);
+    r.Read(interframeCount);
+    r.Read(frameCount);
+    r.Read(tickCount);
+    r.Read(tickProgress_32_32);
+    r.Read(bpm);
+    r.Read(songHeaderPos);
+    r.Read(bankPos);
+    r.Read(tracksUsed);
+    r.Read(reverb);
+    r.Read(priority);
+
+    const uint8_t numTracks = r.Read<uint8_t>();
+    if (numTracks != tracks.size())
+        throw Xcept("Cannot restore player state: Track count {} does not match track limit {}", numTracks, trackLimit);
+    for (MP2KTrack &trk : tracks)
+        trk.LoadState(r);
+}
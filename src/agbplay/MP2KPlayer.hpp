@@ -9,6 +9,8 @@
 
 class Rom;
 struct MP2KContext;
+class StateWriter;
+class StateReader;
 
 struct MP2KPlayer
 {
@@ -18,6 +20,8 @@ struct MP2KPlayer
     MP2KPlayer &operator=(const MP2KPlayer &) = delete;
 
     void Init(const Rom &rom, size_t songHeaderPos);
+    void SaveState(StateWriter &w) const;
+    void LoadState(StateReader &r);
 
     std::vector<MP2KTrack> tracks;
 
@@ -4,9 +4,21 @@
 #include "Debug.hpp"
 #include "Profile.hpp"
 #include "Rom.hpp"
+#include "RomPointerIndex.hpp"
+#include "Util.hpp"
 
-MP2KScanner::MP2KScanner(const Rom &rom) : rom(rom)
+#include <algorithm>
+#include <thread>
+
+MP2KScanner::MP2KScanner(const Rom &rom, std::shared_ptr<const RomPointerIndex> pointerIndex) :
+    rom(rom), pointerIndex(pointerIndex ? std::move(pointerIndex) : CreatePointerIndex(rom)),
+    songTableEntryState(rom.Size() / 4 + 1, ENTRY_UNCHECKED)
+{
+}
+
+std::shared_ptr<const RomPointerIndex> MP2KScanner::CreatePointerIndex(const Rom &rom)
 {
+    return std::make_shared<const RomPointerIndex>(rom, SEARCH_START);
 }
 
 std::vector<MP2KScanner::Result> MP2KScanner::Scan(std::shared_ptr<Profile> profile)
@@ -17,8 +29,6 @@ std::vector<MP2KScanner::Result> MP2KScanner::Scan(std::shared_ptr<Profile> prof
      * to a (non-provided) profile. */
     std::vector<Result> results;
 
-    InitPointerCache();
-
     size_t findPos = SEARCH_START;
 
     while (true) {
@@ -98,7 +108,7 @@ std::vector<MP2KScanner::Result> MP2KScanner::Scan(std::shared_ptr<Profile> prof
     return results;
 }
 
-bool MP2KScanner::FindSongTable(size_t &findStartPos, size_t &songTablePos, uint16_t &songCount) const
+bool MP2KScanner::FindSongTable(size_t &findStartPos, size_t &songTablePos, uint16_t &songCount)
 {
     for (size_t i = findStartPos; i < rom.Size() - 3; i += 4) {
         size_t candidatePos = i;
@@ -106,7 +116,7 @@ bool MP2KScanner::FindSongTable(size_t &findStartPos, size_t &songTablePos, uint
 
         /* check if MIN_SONG_NUM entries look like a valid song table */
         for (size_t j = 0; j < MIN_SONG_NUM; j++) {
-            if (!IsValidSongTableEntry(i + j * 8, rom.IsGsf())) {
+            if (!IsValidSongTableCandidateEntry(i + j * 8)) {
                 i += j * 8;
                 candidateValid = false;
                 break;
@@ -170,26 +180,22 @@ bool MP2KScanner::FindPlayerTable(size_t songTablePos, size_t &playerTablePos, P
      * Because we already know the song table pos, we can just check all the places where it is referenced,
      * and then check the 4 bytes before that reference. Those have to be a valid player table. */
 
-    const size_t songTableRef = songTablePos + AGB_MAP_ROM;
-
     size_t musicPlayerCount = 0;
     size_t playerTableStartPos = 0;
     size_t matchCount = 0;
 
-    for (size_t i = SEARCH_START; i < rom.Size() - 3; i += 4) {
-        /* 1. Search the entire ROM for a reference to our song table. */
-        if (rom.ReadU32(i) != songTableRef)
-            continue;
-
+    const RomView romView = rom.View();
+    for (const size_t i : pointerIndex->GetReferences(songTablePos)) {
+        /* 1. Go through all references to our song table. */
         if (i < 4)
             continue;
 
         /* 2. Check if the pointer before the reference also looks like a pointer. */
-        if (!rom.ValidPointer(rom.ReadU32(i - 4)))
+        if (!romView.ValidPointer(romView.ReadU32(i - 4)))
             continue;
 
         /* 3. Check how many music players we have. */
-        const size_t playerTablePosCandidate = rom.ReadAgbPtrToPos(i - 4);
+        const size_t playerTablePosCandidate = romView.ReadAgbPtrToPos(i - 4);
         const size_t MAX_MUSIC_PLAYERS = 32;
 
         size_t musicPlayerCountCandidate;
@@ -270,6 +276,8 @@ bool MP2KScanner::FindSoundModeNormal(size_t playerTablePos, size_t &soundModePo
         if (signaturePos + 0x24 > rom.Size())
             continue;
 
+        const RomView signature = rom.View(signaturePos, 0x24);
+
         // fmt::print("Found reference to playerTable=0x{:x} at 0x{:x}\n", playerTablePos, playerTableReferencePos);
 
         // fmt::print("sound mode signature:\n");
@@ -284,19 +292,19 @@ bool MP2KScanner::FindSoundModeNormal(size_t playerTablePos, size_t &soundModePo
         // fmt::print(" - memacc area: 0x{:08x}\n", rom.ReadU32(signaturePos + 32));
 
         /* check mix code (ROM-addr) */
-        if (!rom.ValidPointer(rom.ReadU32(signaturePos + 0x0)))
+        if (!rom.ValidPointer(signature.ReadU32(signaturePos + 0x0)))
             continue;
 
         // fmt::print("mix code ROM valid\n");
 
         /* check mix code (RAM-addr) */
-        if (!IsValidRamPointer(rom.ReadU32(signaturePos + 0x4)))
+        if (!IsValidRamPointer(signature.ReadU32(signaturePos + 0x4)))
             continue;
 
         // fmt::print("mix code RAM valid\n");
 
         /* check mix code size (CpuSet Arg) */
-        const uint32_t cpusetArg = rom.ReadU32(signaturePos + 0x8);
+        const uint32_t cpusetArg = signature.ReadU32(signaturePos + 0x8);
         if ((cpusetArg & (1 << 26)) == 0)    // Is 32 bit copy?
             continue;
         if ((cpusetArg & 0x1FFFFF) >= 0x800)    // Is data smaller than 0x800 words? (usually just SEARCH_START)
@@ -305,20 +313,20 @@ bool MP2KScanner::FindSoundModeNormal(size_t playerTablePos, size_t &soundModePo
         // fmt::print("mix code size valid\n");
 
         /* check SoundInfo pointer (RAM addr) */
-        if (!IsValidRamPointer(rom.ReadU32(signaturePos + 0xC)))
+        if (!IsValidRamPointer(signature.ReadU32(signaturePos + 0xC)))
             continue;
 
         // fmt::print("SoundInfo valid\n");
 
         /* check CgbChan pointer (RAM addr) */
-        if (!IsValidRamPointer(rom.ReadU32(signaturePos + 0x10)))
+        if (!IsValidRamPointer(signature.ReadU32(signaturePos + 0x10)))
             continue;
 
         // fmt::print("CgbChan valid\n");
 
         /* check sound mode */
         const size_t soundModePosCandidate = signaturePos + 0x14;
-        const uint32_t soundModeCandidate = rom.ReadU32(soundModePosCandidate);
+        const uint32_t soundModeCandidate = signature.ReadU32(soundModePosCandidate);
         if ((soundModeCandidate & 0xFF) != 0)    // reserved byte must be 0
             continue;
         if (uint32_t maxchn = (soundModeCandidate >> 8) & 0xF; maxchn < 1 || maxchn > 12)
@@ -331,20 +339,20 @@ bool MP2KScanner::FindSoundModeNormal(size_t playerTablePos, size_t &soundModePo
         // fmt::print("sound mode valid\n");
 
         /* check player table len */
-        const uint32_t playerTableLen = rom.ReadU32(signaturePos + 0x18);
+        const uint32_t playerTableLen = signature.ReadU32(signaturePos + 0x18);
         if (playerTableLen > 32)
             continue;
 
         // fmt::print("player table len valid\n");
 
         /* check player table pos (probably redundant as it's an argument) */
-        if (!rom.ValidPointer(rom.ReadU32(signaturePos + 0x1C)))
+        if (!rom.ValidPointer(signature.ReadU32(signaturePos + 0x1C)))
             continue;
 
         // fmt::print("player table pos valid\n");
 
         /* check memacc address (TODO is this really the memacc address?) */
-        if (!IsValidRamPointer(rom.ReadU32(signaturePos + 0x20)))
+        if (!IsValidRamPointer(signature.ReadU32(signaturePos + 0x20)))
             continue;
 
         // fmt::print("memacc valid\n");
@@ -403,80 +411,82 @@ bool MP2KScanner::FindSoundModeMetroid(size_t playerTablePos, size_t &soundModeP
         if (signaturePos + 0x78 > rom.Size())
             continue;
 
+        const RomView signature = rom.View(signaturePos, 0x78);
+
         /* Check actual signature */
 
         /* [0x00] */
-        if (!IsValidRamPointer(rom.ReadU32(signaturePos + 0x0)))
+        if (!IsValidRamPointer(signature.ReadU32(signaturePos + 0x0)))
             continue;
 
         /* [0x04] */
-        if (rom.ReadU32(signaturePos + 0x4) != 0x04000200)
+        if (signature.ReadU32(signaturePos + 0x4) != 0x04000200)
             continue;
 
         /* [0x08] */
-        if (rom.ReadU32(signaturePos + 0x8) != 0x04000084)
+        if (signature.ReadU32(signaturePos + 0x8) != 0x04000084)
             continue;
 
         /* [0x0C] */
-        if (rom.ReadU32(signaturePos + 0xC) != 0x04000082)
+        if (signature.ReadU32(signaturePos + 0xC) != 0x04000082)
             continue;
 
         /* [0x14] */
-        if (rom.ReadU32(signaturePos + 0x14) != 0x04000089)
+        if (signature.ReadU32(signaturePos + 0x14) != 0x04000089)
             continue;
 
         /* [0x18] */
-        if (rom.ReadU32(signaturePos + 0x18) != 0x04000063)
+        if (signature.ReadU32(signaturePos + 0x18) != 0x04000063)
             continue;
 
         /* [0x1C] */
-        if (rom.ReadU32(signaturePos + 0x1C) != 0x04000080)
+        if (signature.ReadU32(signaturePos + 0x1C) != 0x04000080)
             continue;
 
         /* [0x20] */
-        if (!IsValidRamPointer(rom.ReadU32(signaturePos + 0x20)))
+        if (!IsValidRamPointer(signature.ReadU32(signaturePos + 0x20)))
             continue;
 
         /* [0x24] */
-        if (!IsValidIwramPointer(rom.ReadU32(signaturePos + 0x24)))
+        if (!IsValidIwramPointer(signature.ReadU32(signaturePos + 0x24)))
             continue;
 
         /* [0x28] */
-        if (!rom.ValidPointer(rom.ReadU32(signaturePos + 0x28)))
+        if (!rom.ValidPointer(signature.ReadU32(signaturePos + 0x28)))
             continue;
 
         /* [0x30] */
-        if (!IsValidRamPointer(rom.ReadU32(signaturePos + 0x30)))
+        if (!IsValidRamPointer(signature.ReadU32(signaturePos + 0x30)))
             continue;
 
         /* [0x34] */
-        if (!IsValidIwramPointer(rom.ReadU32(signaturePos + 0x34)))
+        if (!IsValidIwramPointer(signature.ReadU32(signaturePos + 0x34)))
             continue;
 
         /* [0x38] */
-        if (!rom.ValidPointer(rom.ReadU32(signaturePos + 0x38)))
+        if (!rom.ValidPointer(signature.ReadU32(signaturePos + 0x38)))
             continue;
 
         /* [0x40] */
-        if (!IsValidRamPointer(rom.ReadU32(signaturePos + 0x40)))
+        if (!IsValidRamPointer(signature.ReadU32(signaturePos + 0x40)))
             continue;
 
         /* [0x44] */
-        if (!IsValidIwramPointer(rom.ReadU32(signaturePos + 0x44)))
+        if (!IsValidIwramPointer(signature.ReadU32(signaturePos + 0x44)))
             continue;
 
         /* [0x48] */
-        if (!rom.ValidPointer(rom.ReadU32(signaturePos + 0x48)))
+        if (!rom.ValidPointer(signature.ReadU32(signaturePos + 0x48)))
             continue;
 
         /* [0x58] */
-        const uint32_t playerTableLen = rom.ReadU32(signaturePos + 0x58);
+        const uint32_t playerTableLen = signature.ReadU32(signaturePos + 0x58);
         if (playerTableLen > 32)
             continue;
 
         /* [0x5C] */
         const size_t soundModePosCandidate = signaturePos + 0x5C;
-        const uint32_t soundModeCandidate = rom.ReadU32(soundModePosCandidate);
+        const uint32_t soundModeCandidate = signature.ReadU32(soundModePosCandidate);
         /* Compared to "Normal" sound modes vs Metroid sound modes is, that the
          * reserved byte appears to be actually used. It does something with stereo/mono
          * switching, but we probably don't care about that in agbplay. */
@@ -488,16 +498,16 @@ bool MP2KScanner::FindSoundModeMetroid(size_t playerTablePos, size_t &soundModeP
             continue;
 
         /* [0x60] */
-        if (!IsValidRamPointer(rom.ReadU32(signaturePos + 0x60)))
+        if (!IsValidRamPointer(signature.ReadU32(signaturePos + 0x60)))
             continue;
 
         /* [0x68] */
-        if (rom.ReadU32(signaturePos + 0x68) != 0x040000D4)
+        if (signature.ReadU32(signaturePos + 0x68) != 0x040000D4)
             continue;
 
         /* [0x6C] */
         /* check player table pos (probably redundant as it's an argument) */
-        if (!rom.ValidPointer(rom.ReadU32(signaturePos + 0x6C)))
+        if (!rom.ValidPointer(signature.ReadU32(signaturePos + 0x6C)))
             continue;
 
         soundModePos = soundModePosCandidate;
@@ -510,43 +520,41 @@ bool MP2KScanner::FindSoundModeMetroid(size_t playerTablePos, size_t &soundModeP
 
 bool MP2KScanner::IsPosReferenced(size_t pos) const
 {
-    return wordPointerCache.contains(static_cast<uint32_t>(pos + AGB_MAP_ROM));
+    /* only word aligned positions are considered */
+    if (pos % 4 != 0)
+        return false;
+    return !pointerIndex->GetReferences(pos).empty();
 }
 
 bool MP2KScanner::IsPosReferenced(size_t pos, size_t &findStartPos, size_t &referencePos) const
 {
-    bool foundReference = false;
-    for (size_t j = findStartPos; j < rom.Size() - 3; j += 4) {
-        const uint32_t referenceCandidate = rom.ReadU32(j);
-        if (!rom.ValidPointer(referenceCandidate))
-            continue;
-        if (referenceCandidate - AGB_MAP_ROM != pos)
-            continue;
+    const std::span<const uint32_t> references = pointerIndex->GetReferences(pos);
+    const auto it = std::lower_bound(references.begin(), references.end(), findStartPos);
+    if (it == references.end())
+        return false;
 
-        foundReference = true;
-        referencePos = j;
-        findStartPos = j + 4;
-        break;
-    }
-    return foundReference;
+    referencePos = *it;
+    findStartPos = referencePos + 4;
+    return true;
 }
 
 bool MP2KScanner::IsPosReferenced(const std::vector<size_t> &poss, size_t &index) const
 {
-    for (size_t j = SEARCH_START; j < rom.Size() - 3; j += 4) {
-        const uint32_t referenceCandidate = rom.ReadU32(j);
-        if (!rom.ValidPointer(referenceCandidate))
-            continue;
-
-        for (size_t i = 0; i < poss.size(); i++) {
-            if (referenceCandidate - AGB_MAP_ROM == poss[i]) {
-                index = i;
-                return true;
-            }
+    /* find the position, which is referenced first */
+    bool foundReference = false;
+    size_t firstReferencePos = 0;
+    for (size_t i = 0; i < poss.size(); i++) {
+        const std::span<const uint32_t> references = pointerIndex->GetReferences(poss[i]);
+        if (references.empty())
+            continue;
+        if (!foundReference || references.front() < firstReferencePos) {
+            foundReference = true;
+            firstReferencePos = references.front();
+            index = i;
         }
     }
 
-    return false;
+    return foundReference;
 }
 
 bool MP2KScanner::IsValidSongTableEntry(size_t pos, bool relaxed) const
@@ -554,28 +562,30 @@ bool MP2KScanner::IsValidSongTableEntry(size_t pos, bool relaxed) const
     if (!rom.ValidRange(pos, 8))
         return false;
 
+    const RomView entry = rom.View(pos, 8);
+
     /* 0. (optional) during GSF scanning, a relaxed scan is used. This is because
      * GSFs have unused entries from the GSF set zeroed, but we have to assume
      * they are valid for location of the song table start. */
-    if (relaxed && rom.ReadU32(pos) == 0 && rom.ReadU32(pos + 4) == 0)
+    if (relaxed && entry.ReadU32(pos) == 0 && entry.ReadU32(pos + 4) == 0)
         return true;
 
     /* 1. check if pointer to song is valid */
-    if (!rom.ValidPointer(rom.ReadU32(pos + 0)))
+    if (!entry.ValidPointer(entry.ReadU32(pos + 0)))
         return false;
 
     /* 2. check if music player numbers are correct.
      * Special case: For GSF sets p2 is always zero instead of equal to p1 */
-    const uint8_t p1 = rom.ReadU8(pos + 4);
-    const uint8_t z1 = rom.ReadU8(pos + 5);
-    const uint8_t p2 = rom.ReadU8(pos + 6);
-    const uint8_t z2 = rom.ReadU8(pos + 7);
+    const uint8_t p1 = entry.ReadU8(pos + 4);
+    const uint8_t z1 = entry.ReadU8(pos + 5);
+    const uint8_t p2 = entry.ReadU8(pos + 6);
+    const uint8_t z2 = entry.ReadU8(pos + 7);
 
     if (z1 != 0 || z2 != 0 || (rom.IsGsf() ? (p2 != 0) : (p1 != p2)))
         return false;
 
     /* 3. check if song is valid */
-    const size_t songPos = rom.ReadAgbPtrToPos(pos + 0);
+    const size_t songPos = entry.ReadAgbPtrToPos(pos + 0);
 
     const uint8_t nTracks = rom.ReadU8(songPos + 0);
     const uint8_t nBlocks = rom.ReadU8(songPos + 1);    // this field is not used, should be 0
@@ -599,6 +609,47 @@ bool MP2KScanner::IsValidSongTableEntry(size_t pos, bool relaxed) const
     return true;
 }
 
+bool MP2KScanner::IsValidSongTableCandidateEntry(size_t pos)
+{
+    /* same as IsValidSongTableEntry(pos, rom.IsGsf()), but uses the results of the parallel check */
+    if (pos % 4 != 0 || pos / 4 >= songTableEntryState.size())
+        return IsValidSongTableEntry(pos, rom.IsGsf());
+
+    if (songTableEntryState[pos / 4] == ENTRY_UNCHECKED)
+        CheckSongTableEntries(pos);
+
+    switch (songTableEntryState[pos / 4]) {
+    case ENTRY_VALID:
+        return true;
+    case ENTRY_INVALID:
+        return false;
+    default:
+        return IsValidSongTableEntry(pos, rom.IsGsf());
+    }
+}
+
+void MP2KScanner::CheckSongTableEntries(size_t startPos)
+{
+    /* Check one chunk per thread. Because the search usually continues right after startPos,
+     * the results of the following chunks will be used as well. */
+    const size_t windowSize = SCAN_CHUNK_SIZE * std::max(std::thread::hardware_concurrency(), 1u);
+    const size_t endPos = std::min(songTableEntryState.size() * 4, startPos + windowSize);
+    const bool relaxed = rom.IsGsf();
+
+    ParallelForChunks(startPos, endPos, SCAN_CHUNK_SIZE, [&](size_t chunkBegin, size_t chunkEnd) {
+        for (size_t pos = chunkBegin; pos < chunkEnd; pos += 4) {
+            uint8_t &state = songTableEntryState[pos / 4];
+            if (state != ENTRY_UNCHECKED)
+                continue;
+            try {
+                state = IsValidSongTableEntry(pos, relaxed) ? ENTRY_VALID : ENTRY_INVALID;
+            } catch (const std::exception &) {
+                state = ENTRY_ERROR;
+            }
+        }
+    });
+}
+
 bool MP2KScanner::IsValidPlayerTableEntry(size_t pos) const
 {
     /* A player table entry usually looks like this:
@@ -629,21 +680,6 @@ bool MP2KScanner::IsValidPlayerTableEntry(size_t pos) const
     return true;
 }
 
-void MP2KScanner::InitPointerCache()
-{
-    if (wordPointerCache.size() > 0)
-        return;
-
-    wordPointerCache.clear();
-
-    /* find list of all pointers in ROM */
-    for (size_t i = SEARCH_START; i < rom.Size() - 3; i += 4) {
-        const uint32_t ptr = rom.ReadU32(i);
-        if (rom.ValidPointer(ptr) && (ptr % 4) == 0)
-            wordPointerCache.insert(ptr);
-    }
-}
-
 bool MP2KScanner::IsValidIwramPointer(uint32_t word)
 {
     if (word >= 0x03000000 && word <= 0x03007FFF)
@@ -5,16 +5,20 @@
 #include <cstddef>
 #include <cstdint>
 #include <memory>
-#include <unordered_set>
 #include <vector>
 
 struct Profile;
 class Rom;
+class RomPointerIndex;
 
 class MP2KScanner
 {
 public:
-    MP2KScanner(const Rom &rom);
+    /* Multiple scanners of the same ROM should share the pointer index (see CreatePointerIndex).
+     * If pointerIndex is null, the scanner creates its own. */
+    MP2KScanner(const Rom &rom, std::shared_ptr<const RomPointerIndex> pointerIndex = nullptr);
+
+    static std::shared_ptr<const RomPointerIndex> CreatePointerIndex(const Rom &rom);
 
     struct Result
     {
@@ -26,7 +30,7 @@ public:
     std::vector<Result> Scan(std::shared_ptr<Profile> profile);
 
 private:
-    bool FindSongTable(size_t &findStartPos, size_t &songTablePos, uint16_t &songCount) const;
+    bool FindSongTable(size_t &findStartPos, size_t &songTablePos, uint16_t &songCount);
     bool FindPlayerTable(size_t songTablePos, size_t &playerTablePos, PlayerTableInfo &playerTableInfo) const;
     bool FindSoundMode(size_t playerTablePos, size_t &soundModePos, uint32_t &soundMode) const;
     bool FindSoundModeNormal(size_t playerTablePos, size_t &soundModePos, uint32_t &soundMode) const;
@@ -36,10 +40,10 @@ private:
     bool IsPosReferenced(size_t pos, size_t &findStartPos, size_t &referencePos) const;
     bool IsPosReferenced(const std::vector<size_t> &poss, size_t &index) const;
     bool IsValidSongTableEntry(size_t pos, bool relaxed) const;
+    bool IsValidSongTableCandidateEntry(size_t pos);
+    void CheckSongTableEntries(size_t startPos);
     bool IsValidPlayerTableEntry(size_t pos) const;
 
-    void InitPointerCache();
-
     static bool IsValidIwramPointer(uint32_t word);
     static bool IsValidEwramPointer(uint32_t word);
     static bool IsValidRamPointer(uint32_t word);
@@ -48,6 +52,13 @@ private:
     static const size_t SEARCH_START = 0x200;
 
     const Rom &rom;
+    std::shared_ptr<const RomPointerIndex> pointerIndex;
 
-    std::unordered_set<uint32_t> wordPointerCache;    // pointers to 'words' (i.e. 4-byte aligned pointers)
+    /* Song table candidates are searched sequentially, but the validity of the entries at each word aligned
+     * position is checked in parallel ahead of the search. Values are one of ENTRY_*, index is pos / 4. */
+    static const uint8_t ENTRY_UNCHECKED = 0;
+    static const uint8_t ENTRY_INVALID = 1;
+    static const uint8_t ENTRY_VALID = 2;
+    static const uint8_t ENTRY_ERROR = 3;    // check threw an exception, which is repeated when the entry is used
+    std::vector<uint8_t> songTableEntryState;
 };
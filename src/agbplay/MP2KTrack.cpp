@@ -3,6 +3,8 @@
 #include "MP2KChn.hpp"
 #include "MP2KContext.hpp"
 #include "ReverbEffect.hpp"
+#include "StateStream.hpp"
+#include "Xcept.hpp"
 
 #include <cassert>
 
@@ -15,6 +17,7 @@ MP2KTrack::MP2KTrack(const MP2KContext &ctx, uint8_t trackIdx) :
 void MP2KTrack::Init(size_t pos)
 {
     this->pos = pos;
+    eventIdx = SequenceEvent::INDEX_NONE;
     patternLevel = 0;
     modt = MODT::PITCH;
     lastCmd = 0;
@@ -94,3 +97,110 @@ void MP2KTrack::ResetLfoValue()
     else
         updateVolume = true;
 }
+
+void MP2KTrack::SaveState(StateWriter &w) const
+{
+    for (size_t i = 0; i < activeNotes.size(); i += 8) {
+        uint8_t bits = 0;
+        for (size_t j = 0; j < 8; j++)
+            bits = static_cast<uint8_t>(bits | (activeNotes[i + j] << j));
+        w.Write(bits);
+    }
+    w.Write(activeVoiceTypes);
+    w.WriteVector(audioBuffer);
+    loudnessCalculator.SaveState(w);
+
+    w.Write<bool>(reverb != nullptr);
+    if (reverb)
+        reverb->SaveState(w);
+
+    /* eventIdx is not saved, it is only valid for the SequenceDecoder it was obtained from */
+    w.Write(pos);
+    w.Write(returnPos);
+    w.Write(patternLevel);
+    w.Write(modt);
+    w.Write(lastCmd);
+    w.Write(pitch);
+    w.Write(lastNoteKey);
+    w.Write(lastNoteVel);
+    w.Write(lastNoteLen);
+    w.Write(reptCount);
+    w.Write(prog);
+    w.Write(vol);
+    w.Write(mod);
+    w.Write(bendr);
+    w.Write(priority);
+    w.Write(lfos);
+    w.Write(lfodl);
+    w.Write(lfodlCount);
+    w.Write(lfoPhase);
+    w.Write(lfoValue);
+    w.Write(pseudoEchoVol);
+    w.Write(pseudoEchoLen);
+    w.Write(delay);
+    w.Write(pan);
+    w.Write(bend);
+    w.Write(tune);
+    w.Write(keyShift);
+    w.Write(muted);
+    w.Write(enabled);
+    w.Write(updateVolume);
+    w.Write(updatePitch);
+}
+
+void MP2KTrack::LoadState(StateReader &r)
+{
+    for (size_t i = 0; i < activeNotes.size(); i += 8) {
+        const uint8_t bits = r.Read<uint8_t>();
+        for (size_t j = 0; j < 8; j++)
+            activeNotes[i + j] = (bits >> j) & 1;
+    }
+    r.Read(activeVoiceTypes);
+    r.ReadVector(audioBuffer);
+    loudnessCalculator.LoadState(r);
+
+    if (r.Read<bool>()) {
+        if (!reverb)
+            throw Xcept("Cannot restore track state: Reverb is not available in current mixer mode");
+        reverb->LoadState(r);
+    }
+
+    /* The event index is looked up again from the track position on the next tick. */
+    eventIdx = SequenceEvent::INDEX_NONE;
+    r.Read(pos);
+    r.Read(returnPos);
+    r.Read(patternLevel);
+    r.Read(modt);
+    r.Read(lastCmd);
+    r.Read(pitch);
+    r.Read(lastNoteKey);
+    r.Read(lastNoteVel);
+    r.Read(lastNoteLen);
+    r.Read(reptCount);
+    r.Read(prog);
+    r.Read(vol);
+    r.Read(mod);
+    r.Read(bendr);
+    r.Read(priority);
+    r.Read(lfos);
+    r.Read(lfodl);
+    r.Read(lfodlCount);
+    r.Read(lfoPhase);
+    r.Read(lfoValue);
+    r.Read(pseudoEchoVol);
+    r.Read(pseudoEchoLen);
+    r.Read(delay);
+    r.Read(pan);
+    r.Read(bend);
+    r.Read(tune);
+    r.Read(keyShift);
+    r.Read(muted);
+    r.Read(enabled);
+    r.Read(updateVolume);
+    r.Read(updatePitch);
+
+    if (patternLevel > TRACK_CALL_STACK_SIZE)
+        throw Xcept("Cannot restore track state: Invalid pattern level {}", patternLevel);
+
+    channels = nullptr;
+}
@@ -9,6 +9,7 @@
 // TODO remove dependency for NUM_NOTES, and possibly remove active notes state?
 #include "Constants.hpp"
 #include "LoudnessCalculator.hpp"
+#include "SequenceDecoder.hpp"
 #include "Types.hpp"
 
 #define TRACK_CALL_STACK_SIZE 3
@@ -18,6 +19,8 @@ enum class MODT : int { PITCH = 0, VOL, PAN };
 struct MP2KChn;
 struct MP2KContext;
 class ReverbEffect;
+class StateWriter;
+class StateReader;
 
 struct MP2KTrack
 {
@@ -34,6 +37,10 @@ struct MP2KTrack
     int16_t GetPan();
     void ResetLfoValue();
 
+    /* The channel list is not part of the track state and has to be restored by the caller. */
+    void SaveState(StateWriter &w) const;
+    void LoadState(StateReader &r);
+
     std::bitset<NUM_NOTES> activeNotes;
     VoiceFlags activeVoiceTypes;
     std::vector<sample> audioBuffer;
@@ -41,6 +48,7 @@ struct MP2KTrack
     LoudnessCalculator loudnessCalculator;
 
     size_t pos;
+    uint32_t eventIdx;
     size_t returnPos[TRACK_CALL_STACK_SIZE];
     uint8_t patternLevel;
     MODT modt = MODT::PITCH;
@@ -0,0 +1,88 @@
+#include "MappedFile.hpp"
+
+#if defined(_WIN32)
+// if we compile for Windows native
+
+#include <windows.h>
+
+std::unique_ptr<MappedFile> MappedFile::Map(const std::filesystem::path &filePath)
+{
+    std::unique_ptr<MappedFile> file(new MappedFile());
+
+    HANDLE fileHandle = CreateFileW(
+        filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL
+    );
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return nullptr;
+    file->fileHandle = fileHandle;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart <= 0)
+        return nullptr;
+
+    HANDLE mappingHandle = CreateFileMappingW(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mappingHandle == NULL)
+        return nullptr;
+    file->mappingHandle = mappingHandle;
+
+    const void *data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (data == NULL)
+        return nullptr;
+
+    file->data = static_cast<const uint8_t *>(data);
+    file->size = static_cast<size_t>(fileSize.QuadPart);
+    return file;
+}
+
+MappedFile::~MappedFile()
+{
+    if (data)
+        UnmapViewOfFile(data);
+    if (mappingHandle)
+        CloseHandle(mappingHandle);
+    if (fileHandle)
+        CloseHandle(fileHandle);
+}
+
+#else
+// if we compile for Linux/macOS
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::unique_ptr<MappedFile> MappedFile::Map(const std::filesystem::path &filePath)
+{
+    const int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd == -1)
+        return nullptr;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) == -1 || !S_ISREG(fileStat.st_mode) || fileStat.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    const size_t size = static_cast<size_t>(fileStat.st_size);
+    void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    /* The mapping stays valid after closing the file. */
+    close(fd);
+
+    if (data == MAP_FAILED)
+        return nullptr;
+
+    std::unique_ptr<MappedFile> file(new MappedFile());
+    file->data = static_cast<const uint8_t *>(data);
+    file->size = size;
+    return file;
+}
+
+MappedFile::~MappedFile()
+{
+    if (data)
+        munmap(const_cast<uint8_t *>(data), size);
+}
+
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+
+/* Read-only private memory mapping of a file. The pages are backed by the page cache, so processes which
+ * map the same file share the memory and nothing is read before it is accessed.
+ * The file must not be modified while it is mapped. A private mapping does not protect against that on POSIX:
+ * changes to the file may still become visible, and accessing pages after the file was truncated is fatal
+ * (SIGBUS). On Windows the file is opened without write sharing, so it cannot be modified. */
+class MappedFile
+{
+public:
+    /* Returns nullptr if the file cannot be mapped. Callers should read the file normally in that case. */
+    static std::unique_ptr<MappedFile> Map(const std::filesystem::path &filePath);
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile();
+
+    std::span<const uint8_t> Data() const { return {data, size}; }
+
+private:
+    MappedFile() = default;
+
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+#if defined(_WIN32)
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+};
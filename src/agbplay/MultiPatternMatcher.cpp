@@ -0,0 +1,130 @@
+#include "MultiPatternMatcher.hpp"
+
+#include <algorithm>
+#include <utility>
+#include <queue>
+
+/*
+ * public MultiPatternMatcher
+ */
+
+size_t MultiPatternMatcher::AddPattern(std::span<const uint8_t> pattern)
+{
+    const size_t patternIdx = patternCount++;
+    if (pattern.empty())
+        return patternIdx;
+
+    uint32_t node = 0;
+    for (const uint8_t byte : pattern) {
+        uint32_t child = GetChild(node, byte);
+        if (child == NODE_NONE) {
+            child = static_cast<uint32_t>(nodes.size());
+            nodes.emplace_back().depth = nodes[node].depth + 1;
+            auto &children = nodes[node].children;
+            const auto it = std::lower_bound(children.begin(), children.end(), std::make_pair(byte, uint32_t{0}));
+            children.emplace(it, byte, child);
+        }
+        node = child;
+    }
+
+    nodes[node].patterns.push_back(static_cast<uint32_t>(patternIdx));
+    built = false;
+    return patternIdx;
+}
+
+std::vector<size_t> MultiPatternMatcher::FindFirst(std::span<const uint8_t> data)
+{
+    if (!built)
+        Build();
+
+    std::vector<size_t> result(patternCount, NOT_FOUND);
+    size_t remaining = 0;
+    for (const Node &n : nodes)
+        remaining += n.patterns.size();
+
+    uint32_t node = 0;
+    for (size_t i = 0; i < data.size() && remaining > 0; i++) {
+        node = Step(node, data[i]);
+
+        /* report all patterns ending here, if they have not been found before */
+        for (uint32_t out = firstOutput[node]; out != NODE_NONE; out = nodes[out].outputLink) {
+            for (const uint32_t patternIdx : nodes[out].patterns) {
+                if (result[patternIdx] == NOT_FOUND) {
+                    result[patternIdx] = i + 1 - nodes[out].depth;
+                    remaining--;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+/*
+ * private MultiPatternMatcher
+ */
+
+uint32_t MultiPatternMatcher::GetChild(uint32_t node, uint8_t byte) const
+{
+    const auto &children = nodes[node].children;
+    const auto it = std::lower_bound(children.begin(), children.end(), std::make_pair(byte, uint32_t{0}));
+    if (it == children.end() || it->first != byte)
+        return NODE_NONE;
+    return it->second;
+}
+
+uint32_t MultiPatternMatcher::Step(uint32_t node, uint8_t byte) const
+{
+    /* The root is always dense, so this terminates. */
+    while (true) {
+        if (nodes[node].dense != NODE_NONE)
+            return denseTransitions[nodes[node].dense][byte];
+        if (const uint32_t child = GetChild(node, byte); child != NODE_NONE)
+            return child;
+        node = nodes[node].fail;
+    }
+}
+
+void MultiPatternMatcher::Build()
+{
+    /* Breadth first, so the fail links and transitions of all shorter prefixes are known when a node is
+     * processed. The fail link always points to a shorter prefix. */
+    denseTransitions.clear();
+    std::queue<uint32_t> queue;
+    queue.push(0);
+    nodes[0].fail = 0;
+    nodes[0].outputLink = NODE_NONE;
+
+    while (!queue.empty()) {
+        const uint32_t node = queue.front();
+        queue.pop();
+
+        for (const auto &[byte, child] : nodes[node].children) {
+            const uint32_t fail = node == 0 ? 0 : Step(nodes[node].fail, byte);
+            nodes[child].fail = fail;
+            nodes[child].outputLink = nodes[fail].patterns.empty() ? nodes[fail].outputLink : fail;
+            queue.push(child);
+        }
+
+        if (nodes[node].depth <= DENSE_DEPTH) {
+            std::array<uint32_t, 256> &transitions = denseTransitions.emplace_back();
+            for (size_t i = 0; i < transitions.size(); i++) {
+                const uint8_t byte = static_cast<uint8_t>(i);
+                const uint32_t child = GetChild(node, byte);
+                if (child != NODE_NONE)
+                    transitions[byte] = child;
+                else
+                    transitions[byte] = node == 0 ? 0 : Step(nodes[node].fail, byte);
+            }
+            nodes[node].dense = static_cast<uint32_t>(denseTransitions.size() - 1);
+        } else {
+            nodes[node].dense = NODE_NONE;
+        }
+    }
+
+    firstOutput.resize(nodes.size());
+    for (size_t node = 0; node < nodes.size(); node++)
+        firstOutput[node] = nodes[node].patterns.empty() ? nodes[node].outputLink : static_cast<uint32_t>(node);
+
+    built = true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+/* MultiPatternMatcher searches for multiple byte patterns at once using the Aho-Corasick algorithm.
+ * The data is only read once, regardless of the number and length of the patterns. */
+class MultiPatternMatcher
+{
+public:
+    static const size_t NOT_FOUND = static_cast<size_t>(-1);
+
+    /* Returns the index of the pattern. Empty patterns are never found. */
+    size_t AddPattern(std::span<const uint8_t> pattern);
+
+    /* Returns the start position of the first occurrence of each pattern (or NOT_FOUND). */
+    std::vector<size_t> FindFirst(std::span<const uint8_t> data);
+
+private:
+    static const uint32_t NODE_NONE = 0xFFFFFFFF;
+
+    struct Node
+    {
+        std::vector<std::pair<uint8_t, uint32_t>> children;    // sorted by byte
+        uint32_t fail = 0;
+        uint32_t outputLink = NODE_NONE;    // next node on the fail chain, which ends a pattern
+        uint32_t depth = 0;
+        uint32_t dense = NODE_NONE;    // index into denseTransitions
+        std::vector<uint32_t> patterns;    // patterns ending at this node
+    };
+
+    uint32_t GetChild(uint32_t node, uint8_t byte) const;
+    uint32_t Step(uint32_t node, uint8_t byte) const;
+    void Build();
+
+    /* node 0 is the root */
+    std::vector<Node> nodes = std::vector<Node>(1);
+    size_t patternCount = 0;
+    bool built = false;
+
+    /* Nodes up to DENSE_DEPTH, where the search spends most of its time, have a complete transition table
+     * including the fail links. Deeper nodes only store their children. */
+    static const uint32_t DENSE_DEPTH = 1;
+    std::vector<std::array<uint32_t, 256>> denseTransitions;
+
+    /* first node on the output chain of each node, kept separately to keep the search loop cache friendly */
+    std::vector<uint32_t> firstOutput;
+};
@@ -3,7 +3,10 @@
 #include "Xcept.hpp"
 
 #include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
 #include <iostream>
+#include <random>
 
 #if defined(_WIN32)
 // if we compile for Windows native
@@ -56,6 +59,11 @@ const std::filesystem::path OS::GetGlobalConfigDirectory()
     return retval;
 }
 
+uint64_t OS::GetProcessId()
+{
+    return GetCurrentProcessId();
+}
+
 #elif __has_include(<unistd.h>)
 // if we compile for a UNIX'oid
 
@@ -94,12 +102,49 @@ const std::filesystem::path OS::GetGlobalConfigDirectory()
     return std::filesystem::path("/etc");
 }
 
+uint64_t OS::GetProcessId()
+{
+    return static_cast<uint64_t>(getpid());
+}
+
 #else
 // Unsupported OS
 #error \
     "Apparently your OS is neither Windows nor appears to be a UNIX variant (no unistd.h). You will have to add support for your OS in src/OS.cpp :/"
 #endif
 
+std::string OS::GetUniqueName()
+{
+    thread_local std::mt19937_64 rng{std::random_device{}()};
+    return fmt::format("{}-{:016x}", GetProcessId(), rng());
+}
+
+bool OS::WriteFileAtomic(const std::filesystem::path &filePath, std::span<const uint8_t> data)
+{
+    std::filesystem::path tmpPath = filePath;
+    tmpPath += fmt::format(".{}.tmp", GetUniqueName());
+
+    std::error_code ec;
+    {
+        std::ofstream ofs(tmpPath, std::ios::binary | std::ios::noreplace);
+        ofs.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+        if (!ofs) {
+            const bool opened = ofs.is_open();
+            ofs.close();
+            if (opened)
+                std::filesystem::remove(tmpPath, ec);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tmpPath, filePath, ec);
+    if (ec) {
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
+
 #ifdef __APPLE__
 #include <libproc.h>
 #include <sys/sysctl.h>
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
+#include <span>
 #include <string>
 
 namespace OS
@@ -10,4 +12,11 @@ namespace OS
     const std::filesystem::path GetMusicDirectory();
     const std::filesystem::path GetLocalConfigDirectory();
     const std::filesystem::path GetGlobalConfigDirectory();
+    uint64_t GetProcessId();
+    /* random string containing the process id, which is unique across threads and processes */
+    std::string GetUniqueName();
+    /* Writes the file through a temporary file with a process unique name, which is renamed afterwards. Other
+     * processes therefore either see the old or the complete new file. Returns false on errors, in which case
+     * the file is left unchanged. */
+    bool WriteFileAtomic(const std::filesystem::path &filePath, std::span<const uint8_t> data);
 };    // namespace OS
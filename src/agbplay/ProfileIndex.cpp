@@ -0,0 +1,141 @@
+#include "ProfileIndex.hpp"
+
+#include "Constants.hpp"
+#include "Debug.hpp"
+#include "OS.hpp"
+#include "StateStream.hpp"
+#include "Util.hpp"
+#include "Xcept.hpp"
+
+#include <array>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+static const std::array<char, 8> PROFILE_INDEX_MAGIC = {'A', 'G', 'B', 'P', 'P', 'I', 'D', 'X'};
+// has to be incremented whenever the index file format changes
+static const uint32_t PROFILE_INDEX_VERSION = 1;
+
+/*
+ * public ProfileIndex
+ */
+
+ProfileIndex::ProfileIndex(const std::filesystem::path &indexPath) : indexPath(indexPath)
+{
+}
+
+void ProfileIndex::Update(const std::vector<std::filesystem::path> &profilePaths, const GameCodeReader &readGameCodes)
+{
+    std::vector<Entry> loadedEntries;
+    Load(loadedEntries);
+    std::unordered_map<std::string, Entry *> loadedEntryByPath;
+    for (Entry &entry : loadedEntries)
+        loadedEntryByPath.try_emplace(entry.path.string(), &entry);
+
+    /* reuse all unchanged entries, collect the others */
+    std::vector<Entry> newEntries(profilePaths.size());
+    std::vector<size_t> changedEntries;
+    for (size_t i = 0; i < profilePaths.size(); i++) {
+        Entry &entry = newEntries[i];
+        entry.path = profilePaths[i];
+
+        std::error_code ec;
+        entry.modificationTime = std::filesystem::last_write_time(entry.path, ec).time_since_epoch().count();
+        entry.size = std::filesystem::file_size(entry.path, ec);
+
+        const auto it = loadedEntryByPath.find(entry.path.string());
+        if (!ec && it != loadedEntryByPath.end() && it->second->modificationTime == entry.modificationTime
+                && it->second->size == entry.size)
+            entry.gameCodes = std::move(it->second->gameCodes);
+        else
+            changedEntries.push_back(i);
+    }
+
+    ParallelForChunks(0, changedEntries.size(), PROFILE_FILES_PER_THREAD, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Entry &entry = newEntries[changedEntries[i]];
+            entry.gameCodes = readGameCodes(entry.path);
+        }
+    });
+
+    const bool changed = !changedEntries.empty() || newEntries.size() != loadedEntries.size();
+    entries = std::move(newEntries);
+
+    if (changed) {
+        Debug::print("Updated profile index ({} of {} profiles changed)", changedEntries.size(), entries.size());
+        Save();
+    }
+}
+
+const std::vector<ProfileIndex::Entry> &ProfileIndex::GetEntries() const
+{
+    return entries;
+}
+
+/*
+ * private ProfileIndex
+ */
+
+void ProfileIndex::Load(std::vector<Entry> &loadedEntries) const
+{
+    std::ifstream ifs(indexPath, std::ios::binary);
+    if (!ifs.is_open())
+        return;
+
+    const std::vector<uint8_t> data{std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+    if (ifs.bad())
+        return;
+
+    try {
+        StateReader r(data);
+        if (r.Read<std::array<char, 8>>() != PROFILE_INDEX_MAGIC || r.Read<uint32_t>() != PROFILE_INDEX_VERSION)
+            return;
+
+        const uint64_t entryCount = r.Read<uint64_t>();
+        for (uint64_t i = 0; i < entryCount; i++) {
+            Entry &entry = loadedEntries.emplace_back();
+            std::string path;
+            r.ReadString(path);
+            entry.path = std::u8string(path.begin(), path.end());
+            r.Read(entry.modificationTime);
+            r.Read(entry.size);
+            /* each game code is stored with at least its 64 bit length */
+            const uint32_t gameCodeCount = r.Read<uint32_t>();
+            if (gameCodeCount > r.Remaining() / sizeof(uint64_t))
+                throw Xcept("game code count {} exceeds end of file", gameCodeCount);
+            entry.gameCodes.resize(gameCodeCount);
+            for (std::string &gameCode : entry.gameCodes)
+                r.ReadString(gameCode);
+        }
+
+        if (!r.AtEnd())
+            throw Xcept("unexpected data at end of file");
+    } catch (const Xcept &e) {
+        Debug::print("Ignoring damaged profile index '{}': {}", indexPath.string(), e.what());
+        loadedEntries.clear();
+    }
+}
+
+void ProfileIndex::Save() const
+{
+    StateWriter w;
+    w.Write(PROFILE_INDEX_MAGIC);
+    w.Write(PROFILE_INDEX_VERSION);
+    w.Write<uint64_t>(entries.size());
+    for (const Entry &entry : entries) {
+        const std::u8string path = entry.path.u8string();
+        w.WriteString(std::string(path.begin(), path.end()));
+        w.Write(entry.modificationTime);
+        w.Write(entry.size);
+        w.Write(static_cast<uint32_t>(entry.gameCodes.size()));
+        for (const std::string &gameCode : entry.gameCodes)
+            w.WriteString(gameCode);
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(indexPath.parent_path(), ec);
+    if (ec)
+        return;
+
+    OS::WriteFileAtomic(indexPath, w.GetData());
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+/* The ProfileIndex maps profile files to the game codes they match, so only the profiles of the loaded game
+ * have to be parsed completely. The index is kept on disk and a file is only read again if its modification
+ * time or size changed. */
+class ProfileIndex
+{
+public:
+    struct Entry
+    {
+        std::filesystem::path path;
+        int64_t modificationTime = 0;
+        uint64_t size = 0;
+        std::vector<std::string> gameCodes;
+    };
+
+    using GameCodeReader = std::function<std::vector<std::string>(const std::filesystem::path &)>;
+
+    ProfileIndex(const std::filesystem::path &indexPath);
+
+    /* Sets the index to profilePaths (in that order). New and changed files are read with readGameCodes in
+     * parallel. The first exception thrown by readGameCodes is rethrown. */
+    void Update(const std::vector<std::filesystem::path> &profilePaths, const GameCodeReader &readGameCodes);
+    const std::vector<Entry> &GetEntries() const;
+
+private:
+    void Load(std::vector<Entry> &loadedEntries) const;
+    void Save() const;
+
+    std::filesystem::path indexPath;
+    std::vector<Entry> entries;
+};
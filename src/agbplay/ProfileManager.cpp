@@ -2,8 +2,10 @@
 
 #include "Debug.hpp"
 #include "MP2KScanner.hpp"
+#include "MultiPatternMatcher.hpp"
 #include "OS.hpp"
 #include "Rom.hpp"
+#include "ScanCache.hpp"
 #include "Xcept.hpp"
 
 #include <algorithm>
@@ -18,16 +20,69 @@
 // It is currently legal to have multiple profiles with the same path. We should somehow check for that
 // to deny incosistent states.
 
+/* gameCodes are parsed separately for the profile index, so both have to use the same function */
+static void LoadGameMatch(const nlohmann::json &j, const std::filesystem::path &filePath, Profile::GameMatch &gameMatch)
+{
+    if (j.contains("gameMatch") && j["gameMatch"].is_object()) {
+        const auto &gm = j["gameMatch"];
+        if (!gm.contains("gameCodes") || !gm["gameCodes"].is_array())
+            throw Xcept("Cannot parse profile: {}, gameCodes does not exist or is not an array", filePath.string());
+
+        for (const auto &gameCode : gm["gameCodes"]) {
+            if (!gameCode.is_string())
+                continue;
+            if (std::string(gameCode).size() != 4)
+                continue;
+            gameMatch.gameCodes.emplace_back(std::string(gameCode));
+        }
+
+        if (gameMatch.gameCodes.size() == 0)
+            throw Xcept("Cannot parse profile: {}, the profile must at least match one game code", filePath.string());
+
+        if (gm.contains("magicBytes") && gm["magicBytes"].is_array()) {
+            for (const auto &byte : gm["magicBytes"]) {
+                if (!byte.is_number())
+                    throw Xcept("Cannot parse profile: {}, magic byte list contains non-number", filePath.string());
+
+                gameMatch.magicBytes.emplace_back(byte);
+            }
+        }
+    } else {
+        throw Xcept("Cannot parse profile: {}, missing field: gameMatch", filePath.string());
+    }
+}
+
+static nlohmann::json ParseProfileFile(const std::filesystem::path &filePath)
+{
+    std::ifstream fileStream(filePath);
+    if (!fileStream.is_open()) {
+        // perhaps it's better to just issue a warning instead of failing
+        const std::string err = strerror(errno);
+        throw Xcept("Failed to open file: {}, {}", filePath.string(), err);
+    }
+
+    return nlohmann::json::parse(fileStream);
+}
+
+ProfileManager::ProfileManager() : profileIndex(OS::GetLocalConfigDirectory() / "agbplay" / "profile-index.bin")
+{
+}
+
 void ProfileManager::Reset()
 {
     profiles.clear();
+    indexedProfileLoaded.assign(indexedProfileLoaded.size(), false);
 }
 
 void ProfileManager::LoadProfiles()
 {
     const auto configDir = OS::GetLocalConfigDirectory();
-    LoadProfileDir(configDir / "agbplay" / "profiles");
-    LoadProfileDir(configDir / "agbplay" / "profiles-user");
+    std::vector<std::filesystem::path> profilePaths;
+    FindProfileFiles(configDir / "agbplay" / "profiles", profilePaths);
+    FindProfileFiles(configDir / "agbplay" / "profiles-user", profilePaths);
+
+    profileIndex.Update(profilePaths, ReadGameCodes);
+    indexedProfileLoaded.assign(profileIndex.GetEntries().size(), false);
 }
 
 std::filesystem::path ProfileManager::ProfileUserPath()
@@ -42,7 +97,7 @@ std::shared_ptr<Profile> ProfileManager::GetCLIDefaultProfile(const Rom &rom)
     assert(profileCandidates.size() >= 1);
     size_t profileIdx = 0;
     if (profileCandidates.size() > 1) {
-        fmt::print("Found multiple matching profiles, please select profile to load:\n");
+        fmt::print(stderr, "Found multiple matching profiles, please select profile to load:\n");
         for (size_t i = 0; i < profileCandidates.size(); i++) {
             Profile &p = *profileCandidates.at(i);
             std::string d = p.description;
@@ -50,6 +105,7 @@ std::shared_ptr<Profile> ProfileManager::GetCLIDefaultProfile(const Rom &rom)
                 d = "<no description>";
             if (p.songTableInfoConfig.pos != SongTableInfo::POS_AUTO)
                 fmt::print(
+                    stderr,
                     " [{}]:\n  file: {}\n  descrpiption: {}\n  tablePos=0x{:X}\n",
                     i,
                     p.path.string(),
@@ -58,6 +114,7 @@ std::shared_ptr<Profile> ProfileManager::GetCLIDefaultProfile(const Rom &rom)
                 );
             else
                 fmt::print(
+                    stderr,
                     " [{}]:\n  file: {}\n  descrpiption: {}\n  tableIdx={}\n",
                     i,
                     p.path.string(),
@@ -68,10 +125,10 @@ std::shared_ptr<Profile> ProfileManager::GetCLIDefaultProfile(const Rom &rom)
         size_t i;
         do {
             std::string istr;
-            std::cout << "Specify number of listed profiles to load: " << std::flush;
+            std::cerr << "Specify number of listed profiles to load: " << std::flush;
             std::cin >> istr;
             if (std::cin.eof()) {
-                std::cout << std::endl;
+                std::cerr << std::endl;
                 throw Xcept("Cannot load profile: No profile number specified");
             }
             try {
@@ -90,9 +147,22 @@ void ProfileManager::ScanRomToProfiles(
     const Rom &rom, std::vector<std::shared_ptr<Profile>> &profileCandidates
 )
 {
+    /* The pointer index only depends on the ROM, so build it once for all scans, but only if a scan is
+     * actually required and the result is not cached already. */
+    ScanCache scanCache(rom);
+    std::shared_ptr<const RomPointerIndex> pointerIndex;
+    auto scanner = [&]() {
+        if (!pointerIndex)
+            pointerIndex = MP2KScanner::CreatePointerIndex(rom);
+        return MP2KScanner(rom, pointerIndex);
+    };
+
     for (std::shared_ptr<Profile> &profileCandidate : profileCandidates) {
-        MP2KScanner scanner(rom);
-        (void)scanner.Scan(profileCandidate);
+        if (!scanCache.GetProfileScan(*profileCandidate)) {
+            (void)scanner().Scan(profileCandidate);
+            if (profileCandidate->ScanOk())
+                scanCache.PutProfileScan(*profileCandidate);
+        }
 
         if (!profileCandidate->ScanOk()) {
             Debug::print("Cannot use profile '{}'. A required structure was not found: {}", profileCandidate->path.string(), profileCandidate->GetScanDebugString());
@@ -112,13 +182,20 @@ void ProfileManager::ScanRomToProfiles(
         profileCandidates.end()
     );
 
-    if (profileCandidates.size() > 0)
+    if (profileCandidates.size() > 0) {
+        scanCache.Save();
         return;
+    }
 
     std::string code = rom.GetROMCode();
 
-    MP2KScanner scanner(rom);
-    const auto results = scanner.Scan(nullptr);
+    std::vector<MP2KScanner::Result> results;
+    if (!scanCache.GetScan(results)) {
+        results = scanner().Scan(nullptr);
+        if (results.size() > 0)
+            scanCache.PutScan(results);
+    }
+    scanCache.Save();
 
     if (results.size() == 0)
         throw Xcept("Scanner failed to find songtable/mp2k and no profile with manual configuration was found.");
@@ -135,7 +212,9 @@ void ProfileManager::ScanRomToProfiles(
     }
 }
 
-void ProfileManager::LoadProfileDir(const std::filesystem::path &dir)
+void ProfileManager::FindProfileFiles(
+    const std::filesystem::path &dir, std::vector<std::filesystem::path> &profilePaths
+)
 {
     if (std::filesystem::create_directories(dir))
         Debug::print("Creating profile directory '{}', which does not exist yet.", dir.string());
@@ -147,9 +226,32 @@ void ProfileManager::LoadProfileDir(const std::filesystem::path &dir)
 
     for (const auto &dirEntry : std::filesystem::directory_iterator(dir)) {
         if (dirEntry.is_directory())
-            LoadProfileDir(dirEntry.path());
+            FindProfileFiles(dirEntry.path(), profilePaths);
         else if (dirEntry.path().extension() == ".json")
-            LoadProfile(dirEntry.path());
+            profilePaths.emplace_back(dirEntry.path());
+    }
+}
+
+std::vector<std::string> ProfileManager::ReadGameCodes(const std::filesystem::path &filePath)
+{
+    Profile::GameMatch gameMatch;
+    LoadGameMatch(ParseProfileFile(filePath), filePath, gameMatch);
+    return std::move(gameMatch.gameCodes);
+}
+
+void ProfileManager::LoadIndexedProfiles(const std::string &gameCode)
+{
+    /* An empty gameCode loads all profiles. */
+    const std::vector<ProfileIndex::Entry> &entries = profileIndex.GetEntries();
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (indexedProfileLoaded.at(i))
+            continue;
+        if (!gameCode.empty() && std::find(entries[i].gameCodes.begin(), entries[i].gameCodes.end(), gameCode)
+                == entries[i].gameCodes.end())
+            continue;
+
+        LoadProfile(entries[i].path);
+        indexedProfileLoaded.at(i) = true;
     }
 }
 
@@ -168,6 +270,7 @@ std::vector<std::shared_ptr<Profile>>
      * If multiples are found and if there is a strong match (e.g. magic bytes), return it.
      * If multiples are found and none is preferred, return them all */
     const auto gameCode = rom.GetROMCode();
+    LoadIndexedProfiles(gameCode);
 
     /* find all matching game codes */
     std::vector<std::shared_ptr<Profile>> profilesWithGameCode;
@@ -194,55 +297,25 @@ std::vector<std::shared_ptr<Profile>>
         return profilesWithGameCode;
     }
 
-    /* find all profiles with matching magic bytes */
-    std::vector<std::shared_ptr<Profile>> profilesToReturn;
+    /* find all profiles with matching magic bytes, ordered by the position of the first match */
+    MultiPatternMatcher matcher;
+    for (std::shared_ptr<Profile> &profile : profilesWithMagicBytes)
+        (void)matcher.AddPattern(profile->gameMatch.magicBytes);
 
-    // probably more complex than necessary, but I want to try a bloom filter today!
-    std::vector<uint8_t> bloomFilter;
-    for (std::shared_ptr<Profile> &profile : profilesWithMagicBytes) {
-        const auto &mb = profile->gameMatch.magicBytes;
-        if (mb.size() > bloomFilter.size())
-            bloomFilter.resize(mb.size(), 0);
+    const std::vector<size_t> matchPositions = matcher.FindFirst(rom.View().Bytes(0, rom.Size()));
 
-        for (size_t i = 0; i < mb.size(); i++)
-            bloomFilter.at(i) |= mb.at(i);
+    std::vector<size_t> matchingProfiles;
+    for (size_t i = 0; i < profilesWithMagicBytes.size(); i++) {
+        if (matchPositions[i] != MultiPatternMatcher::NOT_FOUND)
+            matchingProfiles.push_back(i);
     }
+    std::stable_sort(matchingProfiles.begin(), matchingProfiles.end(), [&](size_t a, size_t b) {
+        return matchPositions[a] < matchPositions[b];
+    });
 
-    for (size_t romIdx = 0; romIdx < rom.Size(); romIdx++) {
-        bool filterMatch = true;
-        const size_t clipSize = rom.Size() - romIdx;
-        for (size_t filtIdx = 0; filtIdx < std::min(bloomFilter.size(), clipSize); filtIdx++) {
-            const auto data = rom.ReadU8(romIdx + filtIdx);
-            if ((data & bloomFilter.at(filtIdx)) != data) {
-                filterMatch = false;
-                break;
-            }
-        }
-
-        if (filterMatch) [[unlikely]] {
-            /* if the bloom filter matched, now check which one actually matched */
-            auto &pwmb = profilesWithMagicBytes;
-            auto filterFunc = [&](std::shared_ptr<Profile> &profile) {
-                const auto &mb = profile->gameMatch.magicBytes;
-                if (romIdx + mb.size() > rom.Size())
-                    return false;
-                bool exactMatch = true;
-                for (size_t filtIdx = 0; filtIdx < mb.size(); filtIdx++) {
-                    if (rom.ReadU8(romIdx + filtIdx) != mb.at(filtIdx)) {
-                        exactMatch = false;
-                        break;
-                    }
-                }
-                if (exactMatch) {
-                    profilesToReturn.emplace_back(profile);
-                    return true;
-                }
-                return false;
-            };
-
-            pwmb.erase(std::remove_if(pwmb.begin(), pwmb.end(), filterFunc), pwmb.end());
-        }
-    }
+    std::vector<std::shared_ptr<Profile>> profilesToReturn;
+    for (const size_t i : matchingProfiles)
+        profilesToReturn.emplace_back(profilesWithMagicBytes[i]);
 
     ScanRomToProfiles(rom, profilesToReturn);
     return profilesToReturn;
@@ -250,6 +323,7 @@ std::vector<std::shared_ptr<Profile>>
 
 std::vector<std::shared_ptr<Profile>> &ProfileManager::GetAllProfiles()
 {
+    LoadIndexedProfiles("");
     return profiles;
 }
 
@@ -280,15 +354,7 @@ void ProfileManager::LoadProfile(const std::filesystem::path &filePath)
     // TODO issue warnings instead of ignoring them or throwing errors
     using nlohmann::json;
 
-    std::ifstream fileStream(filePath);
-    if (!fileStream.is_open()) {
-        // perhaps it's better to just issue a warning instead of failing
-        const std::string err = strerror(errno);
-        throw Xcept("Failed to open file: {}, {}", filePath.string(), err);
-    }
-
-    json j = json::parse(fileStream);
-    fileStream.close();
+    json j = ParseProfileFile(filePath);
 
     Profile p;
 
@@ -401,33 +467,7 @@ void ProfileManager::LoadProfile(const std::filesystem::path &filePath)
     }
 
     /* load game match */
-    if (j.contains("gameMatch") && j["gameMatch"].is_object()) {
-        const auto &gm = j["gameMatch"];
-        if (!gm.contains("gameCodes") || !gm["gameCodes"].is_array())
-            throw Xcept("Cannot parse profile: {}, gameCodes does not exist or is not an array", filePath.string());
-
-        for (const auto &gameCode : gm["gameCodes"]) {
-            if (!gameCode.is_string())
-                continue;
-            if (std::string(gameCode).size() != 4)
-                continue;
-            p.gameMatch.gameCodes.emplace_back(std::string(gameCode));
-        }
-
-        if (p.gameMatch.gameCodes.size() == 0)
-            throw Xcept("Cannot parse profile: {}, the profile must at least match one game code", filePath.string());
-
-        if (gm.contains("magicBytes") && gm["magicBytes"].is_array()) {
-            for (const auto &byte : gm["magicBytes"]) {
-                if (!byte.is_number())
-                    throw Xcept("Cannot parse profile: {}, magic byte list contains non-number", filePath.string());
-
-                p.gameMatch.magicBytes.emplace_back(byte);
-            }
-        }
-    } else {
-        throw Xcept("Cannot parse profile: {}, missing field: gameMatch", filePath.string());
-    }
+    LoadGameMatch(j, filePath, p.gameMatch);
 
     /* load description */
     if (j.contains("name") && j["name"].is_string())
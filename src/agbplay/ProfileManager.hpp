@@ -2,6 +2,7 @@
 
 #include "MP2KScanner.hpp"
 #include "Profile.hpp"
+#include "ProfileIndex.hpp"
 
 #include <filesystem>
 #include <functional>
@@ -11,9 +12,13 @@
 
 class Rom;
 
+/* Profiles are loaded lazily: LoadProfiles only updates the profile index, profile files are parsed once
+ * they are needed by GetProfiles (profiles matching the game code) or GetAllProfiles. */
 class ProfileManager
 {
 public:
+    ProfileManager();
+
     void Reset();
     void LoadProfiles();
     void SaveProfiles();
@@ -29,9 +34,13 @@ private:
         const Rom &rom,
         std::vector<std::shared_ptr<Profile>> &profiles
     );
-    void LoadProfileDir(const std::filesystem::path &filePath);
+    static void FindProfileFiles(const std::filesystem::path &dir, std::vector<std::filesystem::path> &profilePaths);
+    static std::vector<std::string> ReadGameCodes(const std::filesystem::path &filePath);
+    void LoadIndexedProfiles(const std::string &gameCode);
     void LoadProfile(const std::filesystem::path &filePath);
     void SaveProfile(std::shared_ptr<Profile> &profile);
 
     std::vector<std::shared_ptr<Profile>> profiles;
+    ProfileIndex profileIndex;
+    std::vector<bool> indexedProfileLoaded;    // same order as profileIndex.GetEntries()
 };
@@ -0,0 +1,274 @@
+#include "RenderProfiler.hpp"
+
+#include "Debug.hpp"
+#include "Xcept.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <new>
+#include <nlohmann/json.hpp>
+
+#ifdef AGBPLAY_RENDER_PROFILING
+/* Count all allocations of the threads, which currently have an active profiler. */
+void *operator new(std::size_t size)
+{
+    RenderProfiler::CountAllocation();
+    if (void *ptr = std::malloc(size != 0 ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+#endif
+
+static double percentile(std::span<const double> sortedValues, double p)
+{
+    if (sortedValues.empty())
+        return 0.0;
+    const size_t i = static_cast<size_t>(p * static_cast<double>(sortedValues.size() - 1) + 0.5);
+    return sortedValues[std::min(i, sortedValues.size() - 1)];
+}
+
+/*
+ * public RenderProfiler
+ */
+
+thread_local RenderProfiler *RenderProfiler::active = nullptr;
+
+RenderProfiler::RenderProfiler()
+{
+    /* deep enough for all nested stages, so entering a stage never allocates */
+    stageStack.reserve(16);
+}
+
+RenderProfiler::~RenderProfiler()
+{
+    if (active == this)
+        active = nullptr;
+}
+
+void RenderProfiler::Start(size_t expectedMicroframes)
+{
+    stageTimes.fill(clock::duration::zero());
+    stageStack.clear();
+    microframeTimes.clear();
+    /* some headroom, since song lengths are only estimated */
+    microframeTimes.reserve(expectedMicroframes + expectedMicroframes / 8);
+    peakVoices = 0;
+    allocations = 0;
+
+    startTime = clock::now();
+    lastTime = startTime;
+    active = this;
+}
+
+void RenderProfiler::Stop()
+{
+    stopTime = clock::now();
+    Attribute(stopTime);
+    active = nullptr;
+}
+
+RenderProfile RenderProfiler::GetProfile() const
+{
+    RenderProfile profile;
+    profile.totalSeconds = std::chrono::duration<double>(stopTime - startTime).count();
+    for (size_t i = 0; i < RenderProfile::NUM_STAGES; i++)
+        profile.stageSeconds[i] = std::chrono::duration<double>(stageTimes[i]).count();
+
+    std::vector<double> sortedTimes;
+    for (clock::duration t : microframeTimes)
+        sortedTimes.emplace_back(std::chrono::duration<double>(t).count());
+    std::sort(sortedTimes.begin(), sortedTimes.end());
+
+    profile.microframes = sortedTimes.size();
+    profile.microframeP50 = percentile(sortedTimes, 0.5);
+    profile.microframeP90 = percentile(sortedTimes, 0.9);
+    profile.microframeP99 = percentile(sortedTimes, 0.99);
+    profile.microframeMax = sortedTimes.empty() ? 0.0 : sortedTimes.back();
+    profile.peakVoices = peakVoices;
+    profile.allocations = allocations;
+    return profile;
+}
+
+const char *RenderProfiler::GetStageName(RenderStage stage)
+{
+    switch (stage) {
+    case RenderStage::SEQUENCER:
+        return "sequencer";
+    case RenderStage::PCM:
+        return "pcm";
+    case RenderStage::SQUARE:
+        return "square";
+    case RenderStage::WAVE:
+        return "wave";
+    case RenderStage::NOISE:
+        return "noise";
+    case RenderStage::RESAMPLER:
+        return "resampler";
+    case RenderStage::REVERB:
+        return "reverb";
+    case RenderStage::MIXDOWN:
+        return "mixdown";
+    case RenderStage::LOUDNESS:
+        return "loudness";
+    case RenderStage::FILE_IO:
+        return "file_io";
+    case RenderStage::OTHER:
+    case RenderStage::COUNT:
+        break;
+    }
+    return "other";
+}
+
+void RenderProfiler::PrintReport(std::span<const RenderProfile> profiles)
+{
+    std::string header = fmt::format("{:24} {:>9}", "song", "total s");
+    for (size_t i = 0; i < RenderProfile::NUM_STAGES; i++)
+        header += fmt::format(" {:>9}", GetStageName(static_cast<RenderStage>(i)));
+    header += fmt::format(
+        " {:>8} {:>8} {:>8} {:>8} {:>6} {:>9}", "p50 us", "p90 us", "p99 us", "max us", "voices", "allocs"
+    );
+    Debug::print("{}", header);
+
+    RenderProfile total;
+    for (const RenderProfile &profile : profiles) {
+        const std::string song = fmt::format("{} {}", profile.songId, profile.name);
+        std::string row = fmt::format("{:24.24} {:9.3f}", song, profile.totalSeconds);
+        for (size_t i = 0; i < RenderProfile::NUM_STAGES; i++) {
+            row += fmt::format(" {:9.3f}", profile.stageSeconds[i]);
+            total.stageSeconds[i] += profile.stageSeconds[i];
+        }
+        row += fmt::format(
+            " {:8.1f} {:8.1f} {:8.1f} {:8.1f} {:6} {:9}",
+            profile.microframeP50 * 1e6,
+            profile.microframeP90 * 1e6,
+            profile.microframeP99 * 1e6,
+            profile.microframeMax * 1e6,
+            profile.peakVoices,
+            profile.allocations
+        );
+        Debug::print("{}", row);
+
+        total.totalSeconds += profile.totalSeconds;
+        total.peakVoices = std::max(total.peakVoices, profile.peakVoices);
+        total.allocations += profile.allocations;
+    }
+
+    /* the share of each stage is more useful for the total than the absolute time */
+    std::string row = fmt::format("{:24} {:9.3f}", "total", total.totalSeconds);
+    for (size_t i = 0; i < RenderProfile::NUM_STAGES; i++) {
+        const double share = total.totalSeconds > 0.0 ? total.stageSeconds[i] / total.totalSeconds : 0.0;
+        row += fmt::format(" {:8.1f}%", share * 100.0);
+    }
+    row += fmt::format(" {:>8} {:>8} {:>8} {:>8} {:6} {:9}", "", "", "", "", total.peakVoices, total.allocations);
+    Debug::print("{}", row);
+}
+
+void RenderProfiler::SaveReport(const std::filesystem::path &filePath, std::span<const RenderProfile> profiles)
+{
+    using nlohmann::json;
+
+    json j = json::array();
+    for (const RenderProfile &profile : profiles) {
+        json stages = json::object();
+        for (size_t i = 0; i < RenderProfile::NUM_STAGES; i++)
+            stages[GetStageName(static_cast<RenderStage>(i))] = profile.stageSeconds[i];
+
+        json song;
+        song["name"] = profile.name;
+        song["songId"] = profile.songId;
+        song["samples"] = profile.samples;
+        song["totalSeconds"] = profile.totalSeconds;
+        song["stageSeconds"] = stages;
+        song["microframes"] = profile.microframes;
+        song["microframeSeconds"] = {
+            {"p50", profile.microframeP50},
+            {"p90", profile.microframeP90},
+            {"p99", profile.microframeP99},
+            {"max", profile.microframeMax},
+        };
+        song["peakVoices"] = profile.peakVoices;
+        song["allocations"] = profile.allocations;
+        j.emplace_back(std::move(song));
+    }
+
+    std::ofstream fileStream(filePath);
+    if (!fileStream.is_open())
+        throw Xcept("Failed to save render profile: {}", filePath.string());
+    fileStream << std::setw(2) << j << std::endl;
+}
+
+RenderProfiler::StageScope::StageScope(RenderStage stage) : profiler(active)
+{
+    if (profiler)
+        profiler->Enter(stage);
+}
+
+RenderProfiler::StageScope::~StageScope()
+{
+    if (profiler)
+        profiler->Leave();
+}
+
+RenderProfiler::MicroframeScope::MicroframeScope() : profiler(active)
+{
+    if (profiler)
+        startTime = clock::now();
+}
+
+RenderProfiler::MicroframeScope::~MicroframeScope()
+{
+    if (!profiler)
+        return;
+
+    /* If the estimate was too short, growing the vector must not be counted as an allocation of the renderer */
+    active = nullptr;
+    profiler->microframeTimes.emplace_back(clock::now() - startTime);
+    active = profiler;
+}
+
+void RenderProfiler::CountVoices(size_t voices)
+{
+    if (active)
+        active->peakVoices = std::max(active->peakVoices, voices);
+}
+
+void RenderProfiler::CountAllocation()
+{
+    if (active)
+        active->allocations++;
+}
+
+/*
+ * private RenderProfiler
+ */
+
+void RenderProfiler::Enter(RenderStage stage)
+{
+    Attribute(clock::now());
+    stageStack.emplace_back(stage);
+}
+
+void RenderProfiler::Leave()
+{
+    Attribute(clock::now());
+    stageStack.pop_back();
+}
+
+void RenderProfiler::Attribute(clock::time_point now)
+{
+    const RenderStage stage = stageStack.empty() ? RenderStage::OTHER : stageStack.back();
+    stageTimes[static_cast<size_t>(stage)] += now - lastTime;
+    lastTime = now;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+/* Optional instrumentation of the render pipeline. It is only compiled in if AGBPLAY_RENDER_PROFILING is defined
+ * (cmake -DENABLE_RENDER_PROFILING=ON), otherwise the PROFILE_* macros expand to nothing.
+ * Time is attributed exclusively, i.e. the time of a nested stage (e.g. the resampler within a PCM voice) is not
+ * counted for the enclosing stage. Time outside of any stage is counted as OTHER. */
+
+enum class RenderStage : size_t {
+    SEQUENCER,
+    PCM,
+    SQUARE,
+    WAVE,
+    NOISE,
+    RESAMPLER,
+    REVERB,
+    MIXDOWN,
+    LOUDNESS,
+    FILE_IO,
+    OTHER,
+    COUNT
+};
+
+/* Result of a RenderProfiler, times are in seconds */
+struct RenderProfile
+{
+    static const size_t NUM_STAGES = static_cast<size_t>(RenderStage::COUNT);
+
+    std::string name;
+    uint16_t songId = 0;
+    size_t samples = 0;
+    double totalSeconds = 0.0;
+    std::array<double, NUM_STAGES> stageSeconds{};
+    size_t microframes = 0;
+    double microframeP50 = 0.0;
+    double microframeP90 = 0.0;
+    double microframeP99 = 0.0;
+    double microframeMax = 0.0;
+    size_t peakVoices = 0;
+    uint64_t allocations = 0;
+};
+
+class RenderProfiler
+{
+public:
+    RenderProfiler();
+    RenderProfiler(const RenderProfiler &) = delete;
+    RenderProfiler &operator=(const RenderProfiler &) = delete;
+    ~RenderProfiler();
+
+    /* While started, the profiler records everything, which is rendered by the calling thread. The storage for
+     * the expected number of microframes is allocated up front, so recording them does not disturb the timing. */
+    void Start(size_t expectedMicroframes = 0);
+    void Stop();
+    RenderProfile GetProfile() const;
+
+    static const char *GetStageName(RenderStage stage);
+    /* prints a table with one row per song and a total row */
+    static void PrintReport(std::span<const RenderProfile> profiles);
+    static void SaveReport(const std::filesystem::path &filePath, std::span<const RenderProfile> profiles);
+
+    /* used by the PROFILE_* macros */
+    class StageScope
+    {
+    public:
+        StageScope(RenderStage stage);
+        StageScope(const StageScope &) = delete;
+        StageScope &operator=(const StageScope &) = delete;
+        ~StageScope();
+
+    private:
+        RenderProfiler *profiler;
+    };
+
+    class MicroframeScope
+    {
+    public:
+        MicroframeScope();
+        MicroframeScope(const MicroframeScope &) = delete;
+        MicroframeScope &operator=(const MicroframeScope &) = delete;
+        ~MicroframeScope();
+
+    private:
+        RenderProfiler *profiler;
+        std::chrono::steady_clock::time_point startTime;
+    };
+
+    static void CountVoices(size_t voices);
+    static void CountAllocation();
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    void Enter(RenderStage stage);
+    void Leave();
+    void Attribute(clock::time_point now);
+
+    std::array<clock::duration, RenderProfile::NUM_STAGES> stageTimes{};
+    std::vector<RenderStage> stageStack;
+    clock::time_point startTime;
+    clock::time_point stopTime;
+    clock::time_point lastTime;
+    std::vector<clock::duration> microframeTimes;
+    size_t peakVoices = 0;
+    uint64_t allocations = 0;
+
+    static thread_local RenderProfiler *active;
+};
+
+#ifdef AGBPLAY_RENDER_PROFILING
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_STAGE(stage) RenderProfiler::StageScope PROFILE_CONCAT(profileStage, __LINE__)(RenderStage::stage)
+#define PROFILE_MICROFRAME() RenderProfiler::MicroframeScope PROFILE_CONCAT(profileMicroframe, __LINE__)
+#define PROFILE_VOICES(voices) RenderProfiler::CountVoices(voices)
+#else
+#define PROFILE_STAGE(stage)
+#define PROFILE_MICROFRAME()
+#define PROFILE_VOICES(voices)
+#endif
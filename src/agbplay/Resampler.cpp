@@ -2,24 +2,11 @@
 
 #include "Debug.hpp"
 #include "ResamplerAVX2.hpp"
+#include "StateStream.hpp"
 #include "Util.hpp"
 
 #include <boost/math/special_functions/sinc.hpp>
 
-const bool AVX2_SUPPORTED = []() {
-#if defined(__x86_64__) || defined(i386) || defined(__i386__) || defined(__386)
-    __builtin_cpu_init();
-    if (__builtin_cpu_supports("avx2"))
-        return std::getenv("AGBPLAY_NO_AVX") ? false : true;
-    else
-        return false;
-#elif defined(_M_X64) || defined(_M_IX86)
-    static_assert(false, "AVX2 detection in MSVC is not yet implemented");
-#else
-    return false;
-#endif
-}();
-
 std::unique_ptr<Resampler> Resampler::MakeResampler(ResamplerType t)
 {
     switch (t) {
@@ -50,6 +37,18 @@ Resampler::~Resampler()
 {
 }
 
+void Resampler::SaveState(StateWriter &w) const
+{
+    w.WriteVector(fetchBuffer);
+    w.Write(phase);
+}
+
+void Resampler::LoadState(StateReader &r)
+{
+    r.ReadVector(fetchBuffer);
+    r.Read(phase);
+}
+
 NearestResampler::NearestResampler()
 {
 }
@@ -64,6 +63,11 @@ void NearestResampler::Reset()
     phase = 0.0f;
 }
 
+ResamplerType NearestResampler::GetType() const
+{
+    return ResamplerType::NEAREST;
+}
+
 bool NearestResampler::Process(std::span<float> buffer, float phaseInc, const FetchCallback &fetchCallback)
 {
     if (buffer.size() == 0)
@@ -106,6 +110,11 @@ void LinearResampler::Reset()
     phase = 0.0f;
 }
 
+ResamplerType LinearResampler::GetType() const
+{
+    return ResamplerType::LINEAR;
+}
+
 bool LinearResampler::Process(std::span<float> buffer, float phaseInc, const FetchCallback &fetchCallback)
 {
     if (buffer.size() == 0)
@@ -153,6 +162,11 @@ void SincResampler::Reset()
     phase = 0.0f;
 }
 
+ResamplerType SincResampler::GetType() const
+{
+    return ResamplerType::SINC;
+}
+
 bool SincResampler::Process(std::span<float> buffer, float phaseInc, const FetchCallback &fetchCallback)
 {
     if (buffer.size() == 0)
@@ -286,6 +300,11 @@ void BlepResampler::Reset()
     phase = 0.0f;
 }
 
+ResamplerType BlepResampler::GetType() const
+{
+    return ResamplerType::BLEP;
+}
+
 bool BlepResampler::Process(std::span<float> buffer, float phaseInc, const FetchCallback &fetchCallback)
 {
     if (buffer.size() == 0)
@@ -369,6 +388,11 @@ void BlampResampler::Reset()
     phase = 0.0f;
 }
 
+ResamplerType BlampResampler::GetType() const
+{
+    return ResamplerType::BLAMP;
+}
+
 bool BlampResampler::Process(std::span<float> buffer, float phaseInc, const FetchCallback &fetchCallback)
 {
     if (buffer.size() == 0)
@@ -18,6 +18,9 @@
  */
 typedef std::function<bool(std::vector<float> &fetchBuffer, size_t samplesRequired)> FetchCallback;
 
+class StateWriter;
+class StateReader;
+
 class Resampler
 {
 public:
@@ -26,8 +29,12 @@ public:
     // return value false by Process signals the "end of stream"
     virtual bool Process(std::span<float> buffer, float phaseInc, const FetchCallback &fetchCallback) = 0;
     virtual void Reset() = 0;
+    virtual ResamplerType GetType() const = 0;
     virtual ~Resampler();
 
+    void SaveState(StateWriter &w) const;
+    void LoadState(StateReader &r);
+
 protected:
     std::vector<float> fetchBuffer;
     float phase = 0.0f;
@@ -56,6 +63,7 @@ public:
     ~NearestResampler() override;
     bool Process(std::span<float> buffer, float phaseInc, const FetchCallback &fetchCallback) override;
     void Reset() override;
+    ResamplerType GetType() const override;
 };
 
 class LinearResampler : public Resampler
@@ -65,6 +73,7 @@ public:
     ~LinearResampler() override;
     bool Process(std::span<float> buffer, float phaseInc, const FetchCallback &fetchCallback) override;
     void Reset() override;
+    ResamplerType GetType() const override;
 };
 
 class SincResampler : public Resampler
@@ -74,6 +83,7 @@ public:
     virtual ~SincResampler() override;
     virtual bool Process(std::span<float> buffer, float phaseInc, const FetchCallback &fetchCallback) override;
     void Reset() override;
+    ResamplerType GetType() const override;
 
 private:
     static float fast_sinf(float t);
@@ -94,6 +104,7 @@ public:
     virtual ~BlepResampler() override;
     virtual bool Process(std::span<float> buffer, float phaseInc, const FetchCallback &fetchCallback) override;
     void Reset() override;
+    ResamplerType GetType() const override;
 
 protected:
     static inline float fast_Si(float t)
@@ -119,6 +130,7 @@ public:
     ~BlampResampler() override;
     bool Process(std::span<float> buffer, float phaseInc, const FetchCallback &fetchCallback) override;
     void Reset() override;
+    ResamplerType GetType() const override;
 
 protected:
     static float fast_Ti(float t)
@@ -1,11 +1,14 @@
 #include "ReverbEffect.hpp"
 
 #include "Constants.hpp"
+#include "ReverbEffectAVX2.hpp"
+#include "StateStream.hpp"
 #include "Util.hpp"
 #include "Xcept.hpp"
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 
 /*
  * public ReverbEffect
@@ -27,9 +30,8 @@ ReverbEffect::~ReverbEffect()
 void ReverbEffect::Process(std::span<sample> buffer)
 {
     while (buffer.size() > 0) {
-        // TODO change the semantics of ProcessInternal to return 'processed' instead of 'left' samples
-        const size_t left = ProcessInternal(buffer);
-        buffer = buffer.subspan(buffer.size() - left);
+        const size_t processed = ProcessInternal(buffer);
+        buffer = buffer.subspan(processed);
     }
 }
 
@@ -43,21 +45,62 @@ void ReverbEffect::Reset()
     std::fill(reverbBuffer.begin(), reverbBuffer.end(), sample{0.0f, 0.0f});
 }
 
+bool ReverbEffect::IsSilent(float threshold) const
+{
+    /* All feedback paths have a gain below 1, so the output can only decay
+     * once all delay lines are below the threshold. */
+    return IsBufferSilent(reverbBuffer, threshold);
+}
+
+void ReverbEffect::SaveState(StateWriter &w) const
+{
+    w.Write(intensity);
+    w.WriteVector(reverbBuffer);
+    w.Write(bufferPos);
+    w.Write(bufferPos2);
+}
+
+void ReverbEffect::LoadState(StateReader &r)
+{
+    r.Read(intensity);
+    r.ReadVector(reverbBuffer);
+    r.Read(bufferPos);
+    r.Read(bufferPos2);
+
+    if (bufferPos >= reverbBuffer.size() || bufferPos2 >= reverbBuffer.size())
+        throw Xcept("Cannot restore reverb state: buffer position out of range");
+}
+
 std::unique_ptr<ReverbEffect>
     ReverbEffect::MakeReverb(ReverbType reverbType, uint8_t intensity, size_t sampleRate, uint8_t numDmaBuffers)
 {
     switch (reverbType) {
     case ReverbType::NORMAL:
-        return std::make_unique<ReverbEffect>(intensity, sampleRate, numDmaBuffers);
+        if (AVX2_SUPPORTED)
+            return std::make_unique<ReverbEffectAVX2>(intensity, sampleRate, numDmaBuffers);
+        else
+            return std::make_unique<ReverbEffect>(intensity, sampleRate, numDmaBuffers);
     case ReverbType::NONE:
-        return std::make_unique<ReverbEffect>(0, sampleRate, numDmaBuffers);
+        if (AVX2_SUPPORTED)
+            return std::make_unique<ReverbEffectAVX2>(0, sampleRate, numDmaBuffers);
+        else
+            return std::make_unique<ReverbEffect>(0, sampleRate, numDmaBuffers);
     case ReverbType::GS1:
-        return std::make_unique<ReverbGS1>(intensity, sampleRate, numDmaBuffers);
+        if (AVX2_SUPPORTED)
+            return std::make_unique<ReverbGS1AVX2>(intensity, sampleRate, numDmaBuffers);
+        else
+            return std::make_unique<ReverbGS1>(intensity, sampleRate, numDmaBuffers);
     case ReverbType::GS2:
-        return std::make_unique<ReverbGS2>(intensity, sampleRate, numDmaBuffers, 0.4140625f, -0.0625f);
+        if (AVX2_SUPPORTED)
+            return std::make_unique<ReverbGS2AVX2>(intensity, sampleRate, numDmaBuffers, 0.4140625f, -0.0625f);
+        else
+            return std::make_unique<ReverbGS2>(intensity, sampleRate, numDmaBuffers, 0.4140625f, -0.0625f);
         // Mario Power Tennis uses same coefficients as Mario Golf Advance Tour
     case ReverbType::MGAT:
-        return std::make_unique<ReverbGS2>(intensity, sampleRate, numDmaBuffers, 0.25f, -0.046875f);
+        if (AVX2_SUPPORTED)
+            return std::make_unique<ReverbGS2AVX2>(intensity, sampleRate, numDmaBuffers, 0.25f, -0.046875f);
+        else
+            return std::make_unique<ReverbGS2>(intensity, sampleRate, numDmaBuffers, 0.25f, -0.046875f);
     case ReverbType::TEST:
         return std::make_unique<ReverbTest>(intensity, sampleRate, numDmaBuffers);
     default:
@@ -71,30 +114,32 @@ std::unique_ptr<ReverbEffect>
 
 size_t ReverbEffect::ProcessInternal(std::span<sample> buffer)
 {
-    std::vector<sample> &rbuf = reverbBuffer;
     const size_t count =
         std::min(std::min(reverbBuffer.size() - bufferPos2, reverbBuffer.size() - bufferPos), buffer.size());
-    bool reset = false, reset2 = false;
-    if (reverbBuffer.size() - bufferPos == count) {
-        reset = true;
-    }
-    if (reverbBuffer.size() - bufferPos2 == count) {
-        reset2 = true;
-    }
-    for (size_t i = 0; i < count; i++) {
+
+    ProcessSegment(
+        buffer.first(count),
+        std::span<sample>(reverbBuffer).subspan(bufferPos, count),
+        std::span<const sample>(reverbBuffer).subspan(bufferPos2, count)
+    );
+
+    bufferPos += count;
+    if (bufferPos == reverbBuffer.size())
+        bufferPos = 0;
+    bufferPos2 += count;
+    if (bufferPos2 == reverbBuffer.size())
+        bufferPos2 = 0;
+    return count;
+}
+
+void ReverbEffect::ProcessSegment(std::span<sample> buffer, std::span<sample> delay1, std::span<const sample> delay2)
+{
+    for (size_t i = 0; i < buffer.size(); i++) {
         const float rev =
-            (rbuf[bufferPos].left + rbuf[bufferPos].right + rbuf[bufferPos2].left + rbuf[bufferPos2].right) * intensity
-            * (1.0f / 4.0f);
-        rbuf[bufferPos].left = buffer[i].left += rev;
-        rbuf[bufferPos].right = buffer[i].right += rev;
-        bufferPos++;
-        bufferPos2++;
+            (delay1[i].left + delay1[i].right + delay2[i].left + delay2[i].right) * intensity * (1.0f / 4.0f);
+        delay1[i].left = buffer[i].left += rev;
+        delay1[i].right = buffer[i].right += rev;
     }
-    if (reset2)
-        bufferPos2 = 0;
-    if (reset)
-        bufferPos = 0;
-    return buffer.size() - count;
 }
 
 /*
@@ -117,42 +162,71 @@ void ReverbGS1::Reset()
     std::fill(gsBuffer.begin(), gsBuffer.end(), sample{0.0f, 0.0f});
 }
 
+bool ReverbGS1::IsSilent(float threshold) const
+{
+    return ReverbEffect::IsSilent(threshold) && IsBufferSilent(gsBuffer, threshold);
+}
+
+void ReverbGS1::SaveState(StateWriter &w) const
+{
+    w.Write(intensity);
+    w.WriteVector(reverbBuffer);
+    w.WriteVector(gsBuffer);
+    w.Write(bufferPos);
+    w.Write(bufferPos2);
+}
+
+void ReverbGS1::LoadState(StateReader &r)
+{
+    /* bufferPos2 indexes gsBuffer instead of the second reverbBuffer tap */
+    r.Read(intensity);
+    r.ReadVector(reverbBuffer);
+    r.ReadVector(gsBuffer);
+    r.Read(bufferPos);
+    r.Read(bufferPos2);
+
+    if (bufferPos >= reverbBuffer.size() || bufferPos2 >= gsBuffer.size())
+        throw Xcept("Cannot restore reverb state: buffer position out of range");
+}
+
 size_t ReverbGS1::ProcessInternal(std::span<sample> buffer)
 {
-    std::vector<sample> &rbuf = reverbBuffer;
-    size_t count = std::min(std::min(reverbBuffer.size() - bufferPos, gsBuffer.size() - bufferPos2), buffer.size());
-    bool reset = false, resetGS = false;
+    const size_t count =
+        std::min(std::min(reverbBuffer.size() - bufferPos, gsBuffer.size() - bufferPos2), buffer.size());
 
-    if (count == reverbBuffer.size() - bufferPos)
-        reset = true;
-    if (count == gsBuffer.size() - bufferPos2)
-        resetGS = true;
+    ProcessSegmentGS1(
+        buffer.first(count),
+        std::span<sample>(reverbBuffer).subspan(bufferPos, count),
+        std::span<sample>(gsBuffer).subspan(bufferPos2, count)
+    );
 
-    for (size_t i = 0; i < count; i++) {
-        const float mixL = buffer[i].left + gsBuffer[bufferPos2].left;
-        const float mixR = buffer[i].right + gsBuffer[bufferPos2].right;
+    bufferPos += count;
+    if (bufferPos == reverbBuffer.size())
+        bufferPos = 0;
+    bufferPos2 += count;
+    if (bufferPos2 == gsBuffer.size())
+        bufferPos2 = 0;
+    return count;
+}
 
-        const float lA = rbuf[bufferPos].left;
-        const float rA = rbuf[bufferPos].right;
+void ReverbGS1::ProcessSegmentGS1(std::span<sample> buffer, std::span<sample> delay, std::span<sample> gs)
+{
+    for (size_t i = 0; i < buffer.size(); i++) {
+        const float mixL = buffer[i].left + gs[i].left;
+        const float mixR = buffer[i].right + gs[i].right;
+
+        const float lA = delay[i].left;
+        const float rA = delay[i].right;
 
-        buffer[i].left = rbuf[bufferPos].left = mixL;
-        buffer[i].right = rbuf[bufferPos].right = mixR;
+        buffer[i].left = delay[i].left = mixL;
+        buffer[i].right = delay[i].right = mixR;
 
         const float lRMix = 0.25f * mixL + 0.25f * rA;
         const float rRMix = 0.25f * mixR + 0.25f * lA;
 
-        gsBuffer[bufferPos2].left = lRMix;
-        gsBuffer[bufferPos2].right = rRMix;
-
-        bufferPos++;
-        bufferPos2++;
+        gs[i].left = lRMix;
+        gs[i].right = rRMix;
     }
-
-    if (resetGS)
-        bufferPos2 = 0;
-    if (reset)
-        bufferPos = 0;
-    return buffer.size() - count;
 }
 
 /*
@@ -180,55 +254,79 @@ void ReverbGS2::Reset()
     std::fill(gs2Buffer.begin(), gs2Buffer.end(), sample{0.0f, 0.0f});
 }
 
+bool ReverbGS2::IsSilent(float threshold) const
+{
+    return ReverbEffect::IsSilent(threshold) && IsBufferSilent(gs2Buffer, threshold);
+}
+
+void ReverbGS2::SaveState(StateWriter &w) const
+{
+    ReverbEffect::SaveState(w);
+    w.WriteVector(gs2Buffer);
+    w.Write(gs2Pos);
+}
+
+void ReverbGS2::LoadState(StateReader &r)
+{
+    ReverbEffect::LoadState(r);
+    r.ReadVector(gs2Buffer);
+    r.Read(gs2Pos);
+
+    if (gs2Pos >= gs2Buffer.size() / 2)
+        throw Xcept("Cannot restore reverb state: buffer position out of range");
+}
+
 size_t ReverbGS2::ProcessInternal(std::span<sample> buffer)
 {
-    std::vector<sample> &rbuf = reverbBuffer;
-    size_t count = std::min(
+    /* Only the first half of gs2Buffer is used as ring buffer. */
+    const size_t gs2Len = gs2Buffer.size() / 2;
+    const size_t count = std::min(
         std::min(reverbBuffer.size() - bufferPos2, reverbBuffer.size() - bufferPos),
-        std::min(buffer.size(), gs2Buffer.size() - gs2Pos)
+        std::min(buffer.size(), gs2Len - gs2Pos)
     );
-    bool reset = false, reset2 = false, resetgs2 = false;
 
-    if (reverbBuffer.size() - bufferPos2 == count) {
-        reset2 = true;
-    }
-    if (reverbBuffer.size() - bufferPos == count) {
-        reset = true;
-    }
-    if ((gs2Buffer.size() / 2) - gs2Pos == count) {
-        resetgs2 = true;
-    }
+    ProcessSegmentGS2(
+        buffer.first(count),
+        std::span<sample>(reverbBuffer).subspan(bufferPos, count),
+        std::span<const sample>(reverbBuffer).subspan(bufferPos2, count),
+        std::span<sample>(gs2Buffer).subspan(gs2Pos, count)
+    );
 
-    for (size_t i = 0; i < count; i++) {
-        const float mixL = buffer[i].left + gs2Buffer[gs2Pos].left;
-        const float mixR = buffer[i].right + gs2Buffer[gs2Pos].right;
+    bufferPos += count;
+    if (bufferPos == reverbBuffer.size())
+        bufferPos = 0;
+    bufferPos2 += count;
+    if (bufferPos2 == reverbBuffer.size())
+        bufferPos2 = 0;
+    gs2Pos += count;
+    if (gs2Pos == gs2Len)
+        gs2Pos = 0;
+    return count;
+}
 
-        const float lA = rbuf[bufferPos].left;
-        const float rA = rbuf[bufferPos].right;
+void ReverbGS2::ProcessSegmentGS2(
+    std::span<sample> buffer, std::span<sample> delay1, std::span<const sample> delay2, std::span<sample> gs2
+)
+{
+    for (size_t i = 0; i < buffer.size(); i++) {
+        const float mixL = buffer[i].left + gs2[i].left;
+        const float mixR = buffer[i].right + gs2[i].right;
+
+        const float lA = delay1[i].left;
+        const float rA = delay1[i].right;
 
-        buffer[i].left = rbuf[bufferPos].left = mixL;
-        buffer[i].right = rbuf[bufferPos].right = mixR;
+        buffer[i].left = delay1[i].left = mixL;
+        buffer[i].right = delay1[i].right = mixR;
 
         const float lRMix = lA * rPrimFac + rA * rSecFac;
         const float rRMix = rA * rPrimFac + lA * rSecFac;
 
-        const float lB = rbuf[bufferPos2].right * 0.25f;
+        const float lB = delay2[i].right * 0.25f;
         const float rB = mixR * 0.25f;
 
-        gs2Buffer[gs2Pos].left = lRMix + lB;
-        gs2Buffer[gs2Pos].right = rRMix + rB;
-
-        bufferPos++;
-        bufferPos2++;
-        gs2Pos++;
+        gs2[i].left = lRMix + lB;
+        gs2[i].right = rRMix + rB;
     }
-    if (reset2)
-        bufferPos2 = 0;
-    if (reset)
-        bufferPos = 0;
-    if (resetgs2)
-        gs2Pos = 0;
-    return buffer.size() - count;
 }
 
 /*
@@ -247,7 +345,8 @@ ReverbTest::~ReverbTest()
 size_t ReverbTest::ProcessInternal(std::span<sample> buffer)
 {
     std::vector<sample> &rbuf = reverbBuffer;
-    size_t count = std::min(std::min(reverbBuffer.size() - bufferPos, reverbBuffer.size() - bufferPos2), buffer.size());
+    const size_t count =
+        std::min(std::min(reverbBuffer.size() - bufferPos, reverbBuffer.size() - bufferPos2), buffer.size());
     bool reset = false, reset2 = false;
     if (reverbBuffer.size() - bufferPos2 == count) {
         reset2 = true;
@@ -307,5 +406,5 @@ size_t ReverbTest::ProcessInternal(std::span<sample> buffer)
         bufferPos2 = 0;
     if (reset)
         bufferPos = 0;
-    return buffer.size() - count;
+    return count;
 }
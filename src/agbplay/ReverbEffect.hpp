@@ -8,6 +8,9 @@
 #include <span>
 #include <vector>
 
+class StateWriter;
+class StateReader;
+
 // TODO rename to Reverb
 
 class ReverbEffect
@@ -18,12 +21,19 @@ public:
     void Process(std::span<sample> buffer);
     void SetLevel(uint8_t level);
     virtual void Reset();
+    virtual bool IsSilent(float threshold) const;
+    virtual void SaveState(StateWriter &w) const;
+    virtual void LoadState(StateReader &r);
 
     static std::unique_ptr<ReverbEffect>
         MakeReverb(ReverbType reverbType, uint8_t intensity, size_t sampleRate, uint8_t numDmaBuffers);
 
 protected:
+    /* ProcessInternal processes the buffer up to the next wrap around of any of the ring buffers
+     * and returns the number of processed samples. The wrap-free part is then passed to
+     * ProcessSegment, which only operates on contiguous memory. */
     virtual size_t ProcessInternal(std::span<sample> buffer);
+    virtual void ProcessSegment(std::span<sample> buffer, std::span<sample> delay1, std::span<const sample> delay2);
     float intensity;
     // size_t streamRate;
     std::vector<sample> reverbBuffer;
@@ -37,9 +47,13 @@ public:
     ReverbGS1(uint8_t intensity, size_t streamRate, uint8_t numAgbBuffers);
     ~ReverbGS1() override;
     void Reset() override;
+    bool IsSilent(float threshold) const override;
+    void SaveState(StateWriter &w) const override;
+    void LoadState(StateReader &r) override;
 
 protected:
     size_t ProcessInternal(std::span<sample> buffer) override;
+    virtual void ProcessSegmentGS1(std::span<sample> buffer, std::span<sample> delay, std::span<sample> gs);
     std::vector<sample> gsBuffer;
 };
 
@@ -49,9 +63,15 @@ public:
     ReverbGS2(uint8_t intesity, size_t streamRate, uint8_t numAgbBuffers, float rPrimFac, float rSecFac);
     ~ReverbGS2() override;
     void Reset() override;
+    bool IsSilent(float threshold) const override;
+    void SaveState(StateWriter &w) const override;
+    void LoadState(StateReader &r) override;
 
 protected:
     size_t ProcessInternal(std::span<sample> buffer) override;
+    virtual void ProcessSegmentGS2(
+        std::span<sample> buffer, std::span<sample> delay1, std::span<const sample> delay2, std::span<sample> gs2
+    );
     std::vector<sample> gs2Buffer;
     size_t gs2Pos;
     float rPrimFac, rSecFac;
@@ -0,0 +1,105 @@
+#include "ReverbEffectAVX2.hpp"
+
+/* All functions below process 4 stereo samples per iteration. The order of floating point operations
+ * is identical to the scalar implementations so the results are bit-exact.
+ * Reading a delay tap, which is also written by the same segment, is only safe because the distance
+ * between the taps is always far larger than the vector width. */
+
+static inline __m256 avx2_swap_lr(__m256 x)
+{
+    return _mm256_permute_ps(x, 0b10110001);
+}
+
+/*
+ * ReverbEffectAVX2
+ */
+
+ReverbEffectAVX2::~ReverbEffectAVX2()
+{
+}
+
+void ReverbEffectAVX2::ProcessSegment(
+    std::span<sample> buffer, std::span<sample> delay1, std::span<const sample> delay2
+)
+{
+    const __m256 intensityV = _mm256_set1_ps(intensity);
+    const __m256 quarterV = _mm256_set1_ps(1.0f / 4.0f);
+
+    size_t i = 0;
+    for (; i + 4 <= buffer.size(); i += 4) {
+        const __m256 d1V = _mm256_loadu_ps(&delay1[i].left);
+        const __m256 d2V = _mm256_loadu_ps(&delay2[i].left);
+        /* ((d1.l + d1.r) + d2.l) + d2.r in both channels */
+        __m256 revV = _mm256_add_ps(d1V, avx2_swap_lr(d1V));
+        revV = _mm256_add_ps(revV, _mm256_moveldup_ps(d2V));
+        revV = _mm256_add_ps(revV, _mm256_movehdup_ps(d2V));
+        revV = _mm256_mul_ps(_mm256_mul_ps(revV, intensityV), quarterV);
+
+        const __m256 outV = _mm256_add_ps(_mm256_loadu_ps(&buffer[i].left), revV);
+        _mm256_storeu_ps(&buffer[i].left, outV);
+        _mm256_storeu_ps(&delay1[i].left, outV);
+    }
+
+    ReverbEffect::ProcessSegment(buffer.subspan(i), delay1.subspan(i), delay2.subspan(i));
+}
+
+/*
+ * ReverbGS1AVX2
+ */
+
+ReverbGS1AVX2::~ReverbGS1AVX2()
+{
+}
+
+void ReverbGS1AVX2::ProcessSegmentGS1(std::span<sample> buffer, std::span<sample> delay, std::span<sample> gs)
+{
+    const __m256 quarterV = _mm256_set1_ps(0.25f);
+
+    size_t i = 0;
+    for (; i + 4 <= buffer.size(); i += 4) {
+        const __m256 mixV = _mm256_add_ps(_mm256_loadu_ps(&buffer[i].left), _mm256_loadu_ps(&gs[i].left));
+        const __m256 aV = _mm256_loadu_ps(&delay[i].left);
+
+        _mm256_storeu_ps(&buffer[i].left, mixV);
+        _mm256_storeu_ps(&delay[i].left, mixV);
+
+        const __m256 rMixV = _mm256_add_ps(_mm256_mul_ps(quarterV, mixV), _mm256_mul_ps(quarterV, avx2_swap_lr(aV)));
+        _mm256_storeu_ps(&gs[i].left, rMixV);
+    }
+
+    ReverbGS1::ProcessSegmentGS1(buffer.subspan(i), delay.subspan(i), gs.subspan(i));
+}
+
+/*
+ * ReverbGS2AVX2
+ */
+
+ReverbGS2AVX2::~ReverbGS2AVX2()
+{
+}
+
+void ReverbGS2AVX2::ProcessSegmentGS2(
+    std::span<sample> buffer, std::span<sample> delay1, std::span<const sample> delay2, std::span<sample> gs2
+)
+{
+    const __m256 primV = _mm256_set1_ps(rPrimFac);
+    const __m256 secV = _mm256_set1_ps(rSecFac);
+    const __m256 quarterV = _mm256_set1_ps(0.25f);
+
+    size_t i = 0;
+    for (; i + 4 <= buffer.size(); i += 4) {
+        const __m256 mixV = _mm256_add_ps(_mm256_loadu_ps(&buffer[i].left), _mm256_loadu_ps(&gs2[i].left));
+        const __m256 aV = _mm256_loadu_ps(&delay1[i].left);
+
+        _mm256_storeu_ps(&buffer[i].left, mixV);
+        _mm256_storeu_ps(&delay1[i].left, mixV);
+
+        const __m256 rMixV = _mm256_add_ps(_mm256_mul_ps(aV, primV), _mm256_mul_ps(avx2_swap_lr(aV), secV));
+        /* left channel takes the right channel of the second tap, right channel takes the right mix channel */
+        const __m256 d2RightV = _mm256_movehdup_ps(_mm256_loadu_ps(&delay2[i].left));
+        const __m256 bV = _mm256_mul_ps(_mm256_blend_ps(d2RightV, mixV, 0b10101010), quarterV);
+        _mm256_storeu_ps(&gs2[i].left, _mm256_add_ps(rMixV, bV));
+    }
+
+    ReverbGS2::ProcessSegmentGS2(buffer.subspan(i), delay1.subspan(i), delay2.subspan(i), gs2.subspan(i));
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "ReverbEffect.hpp"
+
+#if __has_include(<immintrin.h>)
+
+#include <immintrin.h>
+
+class ReverbEffectAVX2 : public ReverbEffect
+{
+public:
+    using ReverbEffect::ReverbEffect;
+    ~ReverbEffectAVX2() override;
+
+protected:
+    void ProcessSegment(std::span<sample> buffer, std::span<sample> delay1, std::span<const sample> delay2) override;
+};
+
+class ReverbGS1AVX2 : public ReverbGS1
+{
+public:
+    using ReverbGS1::ReverbGS1;
+    ~ReverbGS1AVX2() override;
+
+protected:
+    void ProcessSegmentGS1(std::span<sample> buffer, std::span<sample> delay, std::span<sample> gs) override;
+};
+
+class ReverbGS2AVX2 : public ReverbGS2
+{
+public:
+    using ReverbGS2::ReverbGS2;
+    ~ReverbGS2AVX2() override;
+
+protected:
+    void ProcessSegmentGS2(
+        std::span<sample> buffer, std::span<sample> delay1, std::span<const sample> delay2, std::span<sample> gs2
+    ) override;
+};
+
+#else    // if AVX2 intrinsics header not available
+
+#include <stdexcept>
+
+class ReverbEffectAVX2 : public ReverbEffect
+{
+public:
+    template<typename... Args> ReverbEffectAVX2(Args &&...) : ReverbEffect(0, 0, 0)
+    {
+        throw std::logic_error("Attempting to instantiate ReverbEffectAVX2 on platform without AVX2");
+    }
+};
+
+class ReverbGS1AVX2 : public ReverbGS1
+{
+public:
+    template<typename... Args> ReverbGS1AVX2(Args &&...) : ReverbGS1(0, 0, 0)
+    {
+        throw std::logic_error("Attempting to instantiate ReverbGS1AVX2 on platform without AVX2");
+    }
+};
+
+class ReverbGS2AVX2 : public ReverbGS2
+{
+public:
+    template<typename... Args> ReverbGS2AVX2(Args &&...) : ReverbGS2(0, 0, 0, 0.0f, 0.0f)
+    {
+        throw std::logic_error("Attempting to instantiate ReverbGS2AVX2 on platform without AVX2");
+    }
+};
+
+#endif
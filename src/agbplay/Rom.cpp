@@ -3,6 +3,7 @@
 #include "Debug.hpp"
 #include "FileReader.hpp"
 #include "Gsf.hpp"
+#include "MappedFile.hpp"
 #include "Util.hpp"
 #include "Xcept.hpp"
 
@@ -25,7 +26,8 @@ Rom Rom::LoadFromFile(const std::filesystem::path &filePath)
 {
     Rom rom;
     rom.LoadFile(filePath);
-    rom.romData = rom.romContainer;
+    if (!rom.romMapping)
+        rom.romData = rom.romContainer;
     rom.Verify();
     return rom;
 }
@@ -122,11 +124,21 @@ void Rom::Verify()
         throw Xcept("ROM verification: Bad Header Checksum: {:02X} - expected {:02X}", checksum, check);
 }
 
+void Rom::CheckRawSize(size_t size)
+{
+    if (size <= 0x200)
+        throw Xcept("ERROR: Attempting to load tiny ROM (<= 512 bytes). Incorrect or damaged file?");
+    if (size > AGB_ROM_SIZE)
+        throw Xcept("ERROR: Attempting to illegally large ROM (> 32 MiB). Incorrect or damaged file?");
+}
+
 void Rom::LoadFile(const std::filesystem::path &filePath)
 {
     /* Try load load as zip file */
     if (LoadZip(filePath))
         return;
+    if (LoadMapped(filePath))
+        return;
     if (LoadGsflib(filePath))
         return;
     if (LoadRaw(filePath))
@@ -190,6 +202,33 @@ bool Rom::LoadGsflib(FileReader &fileReader)
     return Gsf::GetRomData(gsfData, romContainer);
 }
 
+bool Rom::LoadMapped(const std::filesystem::path &filePath)
+{
+    /* GSF libraries have to be decompressed, so only raw ROMs are mapped. Check the header first to not map a
+     * GSF library just to find that out. */
+    std::array<uint8_t, 4> header{};
+    const bool isGsfFile = FileReader::forRaw(filePath, [&header](FileReader &fileReader) {
+        if (fileReader.size() < header.size())
+            return false;
+        fileReader.read(header);
+        return Gsf::IsGsf(header);
+    });
+    if (isGsfFile)
+        return false;
+
+    /* Mapping the file avoids reading the entire ROM up front and allows multiple processes
+     * to share the ROM data. Fall back to reading the file if it cannot be mapped. */
+    std::shared_ptr<const MappedFile> mapping = MappedFile::Map(filePath);
+    if (!mapping)
+        return false;
+
+    CheckRawSize(mapping->Data().size());
+    romData = mapping->Data();
+    romMapping = std::move(mapping);
+    isGsf = false;
+    return true;
+}
+
 bool Rom::LoadRaw(const std::filesystem::path &filePath)
 {
     return FileReader::forRaw(filePath, [this](FileReader &fileReader) { return LoadRaw(fileReader); });
@@ -199,10 +238,7 @@ bool Rom::LoadRaw(FileReader &fileReader)
 {
     /* get file size */
     const size_t size = fileReader.size();
-    if (size <= 0x200)
-        throw Xcept("ERROR: Attempting to load tiny ROM (<= 512 bytes). Incorrect or damaged file?");
-    if (size > AGB_ROM_SIZE)
-        throw Xcept("ERROR: Attempting to illegally large ROM (> 32 MiB). Incorrect or damaged file?");
+    CheckRawSize(size);
 
     /* read exactly as much data as the file contains */
     romContainer.resize(size);
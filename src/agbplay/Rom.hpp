@@ -3,7 +3,10 @@
 #include "AgbTypes.hpp"
 #include "Xcept.hpp"
 
+#include <bit>
+#include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <memory>
 #include <span>
@@ -11,6 +14,73 @@
 #include <vector>
 
 class FileReader;
+class MappedFile;
+
+/* RomView is a range of the ROM, which is bounds checked once when the view is created (see Rom::View).
+ * Reads within the range are not checked again, so hot loops can use it after validating the
+ * range they are going to access up front. Positions are ROM positions, not relative to the view. */
+class RomView
+{
+public:
+    uint8_t ReadU8(size_t pos) const
+    {
+        assert(Contains(pos, 1));
+        return romData[pos];
+    }
+
+    uint16_t ReadU16(size_t pos) const { return ReadLE<uint16_t>(pos); }
+    uint32_t ReadU32(size_t pos) const { return ReadLE<uint32_t>(pos); }
+
+    std::span<const uint8_t> Bytes(size_t pos, size_t len) const
+    {
+        assert(Contains(pos, len));
+        return {romData + pos, len};
+    }
+
+    size_t ReadAgbPtrToPos(size_t pos) const
+    {
+        uint32_t ptr = ReadU32(pos);
+        if (!ValidPointer(ptr))
+            throw Xcept("Cannot parse pointer at [{:08X}]={:08X}", pos, ptr);
+        return ptr - AGB_MAP_ROM;
+    }
+
+    bool ValidPointer(uint32_t ptr) const
+    {
+        if (ptr - AGB_MAP_ROM >= romSize)
+            return false;
+        if (ptr - AGB_MAP_ROM + 1 >= romSize)
+            return false;
+        return true;
+    }
+
+    bool Contains(size_t pos, size_t len) const { return pos >= viewStart && pos <= viewEnd && len <= viewEnd - pos; }
+    size_t Begin() const { return viewStart; }
+    size_t End() const { return viewEnd; }
+
+private:
+    friend class Rom;
+
+    RomView(const uint8_t *romData, size_t romSize, size_t viewStart, size_t viewEnd) :
+        romData(romData), romSize(romSize), viewStart(viewStart), viewEnd(viewEnd)
+    {
+    }
+
+    template<typename T> T ReadLE(size_t pos) const
+    {
+        assert(Contains(pos, sizeof(T)));
+        T value;
+        std::memcpy(&value, romData + pos, sizeof(T));
+        if constexpr (std::endian::native == std::endian::big)
+            value = std::byteswap(value);
+        return value;
+    }
+
+    const uint8_t *romData;
+    size_t romSize;
+    size_t viewStart;
+    size_t viewEnd;
+};
 
 class Rom
 {
@@ -43,27 +113,12 @@ public:
 
     int16_t ReadS16(size_t pos) const { return static_cast<int16_t>(ReadU16(pos)); }
 
-    uint16_t ReadU16(size_t pos) const
-    {
-        uint32_t retval = ReadU8(pos + 1);
-        retval <<= 8;
-        retval |= romData[pos];
-        return static_cast<uint16_t>(retval);
-    }
+    /* Bounds checked through a view, which then reads the value with a single unaligned load. */
+    uint16_t ReadU16(size_t pos) const { return View(pos, sizeof(uint16_t)).ReadLE<uint16_t>(pos); }
 
     int32_t ReadS32(size_t pos) const { return static_cast<int32_t>(ReadU32(pos)); }
 
-    uint32_t ReadU32(size_t pos) const
-    {
-        uint32_t retval = ReadU8(pos + 3);
-        retval <<= 8;
-        retval |= romData[pos + 2];
-        retval <<= 8;
-        retval |= romData[pos + 1];
-        retval <<= 8;
-        retval |= romData[pos + 0];
-        return retval;
-    }
+    uint32_t ReadU32(size_t pos) const { return View(pos, sizeof(uint32_t)).ReadLE<uint32_t>(pos); }
 
     size_t ReadAgbPtrToPos(size_t pos) const
     {
@@ -75,6 +130,16 @@ public:
 
     const void *GetPtr(size_t pos) const { return &romData[pos]; }
 
+    /* Throws if the range is not within the ROM. */
+    RomView View(size_t pos, size_t len) const
+    {
+        if (len > romData.size() || pos > romData.size() - len) [[unlikely]]
+            throw Xcept("ERROR: Cannot read beyond end of ROM (size={:#x}): {:#x}+{:#x}", romData.size(), pos, len);
+        return RomView(romData.data(), romData.size(), pos, pos + len);
+    }
+
+    RomView View() const { return View(0, romData.size()); }
+
     size_t Size() const { return romData.size(); }
 
     bool ValidPointer(uint32_t ptr) const
@@ -104,11 +169,14 @@ private:
     bool LoadZip(const std::filesystem::path &filePath);
     bool LoadGsflib(const std::filesystem::path &filePath);
     bool LoadGsflib(FileReader &fileReader);
+    bool LoadMapped(const std::filesystem::path &filePath);
     bool LoadRaw(const std::filesystem::path &filePath);
     bool LoadRaw(FileReader &fileReader);
+    static void CheckRawSize(size_t size);
 
-    std::span<uint8_t> romData;
+    std::span<const uint8_t> romData;
     std::vector<uint8_t> romContainer;
+    std::shared_ptr<const MappedFile> romMapping;    // only used for raw ROMs loaded from file
     std::filesystem::path gsfPath;
 
     bool isGsf = false;
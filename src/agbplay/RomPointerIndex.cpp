@@ -0,0 +1,100 @@
+#include "RomPointerIndex.hpp"
+
+#include "Constants.hpp"
+#include "Rom.hpp"
+#include "Util.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+/*
+ * public RomPointerIndex
+ */
+
+RomPointerIndex::RomPointerIndex(const Rom &rom, size_t startPos)
+{
+    /* Collect (target, position) pairs as a single key, so sorting keeps the positions of a target in order.
+     * Each chunk is sorted by its own thread and the sorted chunks are merged afterwards. Because the
+     * keys are unique, the result does not depend on the number of threads. */
+    startPos = (startPos + 3) & ~size_t{3};
+    const size_t endPos = startPos < rom.Size() ? startPos + ((rom.Size() - startPos) & ~size_t{3}) : startPos;
+    const size_t numChunks = (endPos - startPos + SCAN_CHUNK_SIZE - 1) / SCAN_CHUNK_SIZE;
+    std::vector<std::vector<uint64_t>> chunkPointers(numChunks);
+
+    const RomView romView = rom.View();
+    ParallelForChunks(startPos, endPos, SCAN_CHUNK_SIZE, [&](size_t chunkBegin, size_t chunkEnd) {
+        std::vector<uint64_t> &pointers = chunkPointers.at((chunkBegin - startPos) / SCAN_CHUNK_SIZE);
+        const std::span<const uint8_t> data = romView.Bytes(chunkBegin, chunkEnd - chunkBegin);
+        if (AVX2_SUPPORTED)
+            CollectPointersAVX2(data, chunkBegin, rom.Size(), pointers);
+        else
+            CollectPointers(data, chunkBegin, rom.Size(), pointers);
+        std::sort(pointers.begin(), pointers.end());
+    });
+
+    /* merge adjacent chunks until only one is left */
+    while (chunkPointers.size() > 1) {
+        std::vector<std::vector<uint64_t>> mergedPointers;
+        for (size_t i = 0; i + 1 < chunkPointers.size(); i += 2) {
+            std::vector<uint64_t> &merged = mergedPointers.emplace_back();
+            merged.resize(chunkPointers[i].size() + chunkPointers[i + 1].size());
+            std::merge(
+                chunkPointers[i].begin(), chunkPointers[i].end(),
+                chunkPointers[i + 1].begin(), chunkPointers[i + 1].end(),
+                merged.begin()
+            );
+        }
+        if (chunkPointers.size() % 2 != 0)
+            mergedPointers.emplace_back(std::move(chunkPointers.back()));
+        chunkPointers = std::move(mergedPointers);
+    }
+
+    if (chunkPointers.empty()) {
+        firstReference.push_back(0);
+        return;
+    }
+
+    const std::vector<uint64_t> &pointers = chunkPointers.front();
+    referencePos.reserve(pointers.size());
+    for (const uint64_t pointer : pointers) {
+        const uint32_t target = static_cast<uint32_t>(pointer >> 32);
+        if (targets.empty() || targets.back() != target) {
+            targets.push_back(target);
+            firstReference.push_back(static_cast<uint32_t>(referencePos.size()));
+        }
+        referencePos.push_back(static_cast<uint32_t>(pointer));
+    }
+    firstReference.push_back(static_cast<uint32_t>(referencePos.size()));
+}
+
+std::span<const uint32_t> RomPointerIndex::GetReferences(size_t pos) const
+{
+    const auto it = std::lower_bound(targets.begin(), targets.end(), pos);
+    if (it == targets.end() || *it != pos)
+        return {};
+
+    const size_t i = static_cast<size_t>(it - targets.begin());
+    const size_t count = firstReference[i + 1] - firstReference[i];
+    return std::span<const uint32_t>(referencePos).subspan(firstReference[i], count);
+}
+
+/*
+ * private RomPointerIndex
+ */
+
+void RomPointerIndex::CollectPointers(
+    std::span<const uint8_t> data, size_t dataPos, size_t romSize, std::vector<uint64_t> &pointers
+)
+{
+    for (size_t i = 0; i + 3 < data.size(); i += 4) {
+        uint32_t ptr;
+        std::memcpy(&ptr, &data[i], sizeof(ptr));
+        if constexpr (std::endian::native == std::endian::big)
+            ptr = std::byteswap(ptr);
+
+        /* same condition as RomView::ValidPointer */
+        const uint32_t target = ptr - AGB_MAP_ROM;
+        if (target < romSize && target + 1 < romSize)
+            pointers.push_back(MakeKey(target, dataPos + i));
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+class Rom;
+
+/* The RomPointerIndex maps ROM positions to all word aligned ROM locations, which contain a pointer to them.
+ * It is built once per ROM with a single pass and can be shared by all scans of that ROM.
+ * The ROM is split into chunks, which are scanned in parallel. */
+class RomPointerIndex
+{
+public:
+    /* Only words at or after startPos are indexed. */
+    RomPointerIndex(const Rom &rom, size_t startPos);
+    RomPointerIndex(const RomPointerIndex &) = delete;
+    RomPointerIndex &operator=(const RomPointerIndex &) = delete;
+
+    /* Returns the positions of all pointers to pos in ascending order. */
+    std::span<const uint32_t> GetReferences(size_t pos) const;
+
+private:
+    /* Appends the keys of all valid pointers in data (located at ROM position dataPos) to pointers. */
+    static void CollectPointers(
+        std::span<const uint8_t> data, size_t dataPos, size_t romSize, std::vector<uint64_t> &pointers
+    );
+    static void CollectPointersAVX2(
+        std::span<const uint8_t> data, size_t dataPos, size_t romSize, std::vector<uint64_t> &pointers
+    );
+
+    static uint64_t MakeKey(uint32_t target, size_t pos) { return (static_cast<uint64_t>(target) << 32) | pos; }
+
+    /* targets is sorted, references of targets[i] are referencePos[firstReference[i]..firstReference[i + 1]] */
+    std::vector<uint32_t> targets;
+    std::vector<uint32_t> firstReference;
+    std::vector<uint32_t> referencePos;
+};
@@ -0,0 +1,49 @@
+#include "RomPointerIndex.hpp"
+
+#include "AgbTypes.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+#if __has_include(<immintrin.h>)
+
+#include <immintrin.h>
+
+void RomPointerIndex::CollectPointersAVX2(
+    std::span<const uint8_t> data, size_t dataPos, size_t romSize, std::vector<uint64_t> &pointers
+)
+{
+    /* ROMs are at most 32 MiB, so valid ROM pointers always have 0x08 or 0x09 in the upper byte. Only check
+     * these words individually, which filters almost all of the data 8 words at a time. */
+    const __m256i upperMask = _mm256_set1_epi32(static_cast<int>(0xFE000000u));
+    const __m256i upperRom = _mm256_set1_epi32(static_cast<int>(AGB_MAP_ROM));
+
+    size_t i = 0;
+    for (; i + 32 <= data.size(); i += 32) {
+        const __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&data[i]));
+        const __m256i isRom = _mm256_cmpeq_epi32(_mm256_and_si256(words, upperMask), upperRom);
+        unsigned int mask = static_cast<unsigned int>(_mm256_movemask_ps(_mm256_castsi256_ps(isRom)));
+
+        while (mask != 0) {
+            const size_t word = static_cast<size_t>(__builtin_ctz(mask));
+            mask &= mask - 1;
+
+            uint32_t ptr;
+            std::memcpy(&ptr, &data[i + word * 4], sizeof(ptr));
+            const uint32_t target = ptr - AGB_MAP_ROM;
+            if (target < romSize && target + 1 < romSize)
+                pointers.push_back(MakeKey(target, dataPos + i + word * 4));
+        }
+    }
+
+    CollectPointers(data.subspan(i), dataPos + i, romSize, pointers);
+}
+
+#else
+
+void RomPointerIndex::CollectPointersAVX2(std::span<const uint8_t>, size_t, size_t, std::vector<uint64_t> &)
+{
+    throw std::logic_error("Attempting to use RomPointerIndex::CollectPointersAVX2 on platform without AVX2");
+}
+
+#endif
@@ -0,0 +1,202 @@
+#include "ScanCache.hpp"
+
+#include "Constants.hpp"
+#include "Debug.hpp"
+#include "OS.hpp"
+#include "Profile.hpp"
+#include "Rom.hpp"
+#include "StateStream.hpp"
+#include "Xcept.hpp"
+
+#include <array>
+#include <fmt/core.h>
+#include <fstream>
+#include <iterator>
+#include <zlib.h>
+
+static const std::array<char, 8> SCAN_CACHE_MAGIC = {'A', 'G', 'B', 'P', 'S', 'C', 'A', 'N'};
+
+/* ROM header (title, game code, maker code, ...), which is compared as a cheap sanity check of the hash */
+static const size_t HEADER_POS = 0xA0;
+static const size_t HEADER_SIZE = 0x20;
+
+static void WriteResult(StateWriter &w, const MP2KScanner::Result &result)
+{
+    w.Write(result.mp2kSoundMode);
+    w.WriteVector(result.playerTableInfo);
+    w.Write<uint64_t>(result.songTableInfo.pos);
+    w.Write(result.songTableInfo.count);
+    w.Write(result.songTableInfo.tableIdx);
+}
+
+static void ReadResult(StateReader &r, MP2KScanner::Result &result)
+{
+    r.Read(result.mp2kSoundMode);
+    r.ReadVector(result.playerTableInfo);
+    result.songTableInfo.pos = static_cast<size_t>(r.Read<uint64_t>());
+    r.Read(result.songTableInfo.count);
+    r.Read(result.songTableInfo.tableIdx);
+}
+
+/*
+ * public ScanCache
+ */
+
+ScanCache::ScanCache(const Rom &rom) : rom(rom)
+{
+    const std::span<const uint8_t> romData = rom.View().Bytes(0, rom.Size());
+    const uint32_t crc = static_cast<uint32_t>(crc32_z(crc32_z(0, nullptr, 0), romData.data(), romData.size()));
+    const uint32_t adler = static_cast<uint32_t>(adler32_z(adler32_z(0, nullptr, 0), romData.data(), romData.size()));
+    /* The scanner accepts different song tables for GSFs, so the same data has different results */
+    cachePath = OS::GetLocalConfigDirectory() / "agbplay" / "scan-cache"
+        / fmt::format("{:08x}{:08x}-{:x}{}.bin", crc, adler, romData.size(), rom.IsGsf() ? "-gsf" : "");
+
+    Load();
+}
+
+bool ScanCache::GetProfileScan(Profile &profile) const
+{
+    const auto it = entries.find(ProfileKey(profile));
+    if (it == entries.end() || it->second.size() != 1)
+        return false;
+
+    const MP2KScanner::Result &result = it->second.front();
+    profile.songTableInfoScanned = result.songTableInfo;
+    profile.playerTableScanned = result.playerTableInfo;
+    profile.mp2kSoundModeScanned = result.mp2kSoundMode;
+    return true;
+}
+
+void ScanCache::PutProfileScan(const Profile &profile)
+{
+    const MP2KScanner::Result result{
+        .mp2kSoundMode = profile.mp2kSoundModeScanned,
+        .playerTableInfo = profile.playerTableScanned,
+        .songTableInfo = profile.songTableInfoScanned,
+    };
+    entries[ProfileKey(profile)] = {result};
+    dirty = true;
+}
+
+bool ScanCache::GetScan(std::vector<MP2KScanner::Result> &results) const
+{
+    if (!scanResults)
+        return false;
+
+    results = *scanResults;
+    return true;
+}
+
+void ScanCache::PutScan(const std::vector<MP2KScanner::Result> &results)
+{
+    scanResults = results;
+    dirty = true;
+}
+
+void ScanCache::Save()
+{
+    if (!dirty)
+        return;
+
+    StateWriter w;
+    w.Write(SCAN_CACHE_MAGIC);
+    w.Write<uint32_t>(SCANNER_VERSION);
+    for (const uint8_t b : rom.View(HEADER_POS, HEADER_SIZE).Bytes(HEADER_POS, HEADER_SIZE))
+        w.Write(b);
+    /* the scan without profile is stored with an empty key */
+    auto writeEntry = [&w](const std::vector<uint8_t> &key, const std::vector<MP2KScanner::Result> &results) {
+        w.WriteVector(key);
+        w.Write<uint64_t>(results.size());
+        for (const MP2KScanner::Result &result : results)
+            WriteResult(w, result);
+    };
+    w.Write<uint64_t>(entries.size() + (scanResults ? 1 : 0));
+    for (const auto &[key, results] : entries)
+        writeEntry(key, results);
+    if (scanResults)
+        writeEntry({}, *scanResults);
+
+    std::error_code ec;
+    std::filesystem::create_directories(cachePath.parent_path(), ec);
+    if (ec)
+        return;
+
+    if (OS::WriteFileAtomic(cachePath, w.GetData()))
+        dirty = false;
+}
+
+/*
+ * private ScanCache
+ */
+
+std::vector<uint8_t> ScanCache::ProfileKey(const Profile &profile)
+{
+    /* All parts of the profile, which are used by MP2KScanner::Scan. The key is never empty, an empty key
+     * marks the scan without profile in the cache file. */
+    StateWriter w;
+    w.Write<uint64_t>(profile.songTableInfoConfig.pos);
+    w.Write(profile.songTableInfoConfig.count);
+    w.Write(profile.songTableInfoConfig.tableIdx);
+    w.WriteVector(profile.playerTableConfig);
+    w.Write(profile.mp2kSoundModeConfig);
+    return std::move(w.GetData());
+}
+
+void ScanCache::Load()
+{
+    std::ifstream ifs(cachePath, std::ios::binary);
+    if (!ifs.is_open())
+        return;
+
+    const std::vector<uint8_t> data{std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+    if (ifs.bad())
+        return;
+
+    try {
+        StateReader r(data);
+        if (r.Read<std::array<char, 8>>() != SCAN_CACHE_MAGIC || r.Read<uint32_t>() != SCANNER_VERSION)
+            return;
+        for (const uint8_t b : rom.View(HEADER_POS, HEADER_SIZE).Bytes(HEADER_POS, HEADER_SIZE)) {
+            if (r.Read<uint8_t>() != b)
+                return;
+        }
+
+        std::map<std::vector<uint8_t>, std::vector<MP2KScanner::Result>> loadedEntries;
+        std::optional<std::vector<MP2KScanner::Result>> loadedScanResults;
+        const uint64_t entryCount = r.Read<uint64_t>();
+        for (uint64_t i = 0; i < entryCount; i++) {
+            std::vector<uint8_t> key;
+            r.ReadVector(key);
+            std::vector<MP2KScanner::Result> &results =
+                key.empty() ? loadedScanResults.emplace() : loadedEntries[std::move(key)];
+            const uint64_t resultCount = r.Read<uint64_t>();
+            for (uint64_t j = 0; j < resultCount; j++) {
+                ReadResult(r, results.emplace_back());
+                if (!IsValid(results.back()))
+                    throw Xcept("invalid scan result");
+            }
+        }
+
+        if (!r.AtEnd())
+            return;
+        entries = std::move(loadedEntries);
+        scanResults = std::move(loadedScanResults);
+    } catch (const Xcept &e) {
+        Debug::print("Ignoring damaged scan cache file '{}': {}", cachePath.string(), e.what());
+    }
+}
+
+bool ScanCache::IsValid(const MP2KScanner::Result &result) const
+{
+    /* The hash should already guarantee that the results belong to this ROM, but reject anything the scanner
+     * would never have returned. */
+    if (result.songTableInfo.IsAuto() || result.songTableInfo.pos >= rom.Size())
+        return false;
+    if (result.playerTableInfo.empty())
+        return false;
+    for (const PlayerInfo &playerInfo : result.playerTableInfo) {
+        if (playerInfo.maxTracks > MAX_TRACKS)
+            return false;
+    }
+    return !result.mp2kSoundMode.IsAuto();
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "MP2KScanner.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <vector>
+
+struct Profile;
+class Rom;
+
+/* The ScanCache stores scan results on disk, so scanning a ROM again can be skipped. Cache files are named by
+ * a hash of the ROM data (and whether it was loaded from a GSF) and contain the results of all scans of that ROM
+ * (one entry per scanned profile configuration and one for the scan without a profile).
+ * Results of a different SCANNER_VERSION are ignored. */
+class ScanCache
+{
+public:
+    ScanCache(const Rom &rom);
+    ScanCache(const ScanCache &) = delete;
+    ScanCache &operator=(const ScanCache &) = delete;
+
+    /* Same as MP2KScanner::Scan(profile). Returns false if no result is cached. */
+    bool GetProfileScan(Profile &profile) const;
+    void PutProfileScan(const Profile &profile);
+
+    /* Same as MP2KScanner::Scan(nullptr). Returns false if no result is cached. */
+    bool GetScan(std::vector<MP2KScanner::Result> &results) const;
+    void PutScan(const std::vector<MP2KScanner::Result> &results);
+
+    /* Writes the cache file if results were added. */
+    void Save();
+
+private:
+    static std::vector<uint8_t> ProfileKey(const Profile &profile);
+    void Load();
+    bool IsValid(const MP2KScanner::Result &result) const;
+
+    const Rom &rom;
+    std::filesystem::path cachePath;
+    std::map<std::vector<uint8_t>, std::vector<MP2KScanner::Result>> entries;    // by ProfileKey
+    std::optional<std::vector<MP2KScanner::Result>> scanResults;                // scan without profile
+    bool dirty = false;
+};
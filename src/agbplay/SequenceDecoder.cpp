@@ -0,0 +1,317 @@
+#include "SequenceDecoder.hpp"
+
+#include "Rom.hpp"
+#include "Xcept.hpp"
+
+#include <map>
+
+/*
+ * SequenceDecoder data
+ */
+
+static const std::map<uint8_t, uint8_t> delayLut = {
+    {0x80, 0},  {0x81, 1},  {0x82, 2},  {0x83, 3},  {0x84, 4},  {0x85, 5},  {0x86, 6},  {0x87, 7},  {0x88, 8},
+    {0x89, 9},  {0x8A, 10}, {0x8B, 11}, {0x8C, 12}, {0x8D, 13}, {0x8E, 14}, {0x8F, 15}, {0x90, 16}, {0x91, 17},
+    {0x92, 18}, {0x93, 19}, {0x94, 20}, {0x95, 21}, {0x96, 22}, {0x97, 23}, {0x98, 24}, {0x99, 28}, {0x9A, 30},
+    {0x9B, 32}, {0x9C, 36}, {0x9D, 40}, {0x9E, 42}, {0x9F, 44}, {0xA0, 48}, {0xA1, 52}, {0xA2, 54}, {0xA3, 56},
+    {0xA4, 60}, {0xA5, 64}, {0xA6, 66}, {0xA7, 68}, {0xA8, 72}, {0xA9, 76}, {0xAA, 78}, {0xAB, 80}, {0xAC, 84},
+    {0xAD, 88}, {0xAE, 90}, {0xAF, 92}, {0xB0, 96}
+};
+
+static const std::map<uint8_t, uint8_t> noteLut = {
+    {0xCF, 0},  {0xD0, 1},  {0xD1, 2},  {0xD2, 3},  {0xD3, 4},  {0xD4, 5},  {0xD5, 6},  {0xD6, 7},  {0xD7, 8},
+    {0xD8, 9},  {0xD9, 10}, {0xDA, 11}, {0xDB, 12}, {0xDC, 13}, {0xDD, 14}, {0xDE, 15}, {0xDF, 16}, {0xE0, 17},
+    {0xE1, 18}, {0xE2, 19}, {0xE3, 20}, {0xE4, 21}, {0xE5, 22}, {0xE6, 23}, {0xE7, 24}, {0xE8, 28}, {0xE9, 30},
+    {0xEA, 32}, {0xEB, 36}, {0xEC, 40}, {0xED, 42}, {0xEE, 44}, {0xEF, 48}, {0xF0, 52}, {0xF1, 54}, {0xF2, 56},
+    {0xF3, 60}, {0xF4, 64}, {0xF5, 66}, {0xF6, 68}, {0xF7, 72}, {0xF8, 76}, {0xF9, 78}, {0xFA, 80}, {0xFB, 84},
+    {0xFC, 88}, {0xFD, 90}, {0xFE, 92}, {0xFF, 96}
+};
+
+/* MEMACC with a conditional jump is the longest event (8 bytes) */
+static const size_t MAX_EVENT_SIZE = 8;
+
+/* Jump targets are only read by MP2K once the jump is taken. An invalid pointer therefore
+ * must not fail decoding, but only once the jump is executed. */
+struct JumpTarget
+{
+    bool valid = false;
+    size_t pos = 0;
+    std::string error;
+};
+
+template<typename RomReader> static JumpTarget readJumpTarget(const RomReader &rom, size_t pos)
+{
+    JumpTarget target;
+    try {
+        target.pos = rom.ReadAgbPtrToPos(pos);
+        target.valid = true;
+    } catch (const Xcept &e) {
+        target.error = e.what();
+    }
+    return target;
+}
+
+/* Decode a single event. ev.pos and ev.lastCmd have to be initialized with the event position
+ * and the running status before the event. Throws if the event reaches beyond the end of the ROM.
+ * RomReader is either a Rom or a RomView, which covers the entire event. */
+template<typename RomReader> static void decodeEvent(const RomReader &rom, SequenceEvent &ev, JumpTarget &target)
+{
+    size_t pos = ev.pos;
+    uint8_t cmd = rom.ReadU8(pos);
+
+    // check if a previous command should be repeated
+    if (cmd < 0x80) {
+        cmd = ev.lastCmd;
+        if (cmd < 0x80) {
+            // song data error, command not initialized
+            ev.type = SequenceEventType::FINE;
+            ev.nextPos = pos;
+            return;
+        }
+    } else {
+        pos++;
+        if (cmd >= 0xBD) {
+            // repeatable command
+            ev.lastCmd = cmd;
+        }
+    }
+
+    if (cmd >= 0xCF) {
+        ev.type = SequenceEventType::NOTE;
+        ev.wait = noteLut.at(cmd);
+        if (rom.ReadU8(pos) < 0x80) {
+            ev.args[0] = rom.ReadU8(pos++);
+            ev.argFlags |= SequenceEvent::ARG_KEY;
+
+            if (rom.ReadU8(pos) < 0x80) {
+                ev.args[1] = rom.ReadU8(pos++);
+                ev.argFlags |= SequenceEvent::ARG_VEL;
+
+                if (rom.ReadU8(pos) < 0x80) {
+                    ev.args[2] = rom.ReadU8(pos++);
+                    ev.argFlags |= SequenceEvent::ARG_LEN;
+                }
+            }
+        }
+        ev.nextPos = pos;
+        return;
+    }
+
+    if (cmd < 0xB1) {
+        ev.type = SequenceEventType::WAIT;
+        ev.wait = delayLut.at(cmd);
+        ev.nextPos = pos;
+        return;
+    }
+
+    auto singleArgFunc = [&](SequenceEventType type) {
+        ev.type = type;
+        ev.args[0] = rom.ReadU8(pos++);
+    };
+
+    switch (cmd) {
+    case 0xB1:
+        ev.type = SequenceEventType::FINE;
+        break;
+    case 0xB2:
+        ev.type = SequenceEventType::GOTO;
+        target = readJumpTarget(rom, pos);
+        break;
+    case 0xB3:
+        /* nextPos points to the pattern pointer, the return position is after it */
+        ev.type = SequenceEventType::PATT;
+        target = readJumpTarget(rom, pos);
+        break;
+    case 0xB4:
+        ev.type = SequenceEventType::PEND;
+        break;
+    case 0xB5:
+        ev.args[0] = rom.ReadU8(pos++);
+        if (ev.args[0] == 0) {
+            ev.type = SequenceEventType::FINE;
+            break;
+        }
+        ev.type = SequenceEventType::REPT;
+        target = readJumpTarget(rom, pos);
+        pos += 4;
+        break;
+    case 0xB9:
+        ev.type = SequenceEventType::MEMACC;
+        ev.args[0] = rom.ReadU8(pos++);
+        ev.args[1] = rom.ReadU8(pos++);
+        ev.args[2] = rom.ReadU8(pos++);
+        /* operations 6-17 are conditional jumps */
+        if (ev.args[0] >= 6 && ev.args[0] <= 17) {
+            target = readJumpTarget(rom, pos);
+            pos += 4;
+        }
+        break;
+    case 0xBA:
+        singleArgFunc(SequenceEventType::PRIO);
+        break;
+    case 0xBB:
+        singleArgFunc(SequenceEventType::TEMPO);
+        break;
+    case 0xBC:
+        singleArgFunc(SequenceEventType::KEYSH);
+        break;
+    case 0xBD:
+        singleArgFunc(SequenceEventType::VOICE);
+        break;
+    case 0xBE:
+        singleArgFunc(SequenceEventType::VOL);
+        break;
+    case 0xBF:
+        singleArgFunc(SequenceEventType::PAN);
+        break;
+    case 0xC0:
+        singleArgFunc(SequenceEventType::BEND);
+        break;
+    case 0xC1:
+        singleArgFunc(SequenceEventType::BENDR);
+        break;
+    case 0xC2:
+        singleArgFunc(SequenceEventType::LFOS);
+        break;
+    case 0xC3:
+        singleArgFunc(SequenceEventType::LFODL);
+        break;
+    case 0xC4:
+        singleArgFunc(SequenceEventType::MOD);
+        break;
+    case 0xC5:
+        singleArgFunc(SequenceEventType::MODT);
+        break;
+    case 0xC8:
+        singleArgFunc(SequenceEventType::TUNE);
+        break;
+    case 0xCD:
+        // xCMD
+        switch (rom.ReadU8(pos++)) {
+        case 1:     // XWAVE (stub)
+        case 13:    // XSOFF (stub)
+            ev.type = SequenceEventType::NOP;
+            pos += 4;
+            break;
+        case 2:     // XTYPE (stub)
+        case 4:     // XATTA (stub)
+        case 5:     // XDECA (stub)
+        case 6:     // XSUST (stub)
+        case 7:     // XRELA (stub)
+        case 10:    // XLENG (stub)
+        case 11:    // XSWEE (stub)
+            ev.type = SequenceEventType::NOP;
+            pos++;
+            break;
+        case 8:
+            singleArgFunc(SequenceEventType::XIECV);
+            break;
+        case 9:
+            singleArgFunc(SequenceEventType::XIECL);
+            break;
+        case 12:
+            ev.type = SequenceEventType::XWAIT;
+            ev.wait = rom.ReadU16(pos);
+            pos += 2;
+            break;
+        default:
+            ev.type = SequenceEventType::FINE;
+            break;
+        }
+        break;
+    case 0xCE:
+        ev.type = SequenceEventType::EOT;
+        if (rom.ReadU8(pos) < 0x80) {
+            ev.args[0] = rom.ReadU8(pos++);
+            ev.argFlags |= SequenceEvent::ARG_KEY;
+        }
+        break;
+    default:
+        ev.type = SequenceEventType::FINE;
+        break;
+    }
+
+    ev.nextPos = pos;
+}
+
+/*
+ * public SequenceDecoder
+ */
+
+SequenceDecoder::SequenceDecoder(const Rom &rom) : rom(rom)
+{
+}
+
+uint32_t SequenceDecoder::Decode(size_t pos, uint8_t lastCmd)
+{
+    std::vector<uint32_t> pending;
+    const uint32_t entryIdx = Lookup(pos, lastCmd, pending);
+
+    while (!pending.empty()) {
+        const uint32_t idx = pending.back();
+        pending.pop_back();
+
+        /* Lookup may grow the event array, so work on a copy. */
+        SequenceEvent ev = events[idx];
+        JumpTarget target;
+
+        try {
+            /* Events far enough from the end of the ROM can be decoded without bounds checks. */
+            if (rom.ValidRange(ev.pos, MAX_EVENT_SIZE))
+                decodeEvent(rom.View(ev.pos, MAX_EVENT_SIZE), ev, target);
+            else
+                decodeEvent(rom, ev, target);
+        } catch (const Xcept &e) {
+            ev.type = SequenceEventType::ERROR;
+            errors[idx] = e.what();
+        }
+
+        switch (ev.type) {
+        case SequenceEventType::FINE:
+        case SequenceEventType::ERROR:
+        case SequenceEventType::GOTO:
+        case SequenceEventType::PATT:
+            /* no linear successor, PATT returns are resolved at runtime */
+            break;
+        default:
+            ev.next = Lookup(ev.nextPos, ev.lastCmd, pending);
+            break;
+        }
+
+        if (target.valid) {
+            ev.target = Lookup(target.pos, ev.lastCmd, pending);
+        } else if (!target.error.empty()) {
+            SequenceEvent &errorEv = events.emplace_back();
+            errorEv.pos = errorEv.nextPos = ev.nextPos;
+            errorEv.type = SequenceEventType::ERROR;
+            errorEv.lastCmd = ev.lastCmd;
+            ev.target = static_cast<uint32_t>(events.size() - 1);
+            errors[ev.target] = std::move(target.error);
+        }
+
+        events[idx] = ev;
+    }
+
+    return entryIdx;
+}
+
+const std::string &SequenceDecoder::GetError(uint32_t idx) const
+{
+    return errors.at(idx);
+}
+
+/*
+ * private SequenceDecoder
+ */
+
+uint32_t SequenceDecoder::Lookup(size_t pos, uint8_t lastCmd, std::vector<uint32_t> &pending)
+{
+    const auto [it, inserted] = eventIndex.try_emplace(MakeKey(pos, lastCmd), static_cast<uint32_t>(events.size()));
+    if (inserted) {
+        SequenceEvent &ev = events.emplace_back();
+        ev.pos = ev.nextPos = pos;
+        ev.lastCmd = lastCmd;
+        pending.push_back(it->second);
+    }
+    return it->second;
+}
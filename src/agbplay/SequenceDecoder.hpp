@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Rom;
+
+enum class SequenceEventType : uint8_t {
+    WAIT = 0,
+    NOTE,
+    EOT,
+    FINE,
+    GOTO,
+    PATT,
+    PEND,
+    REPT,
+    MEMACC,
+    PRIO,
+    TEMPO,
+    KEYSH,
+    VOICE,
+    VOL,
+    PAN,
+    BEND,
+    BENDR,
+    LFOS,
+    LFODL,
+    MOD,
+    MODT,
+    TUNE,
+    XIECV,
+    XIECL,
+    XWAIT,
+    NOP,
+    ERROR,
+};
+
+/* A single decoded sequence command. Running status is already resolved and
+ * all jump targets are indices into the event array of the SequenceDecoder. */
+struct SequenceEvent
+{
+    static const uint32_t INDEX_NONE = 0xFFFFFFFF;
+
+    /* Flags for optional arguments of NOTE and EOT */
+    static const uint8_t ARG_KEY = 0x1;
+    static const uint8_t ARG_VEL = 0x2;
+    static const uint8_t ARG_LEN = 0x4;
+
+    size_t pos;            // ROM position of the command
+    size_t nextPos;        // ROM position after the command and its arguments
+    uint32_t next = INDEX_NONE;
+    uint32_t target = INDEX_NONE;    // GOTO, PATT, REPT, MEMACC
+    uint16_t wait = 0;               // WAIT, XWAIT, NOTE (base length)
+    SequenceEventType type = SequenceEventType::FINE;
+    uint8_t lastCmd = 0;    // running status after this event
+    uint8_t args[3] = {0, 0, 0};
+    uint8_t argFlags = 0;
+};
+
+/* The SequenceDecoder translates MP2K track data to SequenceEvents. All events reachable from
+ * a track start are decoded at once, so the SequenceReader does not have to validate ROM
+ * accesses while playing. Decoded events are cached for the lifetime of the decoder. */
+class SequenceDecoder
+{
+public:
+    SequenceDecoder(const Rom &rom);
+    SequenceDecoder(const SequenceDecoder &) = delete;
+    SequenceDecoder &operator=(const SequenceDecoder &) = delete;
+
+    uint32_t Decode(size_t pos, uint8_t lastCmd);
+    const SequenceEvent &Get(uint32_t idx) const { return events[idx]; }
+    const std::string &GetError(uint32_t idx) const;
+
+private:
+    static uint64_t MakeKey(size_t pos, uint8_t lastCmd) { return (static_cast<uint64_t>(pos) << 8) | lastCmd; }
+
+    uint32_t Lookup(size_t pos, uint8_t lastCmd, std::vector<uint32_t> &pending);
+
+    const Rom &rom;
+    std::vector<SequenceEvent> events;
+    std::unordered_map<uint64_t, uint32_t> eventIndex;
+    std::unordered_map<uint32_t, std::string> errors;
+};
@@ -1,45 +1,26 @@
 #include "SequenceReader.hpp"
 
-#include "Debug.hpp"
 #include "MP2KContext.hpp"
 #include "Rom.hpp"
+#include "SoundData.hpp"
+#include "StateStream.hpp"
 #include "Util.hpp"
 #include "Xcept.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <zlib.h>
 
 #define NOTE_TIE     -1
 #define NOTE_ALL     0xFE
 #define LOOP_ENDLESS -1
 
-/*
- * SequenceReader data
- */
-
-const std::map<uint8_t, uint8_t> SequenceReader::delayLut = {
-    {0x80, 0},  {0x81, 1},  {0x82, 2},  {0x83, 3},  {0x84, 4},  {0x85, 5},  {0x86, 6},  {0x87, 7},  {0x88, 8},
-    {0x89, 9},  {0x8A, 10}, {0x8B, 11}, {0x8C, 12}, {0x8D, 13}, {0x8E, 14}, {0x8F, 15}, {0x90, 16}, {0x91, 17},
-    {0x92, 18}, {0x93, 19}, {0x94, 20}, {0x95, 21}, {0x96, 22}, {0x97, 23}, {0x98, 24}, {0x99, 28}, {0x9A, 30},
-    {0x9B, 32}, {0x9C, 36}, {0x9D, 40}, {0x9E, 42}, {0x9F, 44}, {0xA0, 48}, {0xA1, 52}, {0xA2, 54}, {0xA3, 56},
-    {0xA4, 60}, {0xA5, 64}, {0xA6, 66}, {0xA7, 68}, {0xA8, 72}, {0xA9, 76}, {0xAA, 78}, {0xAB, 80}, {0xAC, 84},
-    {0xAD, 88}, {0xAE, 90}, {0xAF, 92}, {0xB0, 96}
-};
-
-const std::map<uint8_t, uint8_t> SequenceReader::noteLut = {
-    {0xCF, 0},  {0xD0, 1},  {0xD1, 2},  {0xD2, 3},  {0xD3, 4},  {0xD4, 5},  {0xD5, 6},  {0xD6, 7},  {0xD7, 8},
-    {0xD8, 9},  {0xD9, 10}, {0xDA, 11}, {0xDB, 12}, {0xDC, 13}, {0xDD, 14}, {0xDE, 15}, {0xDF, 16}, {0xE0, 17},
-    {0xE1, 18}, {0xE2, 19}, {0xE3, 20}, {0xE4, 21}, {0xE5, 22}, {0xE6, 23}, {0xE7, 24}, {0xE8, 28}, {0xE9, 30},
-    {0xEA, 32}, {0xEB, 36}, {0xEC, 40}, {0xED, 42}, {0xEE, 44}, {0xEF, 48}, {0xF0, 52}, {0xF1, 54}, {0xF2, 56},
-    {0xF3, 60}, {0xF4, 64}, {0xF5, 66}, {0xF6, 68}, {0xF7, 72}, {0xF8, 76}, {0xF9, 78}, {0xFA, 80}, {0xFB, 84},
-    {0xFC, 88}, {0xFD, 90}, {0xFE, 92}, {0xFF, 96}
-};
-
 /*
  * public SequenceReader
  */
 
-SequenceReader::SequenceReader(MP2KContext &ctx) : ctx(ctx)
+SequenceReader::SequenceReader(MP2KContext &ctx) : ctx(ctx), decoder(ctx.rom), instruments(ctx.rom)
 {
 }
 
@@ -76,6 +57,74 @@ float SequenceReader::GetSpeedFactor() const
     return speedFactor;
 }
 
+void SequenceReader::SetAnalysis(MP2KSongAnalysis *analysis)
+{
+    this->analysis = analysis;
+    analysisNotes.clear();
+    analysisEventTimes.clear();
+    analysisDataRanges.clear();
+    analysisInstruments.clear();
+}
+
+uint64_t SequenceReader::AnalysisDataHash()
+{
+    const Rom &rom = ctx.rom;
+    std::set<std::pair<size_t, size_t>> ranges = analysisDataRanges;
+
+    for (const MP2KPlayer &player : ctx.players) {
+        if (player.songHeaderPos == 0 || !rom.ValidRange(player.songHeaderPos, 8))
+            continue;
+        const size_t numTracks = rom.ReadU8(player.songHeaderPos);
+        ranges.emplace(player.songHeaderPos, player.songHeaderPos + 8 + numTracks * 4);
+    }
+
+    for (const auto &[bankPos, prog, key] : analysisInstruments) {
+        const InstrumentDescriptor &instr = instruments.Get(bankPos, prog, key);
+        if (!instr.keyResolved)
+            continue;
+        ranges.emplace(instr.instrPos, instr.instrPos + 12);
+        if (!instr.playable)
+            continue;
+
+        if ((instr.instrType & BANKDATA_TYPE_CGB) == BANKDATA_TYPE_WAVE) {
+            if (rom.ValidPointer(instr.instrDutyWaveNp)) {
+                const size_t wavePos = instr.instrDutyWaveNp - AGB_MAP_ROM;
+                ranges.emplace(wavePos, wavePos + 16);
+            }
+        } else if ((instr.instrType & BANKDATA_TYPE_CGB) == BANKDATA_TYPE_PCM) {
+            const SampleInfo &sInfo = instr.sInfo;
+            /* compressed samples are stored in blocks of 64 samples with 33 bytes each */
+            const size_t dataLen = sInfo.gamefreakCompressed ? (size_t{sInfo.endPos} + 63) / 64 * 33 : sInfo.endPos;
+            ranges.emplace(sInfo.samplePos, sInfo.samplePos + 16 + dataLen);
+        }
+    }
+
+    uLong crc = crc32_z(0, nullptr, 0);
+    uLong adler = adler32_z(0, nullptr, 0);
+    for (const auto &[begin, end] : ranges) {
+        const size_t clampedEnd = std::min(end, rom.Size());
+        if (begin >= clampedEnd)
+            continue;
+        const uint8_t *data = static_cast<const uint8_t *>(rom.GetPtr(begin));
+        crc = crc32_z(crc, data, clampedEnd - begin);
+        adler = adler32_z(adler, data, clampedEnd - begin);
+    }
+    return (static_cast<uint64_t>(crc & 0xFFFFFFFF) << 32) | static_cast<uint64_t>(adler & 0xFFFFFFFF);
+}
+
+void SequenceReader::SaveState(StateWriter &w) const
+{
+    /* The speed factor is a playback setting and not part of the song state. */
+    w.Write(endReached);
+    w.Write(numLoops);
+}
+
+void SequenceReader::LoadState(StateReader &r)
+{
+    r.Read(endReached);
+    r.Read(numLoops);
+}
+
 /*
  * private SequenceReader
  */
@@ -130,44 +179,43 @@ bool SequenceReader::PlayerMain(MP2KPlayer &player)
 
 bool SequenceReader::TrackMain(MP2KPlayer &player, MP2KTrack &trk)
 {
-    const Rom &rom = ctx.rom;
-
     if (!trk.enabled)
         return false;
 
     /* Count down note duration and end notes if necessary. */
     TickTrackNotes(trk);
+    if (analysis)
+        AnalysisTickNotes(trk);
+
+    /* Decode all reachable track data once. Already decoded events are cached by the decoder. */
+    if (trk.eventIdx == SequenceEvent::INDEX_NONE)
+        trk.eventIdx = decoder.Decode(trk.pos, trk.lastCmd);
 
     /* Count down track delay and process events if necessary. */
     while (trk.delay == 0) {
-        uint8_t cmd = rom.ReadU8(trk.pos);
-
-        // check if a previous command should be repeated
-        if (cmd < 0x80) {
-            cmd = trk.lastCmd;
-            if (cmd < 0x80) {
-                // song data error, command not initialized
-                cmdPlayFine(trk);
-                return false;
-            }
+        const SequenceEvent &ev = decoder.Get(trk.eventIdx);
+        if (ev.type == SequenceEventType::ERROR)
+            throw Xcept("{}", decoder.GetError(trk.eventIdx));
+
+        /* remember when track positions were first played to determine the loop start */
+        if (analysis && trk.trackIdx == 0)
+            analysisEventTimes.try_emplace(ev.pos, GetAnalysisTime(player));
+        if (analysis)
+            analysisDataRanges.emplace(ev.pos, ev.nextPos);
+
+        trk.lastCmd = ev.lastCmd;
+        trk.pos = ev.nextPos;
+        trk.eventIdx = ev.next;
+
+        if (ev.type == SequenceEventType::NOTE) {
+            cmdPlayNote(player, trk, ev);
+        } else if (ev.type == SequenceEventType::WAIT) {
+            trk.delay = ev.wait;
         } else {
-            trk.pos++;
-            if (cmd >= 0xBD) {
-                // repeatable command
-                trk.lastCmd = cmd;
-            }
-        }
-
-        if (cmd >= 0xCF) {
-            // note command
-            cmdPlayNote(player, trk, cmd);
-        } else if (cmd >= 0xB1) {
             // state altering command
-            cmdPlayCommand(player, trk, cmd);
+            cmdPlayCommand(player, trk, ev);
             if (!trk.enabled)
                 return false;
-        } else {
-            trk.delay = delayLut.at(cmd);
         }
     }
 
@@ -233,6 +281,21 @@ int SequenceReader::TickTrackNotes(MP2KTrack &trk)
     return active;
 }
 
+SequenceReader::AnalysisTime SequenceReader::GetAnalysisTime(const MP2KPlayer &player) const
+{
+    return AnalysisTime{player.tickCount, player.interframeCount * ctx.mixer.GetSamplesPerBuffer()};
+}
+
+void SequenceReader::AnalysisTickNotes(const MP2KTrack &trk)
+{
+    /* same note length handling as MP2KChn::TickNote, a length of 0 is a tie */
+    std::erase_if(analysisNotes, [&trk](AnalysisNote &note) {
+        if (note.trk != &trk || note.length == 0)
+            return false;
+        return --note.length == 0;
+    });
+}
+
 void SequenceReader::AddNoteToState(MP2KTrack &trk, const MP2KChn &chn)
 {
     trk.activeNotes[chn.note.midiKeyTrackData % NUM_NOTES] = true;
@@ -265,54 +328,35 @@ void SequenceReader::TrackVolPitchSet(
     setFunc(ctx.noiseChannels);
 }
 
-void SequenceReader::cmdPlayNote(MP2KPlayer &player, MP2KTrack &trk, uint8_t cmd)
+void SequenceReader::cmdPlayNote(MP2KPlayer &player, MP2KTrack &trk, const SequenceEvent &ev)
 {
-    const Rom &rom = ctx.rom;
-
-    trk.lastNoteLen = noteLut.at(cmd);
-
-    // parse command from track data
-    if (rom.ReadU8(trk.pos) < 0x80) {
-        trk.lastNoteKey = rom.ReadU8(trk.pos++);
+    trk.lastNoteLen = static_cast<uint8_t>(ev.wait);
 
-        if (rom.ReadU8(trk.pos) < 0x80) {
-            trk.lastNoteVel = rom.ReadU8(trk.pos++);
-
-            if (rom.ReadU8(trk.pos) < 0x80) {
-                trk.lastNoteLen += rom.ReadU8(trk.pos++);
-            }
-        }
-    }
+    // apply optional arguments
+    if (ev.argFlags & SequenceEvent::ARG_KEY)
+        trk.lastNoteKey = ev.args[0];
+    if (ev.argFlags & SequenceEvent::ARG_VEL)
+        trk.lastNoteVel = ev.args[1];
+    if (ev.argFlags & SequenceEvent::ARG_LEN)
+        trk.lastNoteLen = static_cast<uint8_t>(trk.lastNoteLen + ev.args[2]);
 
     // don't play invalid instruments
     if (trk.prog > 127)
         return;
 
-    // find instrument definition
-    uint8_t midiKeyPitch;
-    int8_t rhythmPan = 0;
-    size_t instrPos = player.bankPos + trk.prog * 12;
-    if (const uint8_t bankDataType = rom.ReadU8(instrPos + 0x0); bankDataType & BANKDATA_TYPE_SPLIT) {
-        const size_t subBankPos = rom.ReadAgbPtrToPos(instrPos + 0x4);
-        const size_t subKeyMap = rom.ReadAgbPtrToPos(instrPos + 0x8);
-        instrPos = subBankPos + rom.ReadU8(subKeyMap + trk.lastNoteKey) * 12;
-        if (rom.ReadU8(instrPos + 0x0) & (BANKDATA_TYPE_SPLIT | BANKDATA_TYPE_RHYTHM)) {
-            Debug::print("cmdPlayNote: attempting to play recursive key split");
-            return;
-        }
-        midiKeyPitch = trk.lastNoteKey;
-    } else if (bankDataType == BANKDATA_TYPE_RHYTHM) {
-        const size_t subBankPos = rom.ReadAgbPtrToPos(instrPos + 0x4);
-        instrPos = subBankPos + trk.lastNoteKey * 12;
-        if (rom.ReadU8(instrPos + 0x0) & (BANKDATA_TYPE_SPLIT | BANKDATA_TYPE_RHYTHM)) {
-            Debug::print("cmdPlayNote: attempting to play recursive rhythm part");
-            return;
-        }
-        if (const uint8_t instrPan = rom.ReadU8(instrPos + 0x3); instrPan & 0x80)
-            rhythmPan = static_cast<int8_t>((instrPan - 0xC0) * 2);
-        midiKeyPitch = rom.ReadU8(instrPos + 0x1);
-    } else {
-        midiKeyPitch = trk.lastNoteKey;
+    // only count notes without creating voices in analysis mode
+    if (analysis) {
+        analysisNotes.emplace_back(&trk, trk.lastNoteKey, trk.lastNoteLen);
+        analysisInstruments.emplace(player.bankPos, trk.prog, trk.lastNoteKey);
+        analysis->maxPolyphony = std::max(analysis->maxPolyphony, analysisNotes.size());
+        return;
+    }
+
+    const InstrumentDescriptor &instr = instruments.Get(player.bankPos, trk.prog, trk.lastNoteKey);
+    if (!instr.keyResolved) {
+        if (!instr.error.empty())
+            throw Xcept("{}", instr.error);
+        return;
     }
 
     // init LFO
@@ -324,21 +368,22 @@ void SequenceReader::cmdPlayNote(MP2KPlayer &player, MP2KTrack &trk, uint8_t cmd
     Note note;
     note.length = trk.lastNoteLen;
     note.midiKeyTrackData = trk.lastNoteKey;
-    note.midiKeyPitch = midiKeyPitch;
+    note.midiKeyPitch = instr.midiKeyPitch;
     note.velocity = trk.lastNoteVel;
     note.priority = trk.priority;
-    note.rhythmPan = rhythmPan;
+    note.rhythmPan = instr.rhythmPan;
     note.pseudoEchoVol = trk.pseudoEchoVol;
     note.pseudoEchoLen = trk.pseudoEchoLen;
     note.trackIdx = trk.trackIdx;
     note.playerIdx = player.playerIdx;
-    note.psgLength = rom.ReadU8(instrPos + 0x2);
+    note.psgLength = instr.psgLength;
+
+    if (!instr.error.empty())
+        throw Xcept("{}", instr.error);
+    if (!instr.playable)
+        return;
 
-    ADSR adsr;
-    adsr.att = rom.ReadU8(instrPos + 0x8);
-    adsr.dec = rom.ReadU8(instrPos + 0x9);
-    adsr.sus = rom.ReadU8(instrPos + 0xA);
-    adsr.rel = rom.ReadU8(instrPos + 0xB);
+    const ADSR &adsr = instr.adsr;
 
     // TODO move this to external function
     // TODO the track address comparison is not well defined in terms of the relative location
@@ -380,90 +425,39 @@ void SequenceReader::cmdPlayNote(MP2KPlayer &player, MP2KTrack &trk, uint8_t cmd
     };
 
     const MP2KChn *chn = nullptr;
-    const uint8_t instrType = rom.ReadU8(instrPos);
 
     // enqueue actual note
-    if (instrType & BANKDATA_TYPE_CGB) {
-        const uint8_t sweep = rom.ReadU8(instrPos + 0x3);
-        const uint32_t instrDutyWaveNp = rom.ReadU32(instrPos + 0x4);
-
-        switch (instrType & BANKDATA_TYPE_CGB) {
+    if (instr.instrType & BANKDATA_TYPE_CGB) {
+        switch (instr.instrType & BANKDATA_TYPE_CGB) {
         case BANKDATA_TYPE_SQ1:
             if (!cgbPolyphonySuppressFunc(ctx.sq1Channels))
                 return;
-            ctx.sq1Channels.emplace_back(ctx, &trk, instrDutyWaveNp, adsr, note, sweep);
+            ctx.sq1Channels.emplace_back(ctx, &trk, instr.instrDutyWaveNp, adsr, note, instr.sweep);
             chn = &ctx.sq1Channels.back();
             break;
         case BANKDATA_TYPE_SQ2:
             if (!cgbPolyphonySuppressFunc(ctx.sq2Channels))
                 return;
-            ctx.sq2Channels.emplace_back(ctx, &trk, instrDutyWaveNp, adsr, note, 0);
+            ctx.sq2Channels.emplace_back(ctx, &trk, instr.instrDutyWaveNp, adsr, note, 0);
             chn = &ctx.sq2Channels.back();
             break;
         case BANKDATA_TYPE_WAVE:
             if (!cgbPolyphonySuppressFunc(ctx.waveChannels))
                 return;
             ctx.waveChannels.emplace_back(
-                ctx, &trk, instrDutyWaveNp, adsr, note, ctx.agbplaySoundMode.accurateCh3Volume
+                ctx, &trk, instr.instrDutyWaveNp, adsr, note, ctx.agbplaySoundMode.accurateCh3Volume
             );
             chn = &ctx.waveChannels.back();
             break;
         case BANKDATA_TYPE_NOISE:
             if (!cgbPolyphonySuppressFunc(ctx.noiseChannels))
                 return;
-            ctx.noiseChannels.emplace_back(ctx, &trk, instrDutyWaveNp, adsr, note);
+            ctx.noiseChannels.emplace_back(ctx, &trk, instr.instrDutyWaveNp, adsr, note);
             chn = &ctx.noiseChannels.back();
             break;
-        default:
-            Debug::print(
-                "CGB Error: Invalid CGB Type: [{:08X}]={:02X}, instrument: [{:08X}]",
-                instrPos,
-                rom.ReadU8(instrPos),
-                instrPos
-            );
-            return;
         }
     } else {
-        const size_t samplePos = rom.ReadAgbPtrToPos(instrPos + 0x4);
-        SampleInfo sinfo;
-
-        if (rom.ReadU8(samplePos + 0x0) == 0) {
-            sinfo.gamefreakCompressed = false;
-        } else if (rom.ReadU8(samplePos + 0x0) == 1) {
-            sinfo.gamefreakCompressed = true;
-        } else {
-            Debug::print(
-                "Sample Error: Unknown/unsupported sample mode: [{:08X}]={:02X}, instrument: [{:08X}]",
-                samplePos,
-                rom.ReadU8(samplePos),
-                instrPos
-            );
-            return;
-        }
-
-        sinfo.loopEnabled = rom.ReadU8(samplePos + 0x3) & 0xC0;
-        sinfo.midCfreq = static_cast<float>(rom.ReadU32(samplePos + 4)) / 1024.0f;
-        sinfo.loopPos = rom.ReadU32(samplePos + 8);
-        sinfo.endPos = rom.ReadU32(samplePos + 12);
-
-        /* Fix malformed loops found in some romhacks */
-        if (sinfo.loopPos > sinfo.endPos) {
-            Debug::print("Sample Warning: Loop start is after loop end, instrument: [{:#08X}]", samplePos);
-            sinfo.loopPos = 0;
-        }
-        if (sinfo.loopPos == sinfo.endPos) {
-            sinfo.loopEnabled = false;
-        }
-
-        if (!rom.ValidRange(samplePos, 16)) {
-            Debug::print("Sample Error: Sample header reaches beyond end of file: instrument: [{:08X}]", instrPos);
-            return;
-        }
-
-        sinfo.samplePos = samplePos;
-        sinfo.samplePtr = static_cast<const int8_t *>(rom.GetPtr(samplePos + 16));
-
-        ctx.sndChannels.emplace_back(ctx, &trk, sinfo, adsr, note, instrType & BANKDATA_TYPE_FIX);
+        ctx.sndChannels.emplace_back(ctx, &trk, instr.sInfo, adsr, note, instr.instrType & BANKDATA_TYPE_FIX);
         chn = &ctx.sndChannels.back();
     }
 
@@ -477,17 +471,13 @@ void SequenceReader::cmdPlayNote(MP2KPlayer &player, MP2KTrack &trk, uint8_t cmd
     trk.updatePitch = true;
 }
 
-void SequenceReader::cmdPlayCommand(MP2KPlayer &player, MP2KTrack &trk, uint8_t cmd)
+void SequenceReader::cmdPlayCommand(MP2KPlayer &player, MP2KTrack &trk, const SequenceEvent &ev)
 {
-    const Rom &rom = ctx.rom;
-
-    switch (cmd) {
-    case 0xB1:
-        // FINE
+    switch (ev.type) {
+    case SequenceEventType::FINE:
         cmdPlayFine(trk);
         break;
-    case 0xB2:
-        // GOTO
+    case SequenceEventType::GOTO:
         if (trk.trackIdx == 0) {
             // handle agbplay's internal loop counter
             if (ctx.maxLoops != LOOP_ENDLESS && numLoops++ >= static_cast<size_t>(ctx.maxLoops)
@@ -495,127 +485,129 @@ void SequenceReader::cmdPlayCommand(MP2KPlayer &player, MP2KTrack &trk, uint8_t
                 endReached = true;
                 ctx.mixer.StartFadeOut(SONG_FADE_OUT_TIME);
             }
+
+            if (analysis && !analysis->loopFound) {
+                const auto it = analysisEventTimes.find(decoder.Get(ev.target).pos);
+                if (it != analysisEventTimes.end()) {
+                    const AnalysisTime loopEnd = GetAnalysisTime(player);
+                    analysis->loopFound = true;
+                    analysis->loopStartTick = it->second.tick;
+                    analysis->loopStartSample = it->second.sample;
+                    analysis->loopEndTick = loopEnd.tick;
+                    analysis->loopEndSample = loopEnd.sample;
+                }
+            }
         }
-        trk.pos = rom.ReadAgbPtrToPos(trk.pos);
+        JumpToEvent(trk, ev.target);
         break;
-    case 0xB3:
-        // PATT
+    case SequenceEventType::PATT:
         if (trk.patternLevel >= TRACK_CALL_STACK_SIZE) {
             cmdPlayFine(trk);
             break;
         }
         trk.returnPos[trk.patternLevel++] = trk.pos + 4;
-        trk.pos = rom.ReadAgbPtrToPos(trk.pos);
+        JumpToEvent(trk, ev.target);
         break;
-    case 0xB4:
-        // PEND
+    case SequenceEventType::PEND:
         if (trk.patternLevel == 0)
             break;
 
+        /* The running status may differ from when the pattern was called, so the event
+         * to return to can only be determined at this point. */
         trk.pos = trk.returnPos[--trk.patternLevel];
+        trk.eventIdx = decoder.Decode(trk.pos, trk.lastCmd);
         break;
-    case 0xB5:
-        // REPT
-        {
-            uint8_t count = rom.ReadU8(trk.pos++);
-            if (count == 0) {
-                cmdPlayFine(trk);
-                break;
-            }
-            if (++trk.reptCount < count) {
-                trk.pos = rom.ReadAgbPtrToPos(trk.pos);
-            } else {
-                trk.reptCount = 0;
-                trk.pos += 4;
-            }
+    case SequenceEventType::REPT:
+        if (++trk.reptCount < ev.args[0]) {
+            JumpToEvent(trk, ev.target);
+        } else {
+            trk.reptCount = 0;
         }
         break;
-    case 0xB9:
-        // MEMACC
-        cmdPlayMemacc(trk);
+    case SequenceEventType::MEMACC:
+        cmdPlayMemacc(trk, ev);
         break;
-    case 0xBA:
-        // PRIO
-        trk.priority = rom.ReadU8(trk.pos++);
+    case SequenceEventType::PRIO:
+        trk.priority = ev.args[0];
         break;
-    case 0xBB:
-        // TEMPO
-        player.bpm = static_cast<uint16_t>(rom.ReadU8(trk.pos++) * 2);
+    case SequenceEventType::TEMPO:
+        player.bpm = static_cast<uint16_t>(ev.args[0] * 2);
+        if (analysis) {
+            const AnalysisTime time = GetAnalysisTime(player);
+            analysis->tempoChanges.emplace_back(time.tick, time.sample, player.bpm);
+        }
         break;
-    case 0xBC:
-        // KEYSH
-        trk.keyShift = rom.ReadS8(trk.pos++);
+    case SequenceEventType::KEYSH:
+        trk.keyShift = static_cast<int8_t>(ev.args[0]);
         break;
-    case 0xBD:
-        // VOICE
-        trk.prog = rom.ReadU8(trk.pos++);
+    case SequenceEventType::VOICE:
+        trk.prog = ev.args[0];
         break;
-    case 0xBE:
-        // VOL
-        trk.vol = rom.ReadU8(trk.pos++);
+    case SequenceEventType::VOL:
+        trk.vol = ev.args[0];
         trk.updateVolume = true;
         break;
-    case 0xBF:
-        // PAN
-        trk.pan = static_cast<int8_t>(rom.ReadS8(trk.pos++) - 0x40);
+    case SequenceEventType::PAN:
+        trk.pan = static_cast<int8_t>(static_cast<int8_t>(ev.args[0]) - 0x40);
         trk.updateVolume = true;
         break;
-    case 0xC0:
-        // BEND
-        trk.bend = static_cast<int8_t>(rom.ReadS8(trk.pos++) - 0x40);
+    case SequenceEventType::BEND:
+        trk.bend = static_cast<int8_t>(static_cast<int8_t>(ev.args[0]) - 0x40);
         trk.updatePitch = true;
         break;
-    case 0xC1:
-        // BENDR
-        trk.bendr = rom.ReadU8(trk.pos++);
+    case SequenceEventType::BENDR:
+        trk.bendr = ev.args[0];
         trk.updatePitch = true;
         break;
-    case 0xC2:
-        // LFOS
-        trk.lfos = rom.ReadU8(trk.pos++);
+    case SequenceEventType::LFOS:
+        trk.lfos = ev.args[0];
         if (trk.lfos == 0)
             trk.ResetLfoValue();
         break;
-    case 0xC3:
-        // LFODL
-        trk.lfodlCount = trk.lfodl = rom.ReadU8(trk.pos++);
+    case SequenceEventType::LFODL:
+        trk.lfodlCount = trk.lfodl = ev.args[0];
         break;
-    case 0xC4:
-        // MOD
-        trk.mod = rom.ReadU8(trk.pos++);
+    case SequenceEventType::MOD:
+        trk.mod = ev.args[0];
         if (trk.mod == 0)
             trk.ResetLfoValue();
         break;
-    case 0xC5:
-        // MODT
-        {
-            uint8_t modt = rom.ReadU8(trk.pos++);
-            if (static_cast<MODT>(modt) == trk.modt)
-                return;
-            trk.modt = static_cast<MODT>(modt);
-            trk.updateVolume = true;
-            trk.updatePitch = true;
-        }
+    case SequenceEventType::MODT:
+        if (static_cast<MODT>(ev.args[0]) == trk.modt)
+            return;
+        trk.modt = static_cast<MODT>(ev.args[0]);
+        trk.updateVolume = true;
+        trk.updatePitch = true;
         break;
-    case 0xC8:
-        // TUNE
-        trk.tune = static_cast<int8_t>(rom.ReadS8(trk.pos++) - 0x40);
+    case SequenceEventType::TUNE:
+        trk.tune = static_cast<int8_t>(static_cast<int8_t>(ev.args[0]) - 0x40);
         trk.updatePitch = true;
         break;
-    case 0xCD:
-        // xCMD
-        cmdPlayXCmd(trk);
+    case SequenceEventType::XIECV:
+        trk.pseudoEchoVol = ev.args[0];
+        break;
+    case SequenceEventType::XIECL:
+        trk.pseudoEchoLen = ev.args[0];
+        break;
+    case SequenceEventType::XWAIT:
+        trk.delay = ev.wait;
+        break;
+    case SequenceEventType::NOP:
         break;
-    case 0xCE:
-        // EOT
+    case SequenceEventType::EOT:
         {
-            uint8_t key = rom.ReadU8(trk.pos);
-            if (key >= 0x80) {
-                key = trk.lastNoteKey;
-            } else {
-                trk.pos++;
+            uint8_t key = trk.lastNoteKey;
+            if (ev.argFlags & SequenceEvent::ARG_KEY) {
+                key = ev.args[0];
                 trk.lastNoteKey = key;
             }
+            if (analysis) {
+                const auto it = std::find_if(analysisNotes.begin(), analysisNotes.end(), [&](const AnalysisNote &note) {
+                    return note.trk == &trk && note.key == key;
+                });
+                if (it != analysisNotes.end())
+                    analysisNotes.erase(it);
+            }
             for (MP2KChn *chn = trk.channels; chn != nullptr; chn = chn->next) {
                 assert(chn->trackOrg == &trk);
                 if (chn->envState == EnvState::DEAD)
@@ -642,18 +634,21 @@ void SequenceReader::cmdPlayFine(MP2KTrack &trk)
         chn->RemoveFromTrack();
     }
 
+    if (analysis)
+        std::erase_if(analysisNotes, [&trk](const AnalysisNote &note) { return note.trk == &trk; });
+
     trk.enabled = false;
     trk.activeNotes.reset();
     trk.activeVoiceTypes = VoiceFlags::NONE;
 }
 
-void SequenceReader::cmdPlayMemacc(MP2KTrack &trk)
+void SequenceReader::cmdPlayMemacc(MP2KTrack &trk, const SequenceEvent &ev)
 {
-    const Rom &rom = ctx.rom;
+    const uint8_t op = ev.args[0];
+    uint8_t &memory = ctx.memaccArea[ev.args[1]];
+    const uint8_t data = ev.args[2];
 
-    uint8_t op = rom.ReadU8(trk.pos++);
-    uint8_t &memory = ctx.memaccArea[rom.ReadU8(trk.pos++)];
-    uint8_t data = rom.ReadU8(trk.pos++);
+    bool jump = false;
 
     switch (op) {
     case 0:
@@ -675,151 +670,52 @@ void SequenceReader::cmdPlayMemacc(MP2KTrack &trk)
         memory -= ctx.memaccArea[data];
         return;
     case 6:
-        if (memory == data) {
-            trk.pos = rom.ReadAgbPtrToPos(trk.pos);
-            return;
-        }
+        jump = memory == data;
         break;
     case 7:
-        if (memory != data) {
-            trk.pos = rom.ReadAgbPtrToPos(trk.pos);
-            return;
-        }
+        jump = memory != data;
         break;
     case 8:
-        if (memory > data) {
-            trk.pos = rom.ReadAgbPtrToPos(trk.pos);
-            return;
-        }
+        jump = memory > data;
         break;
     case 9:
-        if (memory >= data) {
-            trk.pos = rom.ReadAgbPtrToPos(trk.pos);
-            return;
-        }
+        jump = memory >= data;
         break;
     case 10:
-        if (memory <= data) {
-            trk.pos = rom.ReadAgbPtrToPos(trk.pos);
-            return;
-        }
+        jump = memory <= data;
         break;
     case 11:
-        if (memory < data) {
-            trk.pos = rom.ReadAgbPtrToPos(trk.pos);
-            return;
-        }
+        jump = memory < data;
         break;
     case 12:
-        if (memory == ctx.memaccArea[data]) {
-            trk.pos = rom.ReadAgbPtrToPos(trk.pos);
-            return;
-        }
+        jump = memory == ctx.memaccArea[data];
         break;
     case 13:
-        if (memory != ctx.memaccArea[data]) {
-            trk.pos = rom.ReadAgbPtrToPos(trk.pos);
-            return;
-        }
+        jump = memory != ctx.memaccArea[data];
         break;
     case 14:
-        if (memory > ctx.memaccArea[data]) {
-            trk.pos = rom.ReadAgbPtrToPos(trk.pos);
-            return;
-        }
+        jump = memory > ctx.memaccArea[data];
         break;
     case 15:
-        if (memory >= ctx.memaccArea[data]) {
-            trk.pos = rom.ReadAgbPtrToPos(trk.pos);
-            return;
-        }
+        jump = memory >= ctx.memaccArea[data];
         break;
     case 16:
-        if (memory <= ctx.memaccArea[data]) {
-            trk.pos = rom.ReadAgbPtrToPos(trk.pos);
-            return;
-        }
+        jump = memory <= ctx.memaccArea[data];
         break;
     case 17:
-        if (memory < ctx.memaccArea[data]) {
-            trk.pos = rom.ReadAgbPtrToPos(trk.pos);
-            return;
-        }
+        jump = memory < ctx.memaccArea[data];
         break;
     default:
         return;
     }
 
-    // only "false" jump commands should come by here
-    trk.pos += 4;
+    // "false" jump commands continue with the next event
+    if (jump)
+        JumpToEvent(trk, ev.target);
 }
 
-void SequenceReader::cmdPlayXCmd(MP2KTrack &trk)
+void SequenceReader::JumpToEvent(MP2KTrack &trk, uint32_t eventIdx)
 {
-    const Rom &rom = ctx.rom;
-
-    uint8_t xCmdNo = rom.ReadU8(trk.pos++);
-
-    switch (xCmdNo) {
-    case 0:
-        // XXX
-        cmdPlayFine(trk);
-        break;
-    case 1:
-        // XWAVE (stub)
-        trk.pos += 4;
-        break;
-    case 2:
-        // XTYPE (stub)
-        trk.pos++;
-        break;
-    case 3:
-        // XXX
-        cmdPlayFine(trk);
-        break;
-    case 4:
-        // XATTA (stub)
-        trk.pos++;
-        break;
-    case 5:
-        // XDECA (stub)
-        trk.pos++;
-        break;
-    case 6:
-        // XSUST (stub)
-        trk.pos++;
-        break;
-    case 7:
-        // XRELA (stub)
-        trk.pos++;
-        break;
-    case 8:
-        // XIECV
-        trk.pseudoEchoVol = rom.ReadU8(trk.pos++);
-        break;
-    case 9:
-        // XIECL
-        trk.pseudoEchoLen = rom.ReadU8(trk.pos++);
-        break;
-    case 10:
-        // XLENG (stub)
-        trk.pos++;
-        break;
-    case 11:
-        // XSWEE (stub)
-        trk.pos++;
-        break;
-    case 12:
-        // XWAIT
-        trk.delay = rom.ReadU16(trk.pos);
-        trk.pos += 2;
-        break;
-    case 13:
-        // XSOFF (stub)
-        trk.pos += 4;
-        break;
-    default:
-        cmdPlayFine(trk);
-        break;
-    }
+    trk.eventIdx = eventIdx;
+    trk.pos = decoder.Get(eventIdx).pos;
 }
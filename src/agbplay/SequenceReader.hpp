@@ -1,16 +1,22 @@
 #pragma once
 
 #include "Constants.hpp"
+#include "InstrumentCache.hpp"
+#include "SequenceDecoder.hpp"
 #include "SoundData.hpp"
 #include "SoundMixer.hpp"
 
-#include <map>
+#include <set>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
 
 struct MP2KContext;
 struct MP2KTrack;
 struct MP2KPlayer;
 struct MP2KChn;
+class StateWriter;
+class StateReader;
 
 class SequenceReader
 {
@@ -24,17 +30,43 @@ public:
     void Restart();
     void SetSpeedFactor(float speedFactor);
     float GetSpeedFactor() const;
+    void SetAnalysis(MP2KSongAnalysis *analysis);
+    /* Hash of all ROM data, which has been used since the analysis was set: song headers, the processed track
+     * data and the instruments (including sample and wave data) of all notes. Data, which has not been used,
+     * cannot change the rendered audio and is therefore not included. */
+    uint64_t AnalysisDataHash();
+    void SaveState(StateWriter &w) const;
+    void LoadState(StateReader &r);
 
 private:
-    static const std::map<uint8_t, uint8_t> delayLut;
-    static const std::map<uint8_t, uint8_t> noteLut;
-
     MP2KContext &ctx;
+    SequenceDecoder decoder;
+    InstrumentCache instruments;
 
     bool endReached = false;
     size_t numLoops = 0;
     float speedFactor = 1.0f;
 
+    /* Analysis (dry run) state. No voices are created if analysis is set. */
+    struct AnalysisNote
+    {
+        const MP2KTrack *trk;
+        uint8_t key;
+        uint8_t length;
+    };
+
+    struct AnalysisTime
+    {
+        size_t tick;
+        size_t sample;
+    };
+
+    MP2KSongAnalysis *analysis = nullptr;
+    std::vector<AnalysisNote> analysisNotes;
+    std::unordered_map<size_t, AnalysisTime> analysisEventTimes;
+    std::set<std::pair<size_t, size_t>> analysisDataRanges;                  // [begin, end) of processed events
+    std::set<std::tuple<size_t, uint8_t, uint8_t>> analysisInstruments;    // bank, program and key of notes
+
     bool PlayerMain(MP2KPlayer &player);
     bool TrackMain(MP2KPlayer &player, MP2KTrack &trk);
     void TrackVolPitchMain(MP2KTrack &trk);
@@ -42,11 +74,13 @@ private:
         TrackVolPitchSet(MP2KTrack &trk, uint16_t vol, int16_t pan, int16_t pitch, bool updateVolume, bool updatePitch);
     int TickTrackNotes(MP2KTrack &trk);
     void AddNoteToState(MP2KTrack &trk, const MP2KChn &chn);
+    AnalysisTime GetAnalysisTime(const MP2KPlayer &player) const;
+    void AnalysisTickNotes(const MP2KTrack &trk);
 
-    void cmdPlayNote(MP2KPlayer &player, MP2KTrack &trk, uint8_t cmd);
-    void cmdPlayCommand(MP2KPlayer &player, MP2KTrack &trk, uint8_t cmd);
+    void cmdPlayNote(MP2KPlayer &player, MP2KTrack &trk, const SequenceEvent &ev);
+    void cmdPlayCommand(MP2KPlayer &player, MP2KTrack &trk, const SequenceEvent &ev);
 
     void cmdPlayFine(MP2KTrack &trk);
-    void cmdPlayMemacc(MP2KTrack &trk);
-    void cmdPlayXCmd(MP2KTrack &trk);
+    void cmdPlayMemacc(MP2KTrack &trk, const SequenceEvent &ev);
+    void JumpToEvent(MP2KTrack &trk, uint32_t eventIdx);
 };
@@ -14,8 +14,11 @@ static const uint32_t DEFAULT_SAMPLERATE = 48000;
 static const int8_t DEFAULT_MAX_LOOPS = 1;
 static const bool DEFAULT_LOOP_INDEFINITELY = false;
 static const uint32_t DEFAULT_BIT_DEPTH = 32;
+static const ExportFormat DEFAULT_EXPORT_FORMAT = ExportFormat::WAV;
 static const uint32_t DEFAULT_NUM_OUTPUT_BUFFERS = 1;
 static const bool DEFAULT_QUICK_EXPORT_ASK = true;
+static const bool DEFAULT_CUT_SILENT_TAIL = true;
+static const double DEFAULT_NORMALIZE_LOUDNESS = -23.0;
 
 void Settings::Load()
 {
@@ -32,6 +35,9 @@ void Settings::Load()
             playbackLoopIndefinitely = DEFAULT_LOOP_INDEFINITELY;
             exportSampleRate = DEFAULT_SAMPLERATE;
             exportBitDepth = DEFAULT_BIT_DEPTH;
+            exportFormat = DEFAULT_EXPORT_FORMAT;
+            exportCutSilentTail = DEFAULT_CUT_SILENT_TAIL;
+            exportNormalizeLoudness = DEFAULT_NORMALIZE_LOUDNESS;
             exportQuickExportDirectory = DEFAULT_EXPORT_DIRECTORY;
             exportQuickExportAsk = DEFAULT_QUICK_EXPORT_ASK;
             return;
@@ -85,6 +91,12 @@ void Settings::Load()
         exportBitDepth = DEFAULT_BIT_DEPTH;
     }
 
+    if (j.contains("exportFormat") && j["exportFormat"].is_string()) {
+        exportFormat = str2exportFormat(j["exportFormat"]);
+    } else {
+        exportFormat = DEFAULT_EXPORT_FORMAT;
+    }
+
     if (j.contains("exportMaxLoops") && j["exportMaxLoops"].is_number()) {
         // Clamp to 0, inifite looping not allowed for export
         exportMaxLoops = std::clamp<int8_t>(j["exportMaxLoops"], 0, 127);
@@ -104,6 +116,36 @@ void Settings::Load()
         exportPadEnd = 0.0;
     }
 
+    if (j.contains("exportCutSilentTail") && j["exportCutSilentTail"].is_boolean()) {
+        exportCutSilentTail = j["exportCutSilentTail"];
+    } else {
+        exportCutSilentTail = DEFAULT_CUT_SILENT_TAIL;
+    }
+
+    if (j.contains("exportStemsSingleFile") && j["exportStemsSingleFile"].is_boolean()) {
+        exportStemsSingleFile = j["exportStemsSingleFile"];
+    } else {
+        exportStemsSingleFile = false;
+    }
+
+    if (j.contains("exportSkipUnchanged") && j["exportSkipUnchanged"].is_boolean()) {
+        exportSkipUnchanged = j["exportSkipUnchanged"];
+    } else {
+        exportSkipUnchanged = false;
+    }
+
+    if (j.contains("exportNormalize") && j["exportNormalize"].is_boolean()) {
+        exportNormalize = j["exportNormalize"];
+    } else {
+        exportNormalize = false;
+    }
+
+    if (j.contains("exportNormalizeLoudness") && j["exportNormalizeLoudness"].is_number()) {
+        exportNormalizeLoudness = std::clamp<double>(j["exportNormalizeLoudness"], -70.0, 0.0);
+    } else {
+        exportNormalizeLoudness = DEFAULT_NORMALIZE_LOUDNESS;
+    }
+
     if (j.contains("exportQuickExportDirectory") && j["exportQuickExportDirectory"].is_string()) {
         const std::string tmp = j["exportQuickExportDirectory"];
         exportQuickExportDirectory = std::u8string(reinterpret_cast<const char8_t *>(tmp.c_str()));
@@ -140,9 +182,15 @@ void Settings::Save()
     j["playbackVolume"] = playbackVolume;
     j["exportSampleRate"] = exportSampleRate;
     j["exportBitDepth"] = exportBitDepth;
+    j["exportFormat"] = exportFormat2str(exportFormat);
     j["exportMaxLoops"] = exportMaxLoops;
     j["exportPadStart"] = exportPadStart;
     j["exportPadEnd"] = exportPadEnd;
+    j["exportCutSilentTail"] = exportCutSilentTail;
+    j["exportStemsSingleFile"] = exportStemsSingleFile;
+    j["exportSkipUnchanged"] = exportSkipUnchanged;
+    j["exportNormalize"] = exportNormalize;
+    j["exportNormalizeLoudness"] = exportNormalizeLoudness;
     j["exportQuickExportDirectory"] = exportQuickExportDirectory;
     j["exportQuickExportAsk"] = exportQuickExportAsk;
     j["lastOpenFileDirectory"] = lastOpenFileDirectory;
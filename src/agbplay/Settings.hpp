@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Types.hpp"
+
 #include <cstdint>
 #include <filesystem>
 #include <memory>
@@ -17,9 +19,15 @@ struct Settings
 
     uint32_t exportSampleRate = 0;
     uint32_t exportBitDepth = 0;
+    ExportFormat exportFormat = ExportFormat::WAV;
     int8_t exportMaxLoops = 0;
     double exportPadStart = 0.0;
     double exportPadEnd = 0.0;
+    bool exportCutSilentTail = true;
+    bool exportStemsSingleFile = false;
+    bool exportSkipUnchanged = false;
+    bool exportNormalize = false;
+    double exportNormalizeLoudness = 0.0;    // LUFS
     std::filesystem::path exportQuickExportDirectory;
     bool exportQuickExportAsk = false;
 
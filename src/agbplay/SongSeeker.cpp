@@ -0,0 +1,125 @@
+#include "SongSeeker.hpp"
+
+#include "Constants.hpp"
+#include "MP2KContext.hpp"
+#include "StateStream.hpp"
+
+#include <algorithm>
+
+/*
+ * public SongSeeker
+ */
+
+SongSeeker::SongSeeker(MP2KContext &ctx, double checkpointInterval) :
+    ctx(ctx), checkpointInterval(checkpointInterval), initialCheckpointInterval(checkpointInterval)
+{
+}
+
+void SongSeeker::Restart()
+{
+    position = 0.0;
+    checkpointInterval = initialCheckpointInterval;
+    checkpoints.clear();
+    SaveCheckpoint();
+}
+
+void SongSeeker::Invalidate()
+{
+    checkpoints.clear();
+}
+
+void SongSeeker::Advance()
+{
+    const double microframeLength =
+        static_cast<double>(ctx.mixer.GetSamplesPerBuffer()) / static_cast<double>(ctx.sampleRate);
+    position += microframeLength * ctx.reader.GetSpeedFactor();
+
+    /* Checkpoints after the song has stopped are not useful. */
+    if (ctx.primaryPlayer >= ctx.players.size() || !ctx.players[ctx.primaryPlayer].playing)
+        return;
+
+    if (!checkpoints.contains(static_cast<size_t>(position / checkpointInterval)))
+        SaveCheckpoint();
+}
+
+bool SongSeeker::Seek(double seconds)
+{
+    seconds = std::max(seconds, 0.0);
+
+    /* The checkpoint within the target interval may still be after the target. */
+    const Checkpoint *checkpoint = nullptr;
+    auto it = checkpoints.upper_bound(static_cast<size_t>(seconds / checkpointInterval));
+    while (it != checkpoints.begin()) {
+        --it;
+        if (it->second.position <= seconds) {
+            checkpoint = &it->second;
+            break;
+        }
+    }
+
+    /* Only restore the checkpoint if it is closer to the target than the current position. */
+    if (checkpoint && (position > seconds || checkpoint->position > position))
+        RestoreCheckpoint(*checkpoint);
+
+    if (position > seconds)
+        return false;
+
+    while (position < seconds && !ctx.SongEnded()) {
+        ctx.m4aSoundMain();
+        Advance();
+    }
+
+    return true;
+}
+
+double SongSeeker::GetPosition() const
+{
+    return position;
+}
+
+/*
+ * private SongSeeker
+ */
+
+void SongSeeker::SaveCheckpoint()
+{
+    if (checkpoints.size() >= SEEK_CHECKPOINT_MAX) {
+        /* Double the interval and only keep the first checkpoint of each new interval. */
+        checkpointInterval *= 2.0;
+        std::map<size_t, Checkpoint> remainingCheckpoints;
+        for (auto &[interval, checkpoint] : checkpoints)
+            remainingCheckpoints.try_emplace(interval / 2, std::move(checkpoint));
+        checkpoints = std::move(remainingCheckpoints);
+    }
+
+    const size_t interval = static_cast<size_t>(position / checkpointInterval);
+    if (checkpoints.contains(interval))
+        return;
+
+    StateWriter w;
+    ctx.SaveState(w);
+    checkpoints.try_emplace(interval, position, std::move(w.GetData()));
+}
+
+void SongSeeker::RestoreCheckpoint(const Checkpoint &checkpoint)
+{
+    /* Muting and the loop count are playback settings, which must not be reverted by seeking. */
+    const int8_t maxLoops = ctx.maxLoops;
+    std::vector<bool> muted;
+    for (const MP2KPlayer &player : ctx.players) {
+        for (const MP2KTrack &trk : player.tracks)
+            muted.push_back(trk.muted);
+    }
+
+    StateReader r(checkpoint.state);
+    ctx.LoadState(r);
+
+    ctx.maxLoops = maxLoops;
+    size_t i = 0;
+    for (MP2KPlayer &player : ctx.players) {
+        for (MP2KTrack &trk : player.tracks)
+            trk.muted = muted.at(i++);
+    }
+
+    position = checkpoint.position;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+struct MP2KContext;
+
+/* SongSeeker allows seeking within the song, which is currently playing in a MP2KContext.
+ * While playing (and while seeking), a checkpoint of the complete engine state is saved in
+ * regular intervals. Seeking restores the closest checkpoint before the target position and
+ * then only renders the remaining part. Positions are in seconds of song time, i.e. playing
+ * at double speed advances the position twice as fast. */
+class SongSeeker
+{
+public:
+    SongSeeker(MP2KContext &ctx, double checkpointInterval);
+    SongSeeker(const SongSeeker &) = delete;
+    SongSeeker &operator=(const SongSeeker &) = delete;
+
+    /* Restart has to be called when a song is (re)started. Invalidate has to be called if the
+     * sound mode is changed, as existing checkpoints then can no longer be restored. */
+    void Restart();
+    void Invalidate();
+
+    /* Advance has to be called after each m4aSoundMain to keep track of the song position. */
+    void Advance();
+
+    /* Returns false if the position could not be reached because it is before the current position
+     * and no checkpoint is available. In that case the song has to be restarted. */
+    bool Seek(double seconds);
+    double GetPosition() const;
+
+private:
+    struct Checkpoint
+    {
+        double position;
+        std::vector<uint8_t> state;
+    };
+
+    void SaveCheckpoint();
+    void RestoreCheckpoint(const Checkpoint &checkpoint);
+
+    MP2KContext &ctx;
+    double checkpointInterval;
+    const double initialCheckpointInterval;
+    double position = 0.0;
+
+    /* key is the index of the checkpoint interval */
+    std::map<size_t, Checkpoint> checkpoints;
+};
@@ -2,22 +2,120 @@
 
 #include "Constants.hpp"
 #include "Debug.hpp"
+#include "ExportFile.hpp"
+#include "ExportWriter.hpp"
+#include "LoudnessMeter.hpp"
 #include "MP2KContext.hpp"
 #include "OS.hpp"
 #include "Profile.hpp"
+#include "RenderProfiler.hpp"
 #include "Settings.hpp"
+#include "StateStream.hpp"
 #include "Util.hpp"
+#include "Version.hpp"
 #include "Xcept.hpp"
 
+#include <algorithm>
 #include <atomic>
 #include <boost/algorithm/string/replace.hpp>
+#include <cassert>
 #include <chrono>
 #include <climits>
+#include <cstdlib>
 #include <cmath>
+#include <cstdio>
 #include <filesystem>
+#include <limits>
+#include <memory>
 #include <mutex>
 #include <sndfile.h>
 #include <thread>
+#include <zlib.h>
+
+/* Returns the libsndfile format for the export settings. Bit depths, which are not supported by a format, are
+ * replaced by the closest supported one. Lossy formats ignore the bit depth. */
+static int sndfileFormat(ExportFormat format, uint32_t bitDepth)
+{
+    if (format == ExportFormat::FLAC) {
+        if (bitDepth == 8)
+            return SF_FORMAT_FLAC | SF_FORMAT_PCM_S8;
+        else if (bitDepth == 16)
+            return SF_FORMAT_FLAC | SF_FORMAT_PCM_16;
+        else
+            return SF_FORMAT_FLAC | SF_FORMAT_PCM_24;
+    } else if (format == ExportFormat::VORBIS) {
+        return SF_FORMAT_OGG | SF_FORMAT_VORBIS;
+    } else if (format == ExportFormat::OPUS) {
+        return SF_FORMAT_OGG | SF_FORMAT_OPUS;
+    }
+
+    if (bitDepth == 8)
+        return SF_FORMAT_WAV | SF_FORMAT_PCM_U8;
+    else if (bitDepth == 16)
+        return SF_FORMAT_WAV | SF_FORMAT_PCM_24;
+    else if (bitDepth == 24)
+        return SF_FORMAT_WAV | SF_FORMAT_PCM_24;
+    else
+        return SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+}
+
+static std::string manifestSongName(const std::filesystem::path &filePath)
+{
+    const std::u8string name = filePath.filename().u8string();
+    return std::string(reinterpret_cast<const char *>(name.data()), name.size());
+}
+
+/* Owns the output files of a song. Files, which have not been closed because of an error or cancellation, are
+ * discarded before they are destroyed, so the writer threads cannot access them anymore. The incomplete files
+ * are removed afterwards. */
+class ExportFiles
+{
+public:
+    ExportFiles(ExportWriter &writer) : writer(writer) {}
+    ExportFiles(const ExportFiles &) = delete;
+    ExportFiles &operator=(const ExportFiles &) = delete;
+
+    ~ExportFiles()
+    {
+        for (std::unique_ptr<ExportFile> &file : files)
+            writer.Discard(*file);
+
+        if (closed)
+            return;
+
+        files.clear();
+        for (const std::filesystem::path &filePath : filePaths) {
+            std::error_code ec;
+            std::filesystem::remove(filePath, ec);
+        }
+    }
+
+    /* filePath is empty for files, which are not located on disk */
+    ExportFile &Add(std::unique_ptr<ExportFile> file, const std::filesystem::path &filePath)
+    {
+        if (!filePath.empty())
+            filePaths.emplace_back(filePath);
+        return *files.emplace_back(std::move(file));
+    }
+
+    void CloseAll()
+    {
+        /* let the writer threads finish all files in parallel */
+        for (std::unique_ptr<ExportFile> &file : files)
+            writer.StartClose(*file);
+        for (std::unique_ptr<ExportFile> &file : files)
+            writer.Close(*file);
+        closed = true;
+    }
+
+    const std::vector<std::filesystem::path> &GetFilePaths() const { return filePaths; }
+
+private:
+    ExportWriter &writer;
+    std::vector<std::unique_ptr<ExportFile>> files;
+    std::vector<std::filesystem::path> filePaths;
+    bool closed = false;
+};
 
 /*
  * public SoundExporter
@@ -26,6 +124,7 @@
 const std::filesystem::path SoundExporter::SONG_NAME_PATTERN = "\%SONGNAME\%";
 const std::filesystem::path SoundExporter::SONG_ID_PATTERN = "\%SONGID\%";
 const std::filesystem::path SoundExporter::TRACK_ID_PATTERN = "\%TRACKID\%";
+const std::filesystem::path SoundExporter::STDOUT_PATH = "-";
 
 SoundExporter::SoundExporter(
     const std::filesystem::path &directory,
@@ -33,9 +132,27 @@ SoundExporter::SoundExporter(
     const Settings &settings,
     const Profile &profile,
     bool benchmarkOnly,
-    bool seperate
+    bool seperate,
+    StreamFormat streamFormat
 ) :
-    directory(directory), filePaths(filePaths), settings(settings), profile(profile), benchmarkOnly(benchmarkOnly), seperate(seperate)
+    directory(directory),
+    filePaths(filePaths),
+    settings(settings),
+    profile(profile),
+    benchmarkOnly(benchmarkOnly),
+    seperate(seperate),
+    streaming(filePaths.size() == 1 && filePaths.front() == STDOUT_PATH),
+    streamFormat(streamFormat),
+    songProgress(profile.playlist.size()),
+    songLoudness(profile.playlist.size()),
+    songFiles(profile.playlist.size()),
+    songSeconds(profile.playlist.size()),
+    songKeys(profile.playlist.size()),
+    songManifests(profile.playlist.size())
+#ifdef AGBPLAY_RENDER_PROFILING
+    ,
+    renderProfiles(profile.playlist.size())
+#endif
 {
 }
 
@@ -44,6 +161,30 @@ void SoundExporter::Export()
     if (filePaths.size() != 0 && filePaths.size() != profile.playlist.size())
         throw Xcept("Number of provided output paths must be equal to the number of songs to export");
 
+    if (streaming) {
+        if (profile.playlist.size() != 1)
+            throw Xcept("Only a single song can be written to stdout");
+        if (seperate)
+            throw Xcept("Stems cannot be written to stdout");
+    } else if (!benchmarkOnly) {
+        /* Opus is limited to a few samplerates, which is only detected by libsndfile when the file is opened. */
+        const uint32_t rate = settings.exportSampleRate;
+        if (settings.exportFormat == ExportFormat::OPUS && rate != 8000 && rate != 12000 && rate != 16000
+            && rate != 24000 && rate != 48000)
+            throw Xcept("Opus export only supports samplerates of 8, 12, 16, 24 and 48 kHz");
+
+        SF_INFO info{};
+        info.samplerate = static_cast<int>(rate);
+        info.channels = 2;
+        info.format = sndfileFormat(settings.exportFormat, settings.exportBitDepth);
+        if (!sf_format_check(&info))
+            throw Xcept("Export format {} is not supported by libsndfile", exportFormat2str(settings.exportFormat));
+
+        /* FLAC is limited to 8 channels and the lossy codecs are not suited for editing stems */
+        if (seperate && settings.exportStemsSingleFile && settings.exportFormat != ExportFormat::WAV)
+            throw Xcept("Exporting stems to a single file is only supported for WAV");
+    }
+
     if (!benchmarkOnly && filePaths.size() == 0) {
         /* create directories for file export */
         if (std::filesystem::exists(directory)) {
@@ -55,84 +196,396 @@ void SoundExporter::Export()
         }
     }
 
+    startTime = std::chrono::steady_clock::now();
+
+    /* Songs are rendered longest first. Otherwise a long song, which is started last, may keep a single thread
+     * busy while all other threads are already done. */
+    estimateSongs();
+
+    if (!benchmarkOnly && !streaming && settings.exportSkipUnchanged)
+        loadManifests();
+
+    std::vector<size_t> songOrder;
+    for (size_t i = 0; i < profile.playlist.size(); i++) {
+        if (songProgress[i].state != ExportProgress::SongState::SKIPPED)
+            songOrder.emplace_back(i);
+    }
+    std::stable_sort(songOrder.begin(), songOrder.end(), [this](size_t a, size_t b) {
+        return songProgress[a].samplesEstimated > songProgress[b].samplesEstimated;
+    });
+
+    size_t numThreads = std::thread::hardware_concurrency();
+    if (numThreads == 0)
+        numThreads = 1;
+
+    /* Encoding and writing the files happens on separate threads, so rendering does not wait for I/O.
+     * Compressed formats take considerably more CPU time to encode, so they get more threads. */
+    std::unique_ptr<ExportWriter> writer;
+    if (!benchmarkOnly) {
+        size_t numWriterThreads =
+            settings.exportFormat == ExportFormat::WAV ? std::max<size_t>(numThreads / 2, 1) : numThreads;
+        if (streaming)
+            numWriterThreads = 1;
+        writer = std::make_unique<ExportWriter>(numWriterThreads, EXPORT_BLOCK_SIZE, EXPORT_MAX_QUEUED_BLOCKS);
+    }
+
     /* setup export thread worker function */
     std::atomic<size_t> currentSong = 0;
-    std::atomic<size_t> totalSamplesRendered = 0;
-    std::atomic<bool> cancel = false;
+    std::atomic<bool> failed = false;
 
     std::function<void(void)> threadFunc = [&]() {
         OS::LowerThreadPriority();
         while (!cancel) {
-            const size_t i = currentSong++;    // atomic ++
-            if (i >= profile.playlist.size())
+            const size_t n = currentSong++;    // atomic ++
+            if (n >= songOrder.size())
                 return;
 
+            const size_t i = songOrder[n];
+            SongProgress &progress = songProgress[i];
+            progress.state = ExportProgress::SongState::RENDERING;
+
             try {
                 const std::filesystem::path filePathPatt = (i >= filePaths.size()) ? "" : filePaths.at(i);
-                totalSamplesRendered += exportSong(filePathPatt, i);
+                Debug::print("{:3}% - Rendering to file: \"{}\"",
+                    (n + 1) * 100 / songOrder.size(),
+                    makeFilePath(filePathPatt, i, std::numeric_limits<size_t>::max()).string()
+                );
+#ifdef AGBPLAY_RENDER_PROFILING
+                RenderProfiler profiler;
+                profiler.Start(static_cast<size_t>(
+                    static_cast<double>(progress.samplesEstimated) * AGB_EXACT_FPS / settings.exportSampleRate
+                ));
+#endif
+                const auto songStartTime = std::chrono::steady_clock::now();
+                const bool completed = exportSong(filePathPatt, i, writer.get());
+                songSeconds[i] =
+                    std::chrono::duration<double>(std::chrono::steady_clock::now() - songStartTime).count();
+#ifdef AGBPLAY_RENDER_PROFILING
+                profiler.Stop();
+                RenderProfile &renderProfile = renderProfiles[i];
+                renderProfile = profiler.GetProfile();
+                renderProfile.name = profile.playlist.at(i).name;
+                renderProfile.songId = profile.playlist.at(i).id;
+                renderProfile.samples = progress.samplesRendered;
+#endif
+                if (completed) {
+                    progress.samplesEstimated = progress.samplesRendered.load();
+                    progress.state = ExportProgress::SongState::DONE;
+                } else {
+                    progress.state = ExportProgress::SongState::CANCELLED;
+                }
             } catch (std::exception &e) {
-                Debug::print("Exception while exporting song '{}' (playlist_idx={} id={}):\n{}", profile.playlist.at(i).name, i, profile.playlist.at(i).id, e.what());
+                Debug::print(
+                    "Exception while exporting song '{}' (playlist_idx={} id={}):\n{}",
+                    profile.playlist.at(i).name,
+                    i,
+                    profile.playlist.at(i).id,
+                    e.what()
+                );
+                progress.state = ExportProgress::SongState::FAILED;
+                failed = true;
                 cancel = true;
             }
         }
     };
 
     /* run the actual export threads */
-    auto startTime = std::chrono::high_resolution_clock::now();
+    renderStartTime = std::chrono::steady_clock::now();
 
-    size_t numThreads = std::thread::hardware_concurrency();
-    if (numThreads == 0)
-        numThreads = 1;
     std::vector<std::thread> workers;
     for (size_t i = 0; i < numThreads; i++)
         workers.emplace_back(threadFunc);
     for (auto &w : workers)
         w.join();
     workers.clear();
+    writer.reset();
+
+    for (SongProgress &progress : songProgress) {
+        if (progress.state == ExportProgress::SongState::QUEUED)
+            progress.state = ExportProgress::SongState::CANCELLED;
+    }
+    finished = true;
+
+    /* Songs, which have been exported completely, are recorded even if the export was cancelled. */
+    for (auto &[manifestDirectory, manifest] : manifests)
+        manifest->Save();
+
+#ifdef AGBPLAY_RENDER_PROFILING
+    /* only completed songs are reported, partial songs would skew the totals */
+    std::vector<RenderProfile> completedProfiles;
+    for (size_t i = 0; i < songProgress.size(); i++) {
+        if (songProgress[i].state == ExportProgress::SongState::DONE)
+            completedProfiles.emplace_back(renderProfiles[i]);
+    }
+    RenderProfiler::PrintReport(completedProfiles);
+    if (const char *profilePath = std::getenv("AGBPLAY_PROFILE_JSON"))
+        RenderProfiler::SaveReport(profilePath, completedProfiles);
+#endif
+
+    size_t totalSamplesRendered = 0;
+    size_t songsDone = 0;
+    size_t songsSkipped = 0;
+    for (const SongProgress &progress : songProgress) {
+        totalSamplesRendered += progress.samplesRendered;
+        if (progress.state == ExportProgress::SongState::DONE)
+            songsDone++;
+        else if (progress.state == ExportProgress::SongState::SKIPPED)
+            songsSkipped++;
+    }
+
+    if (songsSkipped > 0)
+        Debug::print("Skipped {} unchanged songs", songsSkipped);
+
+    /* the loudness is not measured in benchmarks */
+    for (size_t i = 0; i < songProgress.size() && !benchmarkOnly; i++) {
+        if (songProgress[i].state != ExportProgress::SongState::DONE)
+            continue;
+
+        const SongLoudness &loudness = songLoudness[i];
+        std::string gain;
+        if (settings.exportNormalize)
+            gain = fmt::format(", gain {:+.1f} dB", loudness.gain);
+        Debug::print(
+            "Loudness of '{}': {:.1f} LUFS, true peak {:.1f} dBTP{}",
+            profile.playlist.at(i).name,
+            loudness.integrated,
+            loudness.truePeak,
+            gain
+        );
+    }
 
-    auto endTime = std::chrono::high_resolution_clock::now();
+    const auto endTime = std::chrono::steady_clock::now();
+    const auto renderStart = renderStartTime.load();
 
     /* report finished progress */
-    if (std::chrono::duration_cast<std::chrono::seconds>(endTime - startTime).count() == 0) {
-        Debug::print("Successfully wrote {} files", profile.playlist.size());
+    if (std::chrono::duration_cast<std::chrono::seconds>(endTime - renderStart).count() == 0) {
+        Debug::print("Successfully wrote {} files", songsDone);
     } else {
         const uint64_t secondsTotal =
-            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(endTime - startTime).count());
+            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(endTime - renderStart).count());
         const uint64_t microSecondsTotal =
-            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count());
+            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(endTime - renderStart).count());
         const uint64_t samplesPerSecond = totalSamplesRendered * 1000000 / microSecondsTotal;
         Debug::print(
             "Successfully wrote {} files at {} samples per second ({} seconds total)",
-            profile.playlist.size(),
+            songsDone,
             samplesPerSecond,
             secondsTotal
         );
     }
 
-    if (cancel)
+    if (failed)
         Debug::print("Export operation was cancelled. Please check the log for errors!");
+    else if (cancel)
+        Debug::print("Export operation was cancelled");
+}
+
+ExportProgress SoundExporter::GetProgress() const
+{
+    ExportProgress result;
+    result.analyzing = analyzing;
+    result.finished = finished;
+
+    for (const SongProgress &progress : songProgress) {
+        ExportProgress::Song &song = result.songs.emplace_back();
+        song.state = progress.state;
+        song.samplesRendered = progress.samplesRendered;
+        song.samplesEstimated = progress.samplesEstimated;
+
+        if (song.state == ExportProgress::SongState::DONE || song.state == ExportProgress::SongState::SKIPPED)
+            result.songsDone++;
+        result.samplesRendered += song.samplesRendered;
+        result.samplesEstimated += std::max(song.samplesRendered, song.samplesEstimated);
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const auto exportStartTime = startTime.load();
+    const auto exportRenderStartTime = renderStartTime.load();
+    if (exportStartTime == std::chrono::steady_clock::time_point{})
+        return result;
+
+    result.secondsElapsed = std::chrono::duration<double>(now - exportStartTime).count();
+
+    /* The remaining time is extrapolated from the total rendering speed so far. */
+    if (exportRenderStartTime == std::chrono::steady_clock::time_point{} || result.samplesRendered == 0)
+        return result;
+
+    const double secondsRendering = std::chrono::duration<double>(now - exportRenderStartTime).count();
+    const double samplesPerSecond = static_cast<double>(result.samplesRendered) / secondsRendering;
+    result.secondsRemaining =
+        static_cast<double>(result.samplesEstimated - result.samplesRendered) / samplesPerSecond;
+    if (result.finished)
+        result.secondsRemaining = 0.0;
+
+    return result;
+}
+
+std::vector<ExportResult> SoundExporter::GetResults() const
+{
+    assert(finished);
+
+    std::vector<ExportResult> results(profile.playlist.size());
+    for (size_t i = 0; i < results.size(); i++) {
+        ExportResult &result = results[i];
+        result.state = songProgress[i].state;
+        result.samplesRendered = songProgress[i].samplesRendered;
+        result.secondsRendering = songSeconds[i];
+        result.loudness = songLoudness[i].integrated;
+        result.truePeak = songLoudness[i].truePeak;
+        result.gain = songLoudness[i].gain;
+
+        if (result.state == ExportProgress::SongState::SKIPPED) {
+            const std::filesystem::path filePathPatt = (i >= filePaths.size()) ? "" : filePaths.at(i);
+            const std::filesystem::path filePath = makeFilePath(filePathPatt, i, std::numeric_limits<size_t>::max());
+            result.files = songManifests[i]->GetFiles(manifestSongName(filePath));
+        } else {
+            result.files = songFiles[i];
+        }
+    }
+    return results;
+}
+
+void SoundExporter::Cancel()
+{
+    cancel = true;
+}
+
+std::string SoundExporter::GetFileExtension(ExportFormat format)
+{
+    if (format == ExportFormat::FLAC)
+        return "flac";
+    else if (format == ExportFormat::VORBIS)
+        return "ogg";
+    else if (format == ExportFormat::OPUS)
+        return "opus";
+    return "wav";
+}
+
+size_t SoundExporter::GetShard(uint16_t songId, size_t shardCount)
+{
+    assert(shardCount > 0);
+
+    /* The ID is mixed (SplitMix64 finalizer), so consecutive IDs are spread evenly. */
+    uint64_t x = songId;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    x = x ^ (x >> 31);
+    return static_cast<size_t>(x % shardCount);
 }
 
 /*
  * private SoundExporter
  */
 
-void SoundExporter::writeSilence(SNDFILE *ofile, double seconds)
+void SoundExporter::estimateSongs()
+{
+    /* Only the sequencer is run, which takes a small fraction of the rendering time. Songs, which cannot be
+     * analyzed, are estimated as 0 and will report their error when they are rendered. */
+    analyzing = true;
+
+    ParallelForChunks(0, profile.playlist.size(), 1, [this](size_t begin, size_t end) {
+        MP2KContext ctx(
+            settings.exportSampleRate,
+            settings.exportMaxLoops,
+            Rom::Instance(),
+            profile.mp2kSoundModePlayback,
+            profile.agbplaySoundMode,
+            profile.songTableInfoPlayback,
+            profile.playerTablePlayback
+        );
+
+        for (size_t i = begin; i < end && !cancel; i++) {
+            try {
+                const MP2KSongAnalysis analysis = ctx.AnalyzeSong(profile.playlist.at(i).id);
+                songProgress[i].samplesEstimated = analysis.totalSamples;
+                songKeys[i] = songKey(analysis.dataHash);
+            } catch (std::exception &) {
+                songProgress[i].samplesEstimated = 0;
+                songKeys[i] = 0;
+            }
+        }
+    });
+
+    analyzing = false;
+}
+
+uint64_t SoundExporter::songKey(uint64_t dataHash) const
+{
+    /* Everything the exported files depend on. The version is included, since any change of the sound engine
+     * may change the output. */
+    const AgbplaySoundMode &mode = profile.agbplaySoundMode;
+    StateWriter w;
+    w.WriteString(GIT_VERSION_STRING);
+    w.Write(dataHash);
+    w.Write(profile.mp2kSoundModePlayback);
+    w.Write(mode.resamplerTypeNormal);
+    w.Write(mode.resamplerTypeFixed);
+    w.Write(mode.reverbType);
+    w.Write(mode.reverbForce);
+    w.Write(mode.cgbPolyphony);
+    w.Write(mode.dmaBufferLen);
+    w.Write(mode.accurateCh3Quantization);
+    w.Write(mode.accurateCh3Volume);
+    w.Write(mode.emulateCgbSustainBug);
+    w.WriteVector(profile.playerTablePlayback);
+    w.Write(settings.exportSampleRate);
+    w.Write(settings.exportBitDepth);
+    w.Write(settings.exportFormat);
+    w.Write(settings.exportMaxLoops);
+    w.Write(settings.exportPadStart);
+    w.Write(settings.exportPadEnd);
+    w.Write(settings.exportCutSilentTail);
+    w.Write(settings.exportStemsSingleFile);
+    w.Write(settings.exportNormalize);
+    w.Write(settings.exportNormalizeLoudness);
+    w.Write(seperate);
+
+    const std::vector<uint8_t> &data = w.GetData();
+    const uLong crc = crc32_z(crc32_z(0, nullptr, 0), data.data(), data.size());
+    const uLong adler = adler32_z(adler32_z(0, nullptr, 0), data.data(), data.size());
+    return (static_cast<uint64_t>(crc & 0xFFFFFFFF) << 32) | static_cast<uint64_t>(adler & 0xFFFFFFFF);
+}
+
+void SoundExporter::loadManifests()
+{
+    /* There is one manifest per output directory, songs are identified by their file name. */
+    for (size_t i = 0; i < profile.playlist.size(); i++) {
+        const std::filesystem::path filePathPatt = (i >= filePaths.size()) ? "" : filePaths.at(i);
+        const std::filesystem::path filePath = makeFilePath(filePathPatt, i, std::numeric_limits<size_t>::max());
+
+        std::unique_ptr<ExportManifest> &manifest = manifests[filePath.parent_path()];
+        if (!manifest)
+            manifest = std::make_unique<ExportManifest>(filePath.parent_path());
+        songManifests[i] = manifest.get();
+
+        if (manifest->IsUpToDate(manifestSongName(filePath), songKeys[i])) {
+            songProgress[i].state = ExportProgress::SongState::SKIPPED;
+            songProgress[i].samplesEstimated = 0;
+        }
+    }
+}
+
+size_t SoundExporter::silenceFrames(double seconds) const
 {
     if (seconds <= 0.0)
-        return;
-    const size_t samples = static_cast<size_t>(std::round(settings.exportSampleRate * seconds));
-    std::vector<sample> silence(samples, {0.0f, 0.0f});
-    sf_writef_float(ofile, reinterpret_cast<float *>(silence.data()), static_cast<sf_count_t>(silence.size()));
+        return 0;
+    return static_cast<size_t>(std::round(settings.exportSampleRate * seconds));
 }
 
-size_t SoundExporter::exportSong(const std::filesystem::path &filePathPatt, size_t playlistIndex)
+double SoundExporter::normalizeGain(const LoudnessMeter &meter) const
 {
-    Debug::print("{:3}% - Rendering to file: \"{}\"",
-        (playlistIndex + 1) * 100 / profile.playlist.size(),
-        makeFilePath(filePathPatt, playlistIndex, std::numeric_limits<size_t>::max()).string()
+    /* silent songs are left as they are */
+    const double integrated = meter.GetIntegratedLoudness();
+    if (integrated == LoudnessMeter::SILENCE)
+        return 0.0;
+
+    return std::min(
+        settings.exportNormalizeLoudness - integrated, EXPORT_NORMALIZE_MAX_TRUE_PEAK - meter.GetTruePeak()
     );
+}
 
+bool SoundExporter::exportSong(const std::filesystem::path &filePathPatt, size_t playlistIndex, ExportWriter *writer)
+{
     MP2KContext ctx(
         settings.exportSampleRate,
         settings.exportMaxLoops,
@@ -143,6 +596,10 @@ size_t SoundExporter::exportSong(const std::filesystem::path &filePathPatt, size
         profile.playerTablePlayback
     );
 
+    /* Without stems, the per-track signals are never used. Save some CPU by using a single reverb. */
+    if (!seperate)
+        ctx.mixer.SetReverbBusMode(true);
+
     const uint16_t songId = profile.playlist.at(playlistIndex).id;
 
     ctx.m4aSongNumStart(songId);
@@ -154,149 +611,235 @@ size_t SoundExporter::exportSong(const std::filesystem::path &filePathPatt, size
     const double padSecondsStart = settings.exportPadStart;
     const double padSecondsEnd = settings.exportPadEnd;
 
-    int bitDepth;
-    if (settings.exportBitDepth == 8) {
-        bitDepth = SF_FORMAT_PCM_U8;
-    } else if (settings.exportBitDepth == 16) {
-        bitDepth = SF_FORMAT_PCM_24;
-    } else if (settings.exportBitDepth == 24) {
-        bitDepth = SF_FORMAT_PCM_24;
-    } else {
-        bitDepth = SF_FORMAT_FLOAT;
-    }
+    /* Stop rendering as soon as nothing audible is left instead of waiting for the fade out to finish. */
+    auto songEnded = [&]() {
+        return ctx.SongEnded() || (settings.exportCutSilentTail && ctx.SongTailSilent());
+    };
+
+    /* Has to be called after each rendered microframe. Returns false if the export has been cancelled. */
+    SongProgress &progress = songProgress.at(playlistIndex);
+    LoudnessMeter meter(settings.exportSampleRate);
+    auto advance = [&]() {
+        if (!benchmarkOnly)
+            meter.Process(ctx.masterAudioBuffer);
+        samplesRendered += samplesPerBuffer;
+        progress.samplesRendered.store(samplesRendered, std::memory_order_relaxed);
+        return !cancel.load(std::memory_order_relaxed);
+    };
+
+    const int format = sndfileFormat(settings.exportFormat, settings.exportBitDepth);
+
+    auto bufferSamples = [](std::span<const sample> buffer) {
+        return std::span<const float>(&buffer[0].left, buffer.size() * 2);
+    };
+
+    /* The song's files are about to be replaced, so its old manifest entry is not valid anymore. */
+    ExportManifest *manifest = songManifests.at(playlistIndex);
+    const std::filesystem::path songFilePath =
+        manifest ? makeFilePath(filePathPatt, playlistIndex, std::numeric_limits<size_t>::max()) : "";
+    if (manifest)
+        manifest->Remove(manifestSongName(songFilePath));
 
     if (!benchmarkOnly) {
-        bool closeFailed = false;
+        assert(writer);
+        ExportFiles ofiles(*writer);
+
+        /* With normalization, the files are written after the song's loudness is known */
+        std::vector<SpoolExportFile *> spools;
+        auto addFile = [&](std::unique_ptr<ExportFile> file, const std::filesystem::path &filePath) -> ExportFile & {
+            if (!settings.exportNormalize)
+                return ofiles.Add(std::move(file), filePath);
+
+            auto spool = std::make_unique<SpoolExportFile>(std::move(file));
+            spools.emplace_back(spool.get());
+            return ofiles.Add(std::move(spool), filePath);
+        };
 
-        auto sndfileDeleter = [&closeFailed] (SNDFILE *f) {
-            int err = sf_close(f);
-            if (err != SF_ERR_NO_ERROR) {
-                Debug::print("Unable to close file: {}", sf_error_number(err));
-                closeFailed = true;
+        /* A song without tracks has no stems. Rather than creating a file without channels (which libsndfile
+         * rejects), it is handled like separate stems, which creates no files at all. */
+        if (seperate && settings.exportStemsSingleFile && nTracks > 0) {
+            /* Save all tracks interleaved to a single file with two channels per track. This avoids a huge amount
+             * of files and small writes for songs with many tracks. */
+            std::vector<std::string> channelNames;
+            for (size_t i = 0; i < nTracks; i++) {
+                channelNames.emplace_back(std::format("Track {:02d} L", i));
+                channelNames.emplace_back(std::format("Track {:02d} R", i));
             }
-        };
 
-        if (seperate) {
-            /* save each track to a separate file */
-            std::vector<std::unique_ptr<SNDFILE, decltype(sndfileDeleter)>> ofiles;
-            std::vector<SF_INFO> oinfos;
+            const auto finalFilePath = makeFilePath(filePathPatt, playlistIndex);
+            const int stemsFormat = (format & ~SF_FORMAT_TYPEMASK) | SF_FORMAT_RF64;
+            ExportFile &ofile = addFile(
+                std::make_unique<SndfileExportFile>(
+                    finalFilePath, stemsFormat, settings.exportSampleRate, channelNames.size(), channelNames
+                ),
+                finalFilePath
+            );
 
-            for (size_t i = 0; i < nTracks; i++) {
-                oinfos.emplace_back();
-
-                memset(&oinfos[i], 0, sizeof(oinfos[i]));
-                oinfos[i].samplerate = static_cast<int>(settings.exportSampleRate);
-                oinfos[i].channels = 2;    // stereo
-                oinfos[i].format = SF_FORMAT_WAV | bitDepth;
-                const auto finalFilePath = makeFilePath(filePathPatt, playlistIndex, i);
-
-#ifdef _WIN32
-                SNDFILE *sndfile = sf_wchar_open(finalFilePath.wstring().c_str(), SFM_WRITE, &oinfos[i]);
-#else
-                SNDFILE *sndfile = sf_open(finalFilePath.string().c_str(), SFM_WRITE, &oinfos[i]);
-#endif
-                if (sndfile == NULL)
-                    throw Xcept("Failed to open file for export: {}", sf_strerror(nullptr));
+            std::vector<float> stemsBuffer(samplesPerBuffer * channelNames.size());
+            while (true) {
+                ctx.m4aSoundMain();
+                if (songEnded())
+                    break;
 
-                if (bitDepth != SF_FORMAT_FLOAT)
-                    sf_command(sndfile, SFC_SET_CLIPPING, NULL, SF_TRUE);
+                assert(ctx.players.at(playerIdx).tracks.size() == nTracks);
 
-                ofiles.emplace_back(sndfile, sndfileDeleter);
+                {
+                    PROFILE_STAGE(FILE_IO);
+                    for (size_t i = 0; i < nTracks; i++) {
+                        const MP2KTrack &trk = ctx.players.at(playerIdx).tracks.at(i);
+                        assert(trk.audioBuffer.size() == samplesPerBuffer);
+                        for (size_t j = 0; j < samplesPerBuffer; j++) {
+                            stemsBuffer[(j * nTracks + i) * 2 + 0] = trk.audioBuffer[j].left;
+                            stemsBuffer[(j * nTracks + i) * 2 + 1] = trk.audioBuffer[j].right;
+                        }
+                    }
+                    writer->Write(ofile, stemsBuffer);
+                }
+
+                if (!advance())
+                    return false;
             }
+        } else if (seperate) {
+            /* Save each track to a separate file. A file is only created once its track becomes audible, so
+             * tracks, which never make a sound (e.g. tracks only setting state or muted voices), are dropped. */
+            std::vector<ExportFile *> trackFiles(nTracks, nullptr);
+            std::vector<size_t> trackSilentFrames(nTracks, 0);
 
             while (true) {
                 ctx.m4aSoundMain();
-                if (ctx.SongEnded())
+                if (songEnded())
                     break;
 
                 assert(ctx.players.at(playerIdx).tracks.size() == nTracks);
 
-                for (size_t i = 0; i < nTracks; i++) {
-                    sf_count_t processed = sf_writef_float(
-                        ofiles[i].get(),
-                        &ctx.players.at(playerIdx).tracks.at(i).audioBuffer[0].left,
-                        sf_count_t(samplesPerBuffer)
-                    );
-
-                    if (processed < sf_count_t(samplesPerBuffer))
-                        throw Xcept("sf_writef_float failed: {}", sf_strerror(ofiles[i].get()));
+                {
+                    PROFILE_STAGE(FILE_IO);
+                    for (size_t i = 0; i < nTracks; i++) {
+                        const MP2KTrack &trk = ctx.players.at(playerIdx).tracks.at(i);
+                        if (!trackFiles[i]) {
+                            /* Only exact zeros are silent: no sample is smaller than denorm_min in magnitude */
+                            if (IsBufferSilent(trk.audioBuffer, std::numeric_limits<float>::denorm_min())) {
+                                trackSilentFrames[i] += trk.audioBuffer.size();
+                                continue;
+                            }
+
+                            const auto finalFilePath = makeFilePath(filePathPatt, playlistIndex, i);
+                            auto file = std::make_unique<SndfileExportFile>(
+                                finalFilePath, format, settings.exportSampleRate, 2
+                            );
+                            trackFiles[i] = &addFile(std::move(file), finalFilePath);
+                            writer->WriteSilence(*trackFiles[i], trackSilentFrames[i]);
+                        }
+                        writer->Write(*trackFiles[i], bufferSamples(trk.audioBuffer));
+                    }
                 }
 
-                samplesRendered += samplesPerBuffer;
+                if (!advance())
+                    return false;
             }
-        } else {
-            SF_INFO oinfo;
-            memset(&oinfo, 0, sizeof(oinfo));
-            oinfo.samplerate = static_cast<int>(settings.exportSampleRate);
-            oinfo.channels = 2;    // sterep
-            oinfo.format = SF_FORMAT_WAV | bitDepth;
-            const auto finalFilePath = makeFilePath(filePathPatt, playlistIndex);
-#ifdef _WIN32
-            SNDFILE *sndfile = sf_wchar_open(finalFilePath.wstring().c_str(), SFM_WRITE, &oinfo);
-#else
-            SNDFILE *sndfile = sf_open(finalFilePath.string().c_str(), SFM_WRITE, &oinfo);
-#endif
-            if (sndfile == NULL)
-                throw Xcept("Failed to open file for export: {}", sf_strerror(nullptr));
-
-            if (bitDepth != SF_FORMAT_FLOAT)
-                sf_command(sndfile, SFC_SET_CLIPPING, NULL, SF_TRUE);
 
-            std::unique_ptr<SNDFILE, decltype(sndfileDeleter)> ofile(sndfile, sndfileDeleter);
+            const size_t silentTracks = static_cast<size_t>(std::count(trackFiles.begin(), trackFiles.end(), nullptr));
+            if (silentTracks > 0)
+                Debug::print("Skipped {} silent tracks of '{}'", silentTracks, profile.playlist.at(playlistIndex).name);
+        } else {
+            ExportFile *ofilePtr = nullptr;
+            if (streaming) {
+                ofilePtr = &addFile(
+                    std::make_unique<StreamExportFile>(
+                        stdout, streamFormat, settings.exportBitDepth, settings.exportSampleRate, 2
+                    ),
+                    ""
+                );
+            } else {
+                const auto finalFilePath = makeFilePath(filePathPatt, playlistIndex);
+                ofilePtr = &addFile(
+                    std::make_unique<SndfileExportFile>(finalFilePath, format, settings.exportSampleRate, 2),
+                    finalFilePath
+                );
+            }
+            ExportFile &ofile = *ofilePtr;
 
-            writeSilence(ofile.get(), padSecondsStart);
+            writer->WriteSilence(ofile, silenceFrames(padSecondsStart));
 
             while (true) {
                 ctx.m4aSoundMain();
-                if (ctx.SongEnded())
+                if (songEnded())
                     break;
 
-                sf_count_t processed = sf_writef_float(
-                    ofile.get(), &ctx.masterAudioBuffer[0].left, sf_count_t(samplesPerBuffer)
-                );
-
-                if (processed < sf_count_t(samplesPerBuffer))
-                    throw Xcept("sf_writef_float failed: {}", sf_strerror(ofile.get()));
-
-                samplesRendered += samplesPerBuffer;
+                {
+                    PROFILE_STAGE(FILE_IO);
+                    writer->Write(ofile, bufferSamples(ctx.masterAudioBuffer));
+                }
+                if (!advance())
+                    return false;
             }
 
-            writeSilence(ofile.get(), padSecondsEnd);
+            writer->WriteSilence(ofile, silenceFrames(padSecondsEnd));
         }
 
-        if (closeFailed)
-            throw Xcept("Unable to export song due to previous errors");
+        SongLoudness &loudness = songLoudness.at(playlistIndex);
+        loudness.integrated = meter.GetIntegratedLoudness();
+        loudness.truePeak = meter.GetTruePeak();
+        if (settings.exportNormalize) {
+            loudness.gain = normalizeGain(meter);
+            const float gain = static_cast<float>(std::pow(10.0, loudness.gain / 20.0));
+            for (SpoolExportFile *spool : spools)
+                spool->SetGain(gain);
+        }
+
+        PROFILE_STAGE(FILE_IO);
+        ofiles.CloseAll();
+
+        songFiles.at(playlistIndex) = ofiles.GetFilePaths();
+        if (manifest)
+            manifest->Put(manifestSongName(songFilePath), songKeys.at(playlistIndex), ofiles.GetFilePaths());
     }
     // if benchmark only
     else {
         while (true) {
             ctx.m4aSoundMain();
-            samplesRendered += samplesPerBuffer;
-            if (ctx.SongEnded())
+            if (!advance())
+                return false;
+            if (songEnded())
                 break;
         }
     }
-    return samplesRendered;
+    return true;
 }
 
-std::filesystem::path SoundExporter::makeFilePath(const std::filesystem::path &filePathPatt, size_t playlistIndex, size_t trackId)
+std::filesystem::path SoundExporter::makeFilePath(
+    const std::filesystem::path &filePathPatt, size_t playlistIndex, size_t trackId
+) const
 {
     std::wstring filePathPattW = filePathPatt.wstring();
 
+    /* with single file stems, all tracks go to one file like a regular mixdown */
+    const bool trackFiles = seperate && !settings.exportStemsSingleFile;
+
     if (filePathPattW.empty()) {
         std::filesystem::path filePathPattNew;
-        if (seperate) {
+        const std::wstring extension = std::filesystem::path(GetFileExtension(settings.exportFormat)).wstring();
+        if (trackFiles) {
+            filePathPattNew = std::format(
+                L"{} - {}.{}.{}",
+                SONG_ID_PATTERN.wstring(),
+                SONG_NAME_PATTERN.wstring(),
+                TRACK_ID_PATTERN.wstring(),
+                extension
+            );
+        } else if (seperate) {
             filePathPattNew = std::format(
-                L"{} - {}.{}.wav",
+                L"{} - {}.stems.{}",
                 SONG_ID_PATTERN.wstring(),
                 SONG_NAME_PATTERN.wstring(),
-                TRACK_ID_PATTERN.wstring()
+                extension
             );
         } else {
             filePathPattNew = std::format(
-                L"{} - {}.wav",
+                L"{} - {}.{}",
                 SONG_ID_PATTERN.wstring(),
-                SONG_NAME_PATTERN.wstring()
+                SONG_NAME_PATTERN.wstring(),
+                extension
             );
         }
         filePathPattW = (directory / filePathPattNew).wstring();
@@ -311,7 +854,7 @@ std::filesystem::path SoundExporter::makeFilePath(const std::filesystem::path &f
     boost::replace_all(filePathPattW, SONG_ID_PATTERN.wstring(), std::to_wstring(songId));
     boost::replace_all(filePathPattW, SONG_NAME_PATTERN.wstring(), playlistNameW);
 
-    if (seperate) {
+    if (trackFiles) {
         if (filePathPattW.find(TRACK_ID_PATTERN.wstring()) == filePathPattW.npos)
             throw Xcept("Cannot export stems to file. Please add {} to your path pattern", TRACK_ID_PATTERN.string());
         std::wstring trackIdW = trackId == std::numeric_limits<size_t>::max() ? L"XX" : std::format(L"{:02d}", trackId);
@@ -1,14 +1,70 @@
 #pragma once
 
+#include "ExportManifest.hpp"
+#include "RenderProfiler.hpp"
+#include "Types.hpp"
+
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <filesystem>
+#include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
-struct sf_private_tag;
+class ExportWriter;
+class LoudnessMeter;
 struct Profile;
 struct Settings;
 
+/* Snapshot of the progress of an export, see SoundExporter::GetProgress. Sample counts are in frames of the
+ * export sample rate and do not include padding. */
+struct ExportProgress
+{
+    enum class SongState : uint8_t { QUEUED, RENDERING, DONE, SKIPPED, FAILED, CANCELLED };
+
+    struct Song
+    {
+        SongState state = SongState::QUEUED;
+        size_t samplesRendered = 0;
+        size_t samplesEstimated = 0;    // 0 until the song has been analyzed, exact after it is done
+    };
+
+    std::vector<Song> songs;    // in playlist order
+    size_t songsDone = 0;    // including skipped songs
+    size_t samplesRendered = 0;
+    size_t samplesEstimated = 0;
+    double secondsElapsed = 0.0;
+    double secondsRemaining = -1.0;    // negative while no estimate is available
+    bool analyzing = false;            // song lengths are still being estimated
+    bool finished = false;
+
+    /* No estimate is available while analyzing. If all songs are skipped, nothing is ever estimated, but the
+     * export is complete. */
+    bool IsEstimating() const { return analyzing || (samplesEstimated == 0 && songsDone < songs.size()); }
+    /* 0.0 to 1.0, only meaningful if not estimating */
+    double GetFraction() const
+    {
+        if (samplesEstimated == 0)
+            return 1.0;
+        return static_cast<double>(samplesRendered) / static_cast<double>(samplesEstimated);
+    }
+};
+
+/* Result of a song after the export, see SoundExporter::GetResults. Loudness values are in LUFS, dBTP and dB
+ * and only valid if the song is DONE. */
+struct ExportResult
+{
+    ExportProgress::SongState state = ExportProgress::SongState::QUEUED;
+    std::vector<std::filesystem::path> files;    // for skipped songs, the files of the previous export
+    size_t samplesRendered = 0;                  // without padding
+    double secondsRendering = 0.0;               // wall time spent on the song including encoding
+    double loudness = 0.0;
+    double truePeak = 0.0;
+    double gain = 0.0;
+};
+
 // TODO this class does not really hold useful state, remove class and replace
 // with functions only.
 
@@ -21,21 +77,64 @@ public:
         const Settings &settings,
         const Profile &profile,
         bool benchmarkOnly,
-        bool seperate
+        bool seperate,
+        StreamFormat streamFormat = StreamFormat::WAV
     );
     SoundExporter(const SoundExporter &) = delete;
     SoundExporter &operator=(const SoundExporter &) = delete;
 
+    /* Export may be called only once. GetProgress and Cancel may be called from any thread while Export is
+     * running. Cancel stops rendering as soon as possible. Files of unfinished songs are removed.
+     * If exportSkipUnchanged is set, songs are skipped if the ExportManifest in their directory shows, that
+     * they have already been exported with the same song data and settings.
+     * If the only file path is STDOUT_PATH, a single song is mixed down and written to stdout in streamFormat.
+     * Since stdout cannot be removed, it contains partial output if the export is cancelled.
+     * The loudness of each song is measured while rendering and reported afterwards. If exportNormalize is set,
+     * the samples are spooled to a temporary file and written with the gain, which is required to reach the
+     * target loudness. */
     void Export();
+    ExportProgress GetProgress() const;
+    void Cancel();
+    /* in playlist order, may only be called after Export has returned */
+    std::vector<ExportResult> GetResults() const;
+
+    /* without the dot, e.g. "flac" */
+    static std::string GetFileExtension(ExportFormat format);
+    /* Index of the shard (0 <= index < shardCount), which renders the song, when a song list is split across
+     * multiple machines. It only depends on the song ID, so all machines agree on it regardless of the order and
+     * the output paths of their song lists. */
+    static size_t GetShard(uint16_t songId, size_t shardCount);
 
     static const std::filesystem::path SONG_NAME_PATTERN;
     static const std::filesystem::path TRACK_ID_PATTERN;
     static const std::filesystem::path SONG_ID_PATTERN;
+    static const std::filesystem::path STDOUT_PATH;
 
 private:
-    void writeSilence(sf_private_tag *ofile, double seconds);
-    size_t exportSong(const std::filesystem::path &filePathPatt, size_t playlistIndex);
-    std::filesystem::path makeFilePath(const std::filesystem::path &filePathPatt, size_t playlistIndex, size_t trackId = 0);
+    struct SongProgress
+    {
+        std::atomic<ExportProgress::SongState> state = ExportProgress::SongState::QUEUED;
+        std::atomic<size_t> samplesRendered = 0;
+        std::atomic<size_t> samplesEstimated = 0;
+    };
+
+    /* in LUFS, dBTP and dB, the gain is 0 if the song was not normalized */
+    struct SongLoudness
+    {
+        double integrated = 0.0;
+        double truePeak = 0.0;
+        double gain = 0.0;
+    };
+
+    void estimateSongs();
+    uint64_t songKey(uint64_t dataHash) const;
+    void loadManifests();
+    size_t silenceFrames(double seconds) const;
+    double normalizeGain(const LoudnessMeter &meter) const;
+    bool exportSong(const std::filesystem::path &filePathPatt, size_t playlistIndex, ExportWriter *writer);
+    std::filesystem::path makeFilePath(
+        const std::filesystem::path &filePathPatt, size_t playlistIndex, size_t trackId = 0
+    ) const;
 
     const std::filesystem::path directory;
     const std::vector<std::filesystem::path> filePaths;
@@ -44,4 +143,22 @@ private:
 
     const bool benchmarkOnly;
     const bool seperate;
+    const bool streaming;
+    const StreamFormat streamFormat;
+
+    std::vector<SongProgress> songProgress;
+    std::vector<SongLoudness> songLoudness;    // valid for songs, which are done
+    std::vector<std::vector<std::filesystem::path>> songFiles;
+    std::vector<double> songSeconds;
+    std::vector<uint64_t> songKeys;    // 0 if the song could not be analyzed
+    std::map<std::filesystem::path, std::unique_ptr<ExportManifest>> manifests;    // by directory
+    std::vector<ExportManifest *> songManifests;                                   // null if not used
+    std::atomic<bool> cancel = false;
+    std::atomic<bool> analyzing = false;
+    std::atomic<bool> finished = false;
+    std::atomic<std::chrono::steady_clock::time_point> startTime{};
+    std::atomic<std::chrono::steady_clock::time_point> renderStartTime{};
+#ifdef AGBPLAY_RENDER_PROFILING
+    std::vector<RenderProfile> renderProfiles;    // in playlist order
+#endif
 };
@@ -1,6 +1,8 @@
 #include "SoundMixer.hpp"
 
 #include "MP2KContext.hpp"
+#include "RenderProfiler.hpp"
+#include "StateStream.hpp"
 #include "Util.hpp"
 #include "Xcept.hpp"
 
@@ -20,9 +22,13 @@ SoundMixer::SoundMixer(MP2KContext &ctx, uint32_t sampleRate, float masterVolume
 
 void SoundMixer::UpdateReverb()
 {
+    if (busReverb)
+        busReverb->SetLevel(GetReverbLevel());
+
     for (MP2KPlayer &player : ctx.players) {
         for (MP2KTrack &trk : player.tracks) {
-            trk.reverb->SetLevel(GetReverbLevel());
+            if (trk.reverb)
+                trk.reverb->SetLevel(GetReverbLevel());
         }
     }
 }
@@ -41,17 +47,52 @@ void SoundMixer::UpdateFixedModeRate()
         static_cast<uint8_t>(2), static_cast<uint8_t>(ctx.agbplaySoundMode.dmaBufferLen / (fixedModeRate / AGB_APPROX_FPS))
     );
 
+    if (reverbBusMode) {
+        busReverb =
+            ReverbEffect::MakeReverb(ctx.agbplaySoundMode.reverbType, GetReverbLevel(), sampleRate, numDmaBuffers);
+    } else {
+        busReverb.reset();
+    }
+
+    for (MP2KPlayer &player : ctx.players) {
+        for (MP2KTrack &trk : player.tracks) {
+            if (reverbBusMode) {
+                trk.reverb.reset();
+            } else {
+                trk.reverb = ReverbEffect::MakeReverb(
+                    ctx.agbplaySoundMode.reverbType, GetReverbLevel(), sampleRate, numDmaBuffers
+                );
+            }
+        }
+    }
+}
+
+void SoundMixer::ResetReverb()
+{
+    if (busReverb)
+        busReverb->Reset();
+
     for (MP2KPlayer &player : ctx.players) {
         for (MP2KTrack &trk : player.tracks) {
-            trk.reverb = ReverbEffect::MakeReverb(
-                ctx.agbplaySoundMode.reverbType, GetReverbLevel(), sampleRate, numDmaBuffers
-            );
+            if (trk.reverb)
+                trk.reverb->Reset();
         }
     }
 }
 
+void SoundMixer::SetReverbBusMode(bool reverbBusMode)
+{
+    if (this->reverbBusMode == reverbBusMode)
+        return;
+
+    this->reverbBusMode = reverbBusMode;
+    UpdateFixedModeRate();
+}
+
 void SoundMixer::Process()
 {
+    PROFILE_STAGE(MIXDOWN);
+
     /* 1. clear the mixing buffer before processing channels */
     ctx.masterAudioBuffer.resize(samplesPerBuffer);
     std::fill(ctx.masterAudioBuffer.begin(), ctx.masterAudioBuffer.end(), sample{0.0f, 0.0f});
@@ -75,21 +116,82 @@ void SoundMixer::Process()
         for (auto &chn : channels)
             chn.Process(chn.trackOrg->audioBuffer, margs);
     };
-    mixFunc(ctx.sndChannels);
+    {
+        PROFILE_STAGE(PCM);
+        mixFunc(ctx.sndChannels);
+    }
 
     /* 4. apply reverb */
-    // TODO add player for-loop for multiple players
-    for (MP2KPlayer &player : ctx.players) {
-        for (MP2KTrack &trk : player.tracks) {
-            trk.reverb->Process(trk.audioBuffer);
+    if (reverbBusMode) {
+        for (MP2KPlayer &player : ctx.players) {
+            for (MP2KTrack &trk : player.tracks) {
+                if (trk.muted)
+                    continue;
+
+                assert(ctx.masterAudioBuffer.size() == trk.audioBuffer.size());
+                for (size_t i = 0; i < ctx.masterAudioBuffer.size(); i++) {
+                    ctx.masterAudioBuffer[i].left += trk.audioBuffer[i].left;
+                    ctx.masterAudioBuffer[i].right += trk.audioBuffer[i].right;
+                }
+            }
+        }
+
+        PROFILE_STAGE(REVERB);
+        busReverb->Process(ctx.masterAudioBuffer);
+    } else {
+        PROFILE_STAGE(REVERB);
+        for (MP2KPlayer &player : ctx.players) {
+            for (MP2KTrack &trk : player.tracks) {
+                trk.reverb->Process(trk.audioBuffer);
+            }
         }
     }
 
     /* 5. mix channels which are not affected by reverb (CGB) */
-    mixFunc(ctx.sq1Channels);
-    mixFunc(ctx.sq2Channels);
-    mixFunc(ctx.waveChannels);
-    mixFunc(ctx.noiseChannels);
+    auto mixFuncBus = [&](auto &channels) {
+        /* The PCM part of the master mix is already complete, so mix CGB channels
+         * to both the track (for visualization) and the master buffer. */
+        cgbBuffer.resize(samplesPerBuffer);
+        for (auto &chn : channels) {
+            std::fill(cgbBuffer.begin(), cgbBuffer.end(), sample{0.0f, 0.0f});
+            chn.Process(cgbBuffer, margs);
+
+            MP2KTrack &trk = *chn.trackOrg;
+            for (size_t i = 0; i < cgbBuffer.size(); i++) {
+                trk.audioBuffer[i].left += cgbBuffer[i].left;
+                trk.audioBuffer[i].right += cgbBuffer[i].right;
+            }
+
+            if (trk.muted)
+                continue;
+
+            for (size_t i = 0; i < cgbBuffer.size(); i++) {
+                ctx.masterAudioBuffer[i].left += cgbBuffer[i].left;
+                ctx.masterAudioBuffer[i].right += cgbBuffer[i].right;
+            }
+        }
+    };
+
+    auto mixFuncCGB = [&](auto &channels) {
+        if (reverbBusMode)
+            mixFuncBus(channels);
+        else
+            mixFunc(channels);
+    };
+
+    {
+        PROFILE_STAGE(SQUARE);
+        mixFuncCGB(ctx.sq1Channels);
+        mixFuncCGB(ctx.sq2Channels);
+    }
+    {
+        PROFILE_STAGE(WAVE);
+        mixFuncCGB(ctx.waveChannels);
+    }
+    {
+        PROFILE_STAGE(NOISE);
+        mixFuncCGB(ctx.noiseChannels);
+    }
 
     /* 6. clean up all stopped channels */
     auto removeFunc = [](const auto &chn) { return chn.envState == EnvState::DEAD; };
@@ -118,20 +220,28 @@ void SoundMixer::Process()
         fadeMicroframesLeft--;
     }
 
-    for (MP2KPlayer &player : ctx.players) {
-        for (MP2KTrack &trk : player.tracks) {
-            const float masterStep = (masterTo - masterFrom) * margs.samplesPerBufferInv;
-            float masterLevel = masterFrom;
-            for (size_t i = 0; i < samplesPerBuffer; i++) {
-                trk.audioBuffer[i].left *= masterLevel;
-                trk.audioBuffer[i].right *= masterLevel;
+    auto fadeFunc = [&](std::span<sample> buffer) {
+        const float masterStep = (masterTo - masterFrom) * margs.samplesPerBufferInv;
+        float masterLevel = masterFrom;
+        for (size_t i = 0; i < samplesPerBuffer; i++) {
+            buffer[i].left *= masterLevel;
+            buffer[i].right *= masterLevel;
 
-                masterLevel += masterStep;
-            }
+            masterLevel += masterStep;
         }
+    };
+
+    for (MP2KPlayer &player : ctx.players) {
+        for (MP2KTrack &trk : player.tracks)
+            fadeFunc(trk.audioBuffer);
     }
 
     /* 8. master mixdown */
+    if (reverbBusMode) {
+        fadeFunc(ctx.masterAudioBuffer);
+        return;
+    }
+
     for (MP2KPlayer &player : ctx.players) {
         for (MP2KTrack &trk : player.tracks) {
             if (trk.muted)
@@ -156,6 +266,15 @@ double SoundMixer::GetBufferLengthSpeedCorrection() const
     return static_cast<double>(samplesPerBuffer) / samplesPerBufferExact;
 }
 
+void SoundMixer::SkipMicroframe()
+{
+    /* advance the fade like Process does, but without mixing any audio */
+    if (fadeMicroframesLeft > 0) {
+        fadePos += fadeStepPerMicroframe;
+        fadeMicroframesLeft--;
+    }
+}
+
 void SoundMixer::ResetFade()
 {
     fadePos = 0.0f;
@@ -181,6 +300,25 @@ bool SoundMixer::IsFadeDone() const
     return fadeMicroframesLeft == 0;
 }
 
+bool SoundMixer::IsSilent(float threshold) const
+{
+    if (!IsBufferSilent(ctx.masterAudioBuffer, threshold))
+        return false;
+    if (busReverb && !busReverb->IsSilent(threshold))
+        return false;
+
+    for (const MP2KPlayer &player : ctx.players) {
+        for (const MP2KTrack &trk : player.tracks) {
+            if (!IsBufferSilent(trk.audioBuffer, threshold))
+                return false;
+            if (trk.reverb && !trk.reverb->IsSilent(threshold))
+                return false;
+        }
+    }
+
+    return true;
+}
+
 uint8_t SoundMixer::GetReverbLevel() const
 {
     if (ctx.agbplaySoundMode.reverbForce & MP2KSoundMode::REV_MASK_SET)
@@ -188,3 +326,39 @@ uint8_t SoundMixer::GetReverbLevel() const
     else
         return ctx.mp2kSoundMode.rev & MP2KSoundMode::REV_MASK_VAL;
 }
+
+void SoundMixer::SaveState(StateWriter &w) const
+{
+    w.Write(ctx.agbplaySoundMode.reverbType);
+    w.Write(reverbBusMode);
+    w.Write(fixedModeRate);
+    w.Write(fadePos);
+    w.Write(fadeStepPerMicroframe);
+    w.Write(fadeMicroframesLeft);
+
+    w.Write<bool>(busReverb != nullptr);
+    if (busReverb)
+        busReverb->SaveState(w);
+}
+
+void SoundMixer::LoadState(StateReader &r)
+{
+    /* Reverb state can only be restored to reverbs of the same type. */
+    const ReverbType reverbType = r.Read<ReverbType>();
+    if (reverbType != ctx.agbplaySoundMode.reverbType)
+        throw Xcept("Cannot restore mixer state: Reverb type does not match current sound mode");
+
+    /* Recreate all reverbs, the track reverb states are restored by the tracks. */
+    r.Read(reverbBusMode);
+    UpdateFixedModeRate();
+    r.Read(fixedModeRate);
+    r.Read(fadePos);
+    r.Read(fadeStepPerMicroframe);
+    r.Read(fadeMicroframesLeft);
+
+    if (r.Read<bool>()) {
+        if (!busReverb)
+            throw Xcept("Cannot restore mixer state: Bus reverb is not available");
+        busReverb->LoadState(r);
+    }
+}
@@ -10,6 +10,8 @@
 #include <vector>
 
 struct MP2KContext;
+class StateWriter;
+class StateReader;
 
 class SoundMixer
 {
@@ -20,15 +22,21 @@ public:
 
     void UpdateReverb();
     void UpdateFixedModeRate();
+    void ResetReverb();
+    void SetReverbBusMode(bool reverbBusMode);
 
     void Process();
+    void SkipMicroframe();
     size_t GetSamplesPerBuffer() const;
     double GetBufferLengthSpeedCorrection() const;
     void ResetFade();
     void StartFadeOut(float millis);
     void StartFadeIn(float millis);
     bool IsFadeDone() const;
+    bool IsSilent(float threshold) const;
     uint8_t GetReverbLevel() const;
+    void SaveState(StateWriter &w) const;
+    void LoadState(StateReader &r);
 
 private:
     MP2KContext &ctx;
@@ -38,6 +46,15 @@ private:
     const size_t samplesPerBuffer = static_cast<size_t>(sampleRate / (AGB_EXACT_FPS * INTERFRAMES));
     const double samplesPerBufferExact = static_cast<double>(sampleRate) / static_cast<double>(AGB_EXACT_FPS * INTERFRAMES);
 
+    /* In bus mode, all PCM channels of unmuted tracks are summed and processed by a single
+     * reverb (like on hardware) instead of one reverb per track. The tracks' audio buffers
+     * then only contain the dry signal, so this is only useful if no stems are required.
+     * It is only used by the SoundExporter for master mixes: the PlaybackEngine keeps one reverb
+     * per track, since its track level meters and muting should include each track's reverb. */
+    bool reverbBusMode = false;
+    std::unique_ptr<ReverbEffect> busReverb;
+    std::vector<sample> cgbBuffer;
+
     // volume control related stuff
 
     const float masterVolume;
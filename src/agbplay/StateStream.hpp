@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Xcept.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/* StateWriter and StateReader are used to save and restore the state of the sound engine.
+ * Values are stored as raw bytes in native byte order, so saved states are only meant to be
+ * restored by the same build of agbplay. */
+
+class StateWriter
+{
+public:
+    template<typename T> void Write(const T &value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+        data.insert(data.end(), bytes, bytes + sizeof(T));
+    }
+
+    template<typename T> void WriteVector(const std::vector<T> &values)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        Write<uint64_t>(values.size());
+        if (values.empty())
+            return;
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(values.data());
+        data.insert(data.end(), bytes, bytes + values.size() * sizeof(T));
+    }
+
+    void WriteString(const std::string &value)
+    {
+        Write<uint64_t>(value.size());
+        data.insert(data.end(), value.begin(), value.end());
+    }
+
+    std::vector<uint8_t> &GetData() { return data; }
+    const std::vector<uint8_t> &GetData() const { return data; }
+
+private:
+    std::vector<uint8_t> data;
+};
+
+class StateReader
+{
+public:
+    StateReader(std::span<const uint8_t> data) : data(data) {}
+
+    template<typename T> void Read(T &value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+    }
+
+    template<typename T> T Read()
+    {
+        T value;
+        Read(value);
+        return value;
+    }
+
+    template<typename T> void ReadVector(std::vector<T> &values)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const uint64_t size = Read<uint64_t>();
+        if (size > (data.size() - pos) / sizeof(T))
+            throw Xcept("Cannot restore state: vector of size {} exceeds end of state data", size);
+        values.resize(static_cast<size_t>(size));
+        if (!values.empty())
+            std::memcpy(values.data(), Take(values.size() * sizeof(T)), values.size() * sizeof(T));
+    }
+
+    void ReadString(std::string &value)
+    {
+        const uint64_t size = Read<uint64_t>();
+        if (size > data.size() - pos)
+            throw Xcept("Cannot restore state: string of size {} exceeds end of state data", size);
+        const char *chars = reinterpret_cast<const char *>(Take(static_cast<size_t>(size)));
+        value.assign(chars, static_cast<size_t>(size));
+    }
+
+    bool AtEnd() const { return pos == data.size(); }
+    size_t Remaining() const { return data.size() - pos; }
+
+private:
+    const uint8_t *Take(size_t size)
+    {
+        if (size > data.size() - pos)
+            throw Xcept("Cannot restore state: unexpected end of state data at offset {}", pos);
+        const uint8_t *bytes = data.data() + pos;
+        pos += size;
+        return bytes;
+    }
+
+    std::span<const uint8_t> data;
+    size_t pos = 0;
+};
@@ -1,5 +1,8 @@
 #include "Types.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 ReverbType str2rev(const std::string &str)
 {
     if (str == "gs1")
@@ -81,3 +84,58 @@ std::string cgbPoly2str(CGBPolyphony t)
         return "poly";
     return "mono-strict";
 }
+
+ExportFormat str2exportFormat(const std::string &str)
+{
+    if (str == "wav")
+        return ExportFormat::WAV;
+    else if (str == "flac")
+        return ExportFormat::FLAC;
+    else if (str == "vorbis")
+        return ExportFormat::VORBIS;
+    else if (str == "opus")
+        return ExportFormat::OPUS;
+    return ExportFormat::WAV;
+}
+
+std::string exportFormat2str(ExportFormat t)
+{
+    if (t == ExportFormat::WAV)
+        return "wav";
+    else if (t == ExportFormat::FLAC)
+        return "flac";
+    else if (t == ExportFormat::VORBIS)
+        return "vorbis";
+    else if (t == ExportFormat::OPUS)
+        return "opus";
+    return "wav";
+}
+
+StreamFormat str2streamFormat(const std::string &str)
+{
+    if (str == "wav")
+        return StreamFormat::WAV;
+    else if (str == "f32le")
+        return StreamFormat::F32LE;
+    else if (str == "s16le")
+        return StreamFormat::S16LE;
+    return StreamFormat::WAV;
+}
+
+std::string streamFormat2str(StreamFormat t)
+{
+    if (t == StreamFormat::WAV)
+        return "wav";
+    else if (t == StreamFormat::F32LE)
+        return "f32le";
+    else if (t == StreamFormat::S16LE)
+        return "s16le";
+    return "wav";
+}
+
+bool IsBufferSilent(std::span<const sample> buffer, float threshold)
+{
+    return std::all_of(buffer.begin(), buffer.end(), [threshold](const sample &s) {
+        return std::abs(s.left) < threshold && std::abs(s.right) < threshold;
+    });
+}
@@ -4,6 +4,7 @@
 
 #include <bitset>
 #include <cstdint>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -13,6 +14,8 @@ enum class NoisePatt : int { FINE = 0, ROUGH };
 enum class ReverbType : int { NORMAL, GS1, GS2, MGAT, TEST, NONE };
 enum class ResamplerType : int { NEAREST, LINEAR, SINC, BLEP, BLAMP };
 enum class CGBPolyphony { MONO_STRICT, MONO_SMOOTH, POLY };
+enum class ExportFormat : int { WAV, FLAC, VORBIS, OPUS };
+enum class StreamFormat : int { WAV, F32LE, S16LE };
 
 enum class VoiceFlags : int {
     NONE = 0x0,
@@ -41,6 +44,10 @@ ResamplerType str2res(const std::string &str);
 std::string res2str(ResamplerType t);
 CGBPolyphony str2cgbPoly(const std::string &str);
 std::string cgbPoly2str(CGBPolyphony t);
+ExportFormat str2exportFormat(const std::string &str);
+std::string exportFormat2str(ExportFormat t);
+StreamFormat str2streamFormat(const std::string &str);
+std::string streamFormat2str(StreamFormat t);
 
 struct MixingArgs
 {
@@ -166,6 +173,33 @@ struct sample
     float right;
 };
 
+/* true if the magnitude of all samples is below threshold */
+bool IsBufferSilent(std::span<const sample> buffer, float threshold);
+
+/* Result of MP2KContext::AnalyzeSong. The intro length equals the loop start. */
+struct MP2KSongAnalysis
+{
+    struct TempoChange
+    {
+        size_t tick;
+        size_t sample;
+        uint16_t bpm;
+    };
+
+    size_t lengthTicks = 0;      // until end of sequence or max loops reached
+    size_t lengthSamples = 0;    // until end of sequence or max loops reached
+    size_t totalSamples = 0;     // including final fade out, as rendered by SoundExporter
+    bool loopFound = false;
+    size_t loopStartTick = 0;
+    size_t loopStartSample = 0;
+    size_t loopEndTick = 0;
+    size_t loopEndSample = 0;
+    std::vector<TempoChange> tempoChanges;
+    size_t maxPolyphony = 0;    // max number of simultaneous notes (excluding release)
+    bool truncated = false;     // stopped at SONG_ANALYSIS_MAX_TIME or after the first loop if looping endlessly
+    uint64_t dataHash = 0;      // see SequenceReader::AnalysisDataHash
+};
+
 struct MP2KVisualizerStateTrack
 {
     uint32_t trackPtr = 0;
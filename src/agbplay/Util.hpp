@@ -1,7 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -9,6 +15,51 @@
 
 #define PI_F (float(M_PI))
 
+/* Runtime CPU feature detection for classes, which provide an AVX2 implementation.
+ * Defined in Util.cpp, which is not compiled with AVX2 enabled, so the detection itself never uses AVX2. */
+extern const bool AVX2_SUPPORTED;
+
+/* Splits [begin, end) into chunks of chunkSize (the last one may be shorter) and calls func(chunkBegin, chunkEnd)
+ * for each of them on all available cores. The first exception thrown by func is rethrown after all threads
+ * have finished. */
+template<typename Func> void ParallelForChunks(size_t begin, size_t end, size_t chunkSize, Func func)
+{
+    if (begin >= end)
+        return;
+
+    const size_t numChunks = (end - begin + chunkSize - 1) / chunkSize;
+    std::atomic<size_t> currentChunk = 0;
+    std::exception_ptr error;
+    std::atomic<bool> cancel = false;
+
+    auto threadFunc = [&]() {
+        while (!cancel) {
+            const size_t i = currentChunk++;    // atomic ++
+            if (i >= numChunks)
+                return;
+
+            try {
+                const size_t chunkBegin = begin + i * chunkSize;
+                func(chunkBegin, std::min(chunkBegin + chunkSize, end));
+            } catch (...) {
+                if (!cancel.exchange(true))
+                    error = std::current_exception();
+            }
+        }
+    };
+
+    const size_t numThreads = std::min<size_t>(std::thread::hardware_concurrency(), numChunks);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < numThreads; i++)
+        workers.emplace_back(threadFunc);
+    threadFunc();
+    for (auto &w : workers)
+        w.join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
 inline void CStrAppend(char *dest, size_t *index, const char *src)
 {
     char ch;
@@ -0,0 +1,89 @@
+#include "LoudnessMeter.hpp"
+#include "Types.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fmt/core.h>
+#include <numbers>
+#include <vector>
+
+/* Checks the LoudnessMeter against the reference values of ITU-R BS.1770-4: a 997 Hz sine with 0 dBFS peak
+ * in one channel measures -3.01 LUFS. */
+
+const float TONE_FREQ = 997.0f;
+const double LOUDNESS_TOLERANCE = 0.1;    // LU
+
+static std::vector<sample> genSine(
+    uint32_t sampleRate, float seconds, float freq, float amplitude, float phase, bool left, bool right
+)
+{
+    std::vector<sample> buffer(static_cast<size_t>(seconds * static_cast<float>(sampleRate)));
+    const double omega = 2.0 * std::numbers::pi * freq / sampleRate;
+    for (size_t i = 0; i < buffer.size(); i++) {
+        const float s = amplitude * static_cast<float>(std::sin(omega * static_cast<double>(i) + phase));
+        buffer[i] = {left ? s : 0.0f, right ? s : 0.0f};
+    }
+    return buffer;
+}
+
+static bool check(const char *name, double value, double expected, double tolerance)
+{
+    const bool ok = (std::isinf(expected) && value == expected) || std::abs(value - expected) <= tolerance;
+    fmt::print("{}: {} (value={:.3f} expected={:.3f})\n", name, ok ? "OK" : "FAIL", value, expected);
+    return ok;
+}
+
+int main()
+{
+    int fails = 0;
+
+    for (uint32_t sampleRate : {44100u, 48000u, 96000u}) {
+        fmt::print("sample rate {}\n", sampleRate);
+
+        {
+            LoudnessMeter meter(sampleRate);
+            meter.Process(genSine(sampleRate, 10.0f, TONE_FREQ, 1.0f, 0.0f, true, false));
+            if (!check("  sine in one channel", meter.GetIntegratedLoudness(), -3.01, LOUDNESS_TOLERANCE))
+                fails++;
+            if (!check("  sine true peak", meter.GetTruePeak(), 0.0, 0.1))
+                fails++;
+        }
+
+        {
+            LoudnessMeter meter(sampleRate);
+            meter.Process(genSine(sampleRate, 10.0f, TONE_FREQ, 1.0f, 0.0f, true, true));
+            if (!check("  sine in both channels", meter.GetIntegratedLoudness(), 0.0, LOUDNESS_TOLERANCE))
+                fails++;
+        }
+
+        {
+            /* -20 dB and the silence after it is gated, so it does not lower the loudness. Only the blocks
+             * overlapping the end of the tone pass the gate and lower it slightly. */
+            LoudnessMeter meter(sampleRate);
+            meter.Process(genSine(sampleRate, 10.0f, TONE_FREQ, 0.1f, 0.0f, true, false));
+            meter.Process(std::vector<sample>(sampleRate * 10, sample{0.0f, 0.0f}));
+            if (!check("  gated silence", meter.GetIntegratedLoudness(), -23.01, 2.0 * LOUDNESS_TOLERANCE))
+                fails++;
+        }
+
+        {
+            LoudnessMeter meter(sampleRate);
+            meter.Process(std::vector<sample>(sampleRate * 2, sample{0.0f, 0.0f}));
+            if (!check("  silence", meter.GetIntegratedLoudness(), LoudnessMeter::SILENCE, 0.0))
+                fails++;
+            if (!check("  silence true peak", meter.GetTruePeak(), LoudnessMeter::SILENCE, 0.0))
+                fails++;
+        }
+    }
+
+    {
+        /* A sine at fs/4 with 45 degrees phase only has samples at -3 dB, but its true peak is 0 dB. */
+        LoudnessMeter meter(48000);
+        meter.Process(genSine(48000, 1.0f, 12000.0f, 1.0f, std::numbers::pi_v<float> / 4.0f, true, false));
+        if (!check("inter-sample peak", meter.GetTruePeak(), 0.0, 0.5))
+            fails++;
+    }
+
+    return fails == 0 ? 0 : 1;
+}
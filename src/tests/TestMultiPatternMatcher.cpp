@@ -0,0 +1,117 @@
+#include "MultiPatternMatcher.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <fmt/core.h>
+#include <random>
+#include <span>
+#include <vector>
+
+/* Compares the first occurrences found by the MultiPatternMatcher with a naive search. The data uses a small
+ * alphabet, so patterns overlap, share prefixes and suffixes and occur many times. */
+
+const size_t DATA_SIZE = 1 << 16;
+const size_t ROUNDS = 50;
+
+static size_t naiveFindFirst(std::span<const uint8_t> data, std::span<const uint8_t> pattern)
+{
+    if (pattern.empty())
+        return MultiPatternMatcher::NOT_FOUND;
+    const auto it = std::search(data.begin(), data.end(), pattern.begin(), pattern.end());
+    if (it == data.end())
+        return MultiPatternMatcher::NOT_FOUND;
+    return static_cast<size_t>(it - data.begin());
+}
+
+static bool testPatterns(
+    std::span<const uint8_t> data, const std::vector<std::vector<uint8_t>> &patterns, const char *name
+)
+{
+    MultiPatternMatcher matcher;
+    for (size_t i = 0; i < patterns.size(); i++) {
+        if (matcher.AddPattern(patterns[i]) != i) {
+            fmt::print("{}: FAIL (pattern {} got a wrong index)\n", name, i);
+            return false;
+        }
+    }
+
+    const std::vector<size_t> found = matcher.FindFirst(data);
+    if (found.size() != patterns.size()) {
+        fmt::print("{}: FAIL ({} results for {} patterns)\n", name, found.size(), patterns.size());
+        return false;
+    }
+
+    for (size_t i = 0; i < patterns.size(); i++) {
+        const size_t expected = naiveFindFirst(data, patterns[i]);
+        if (found[i] != expected) {
+            fmt::print(
+                "{}: FAIL (pattern {} of length {}: found={:x} expected={:x})\n",
+                name,
+                i,
+                patterns[i].size(),
+                found[i],
+                expected
+            );
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    std::mt19937 rng(1234);
+    int fails = 0;
+
+    /* fixed cases */
+    {
+        const std::vector<uint8_t> data = {1, 2, 3, 1, 2, 3, 4, 0, 0, 0, 5};
+        const std::vector<std::vector<uint8_t>> patterns = {
+            {1, 2, 3, 4},    // after a partial match of itself
+            {2, 3},          // suffix of the first occurrence of another pattern
+            {3},             // single byte
+            {},              // empty, never found
+            {0, 0},          // overlapping with itself
+            {0, 0, 0, 5},
+            {2, 3},          // duplicate
+            {9},             // not contained
+            {3, 4, 0, 0, 0, 5, 6},    // runs past the end
+            {1, 2, 3, 1, 2, 3, 4, 0, 0, 0, 5},    // whole data
+        };
+        if (!testPatterns(data, patterns, "fixed"))
+            fails++;
+        if (!testPatterns({}, patterns, "empty data"))
+            fails++;
+    }
+
+    /* random cases, half of the patterns are taken from the data so they are found */
+    for (size_t round = 0; round < ROUNDS; round++) {
+        const uint8_t alphabet = static_cast<uint8_t>(round % 2 == 0 ? 4 : 255);
+        std::uniform_int_distribution<int> byteDist(0, alphabet);
+        std::vector<uint8_t> data(DATA_SIZE);
+        for (uint8_t &b : data)
+            b = static_cast<uint8_t>(byteDist(rng));
+
+        std::uniform_int_distribution<size_t> countDist(1, 64);
+        std::uniform_int_distribution<size_t> lengthDist(1, 12);
+        std::uniform_int_distribution<size_t> posDist(0, DATA_SIZE - 12);
+        std::vector<std::vector<uint8_t>> patterns(countDist(rng));
+        for (size_t i = 0; i < patterns.size(); i++) {
+            const size_t length = lengthDist(rng);
+            if (i % 2 == 0) {
+                const size_t pos = posDist(rng);
+                const auto patternBegin = data.begin() + static_cast<ptrdiff_t>(pos);
+                patterns[i].assign(patternBegin, patternBegin + static_cast<ptrdiff_t>(length));
+            } else {
+                for (size_t j = 0; j < length; j++)
+                    patterns[i].emplace_back(static_cast<uint8_t>(byteDist(rng)));
+            }
+        }
+
+        if (!testPatterns(data, patterns, "random"))
+            fails++;
+    }
+
+    fmt::print("{} fails\n", fails);
+    return fails == 0 ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+#include "SoundExporter.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fmt/core.h>
+#include <limits>
+#include <vector>
+
+/* Checks the split of song lists into shards: every song belongs to exactly one shard, the shards are
+ * balanced even for short runs of consecutive IDs, and the assignment never changes, since result manifests
+ * of different agbplay versions have to be merged. */
+
+const size_t NUM_IDS = std::numeric_limits<uint16_t>::max() + 1;
+
+static bool testBalance(size_t shardCount, size_t numIds, double tolerance)
+{
+    std::vector<size_t> counts(shardCount, 0);
+    for (size_t id = 0; id < numIds; id++) {
+        const size_t shard = SoundExporter::GetShard(static_cast<uint16_t>(id), shardCount);
+        if (shard >= shardCount) {
+            fmt::print("shards={} ids={}: FAIL (shard {} of song {} out of range)\n", shardCount, numIds, shard, id);
+            return false;
+        }
+        counts[shard]++;
+    }
+
+    const double expected = static_cast<double>(numIds) / static_cast<double>(shardCount);
+    const auto [minIt, maxIt] = std::minmax_element(counts.begin(), counts.end());
+    const bool ok = static_cast<double>(*minIt) >= expected * (1.0 - tolerance)
+        && static_cast<double>(*maxIt) <= expected * (1.0 + tolerance);
+    fmt::print(
+        "shards={} ids={}: {} (min={} max={} expected={:.1f})\n",
+        shardCount,
+        numIds,
+        ok ? "OK" : "FAIL",
+        *minIt,
+        *maxIt,
+        expected
+    );
+    return ok;
+}
+
+int main()
+{
+    int fails = 0;
+
+    for (size_t shardCount : {1, 2, 3, 4, 7, 16})
+        if (!testBalance(shardCount, NUM_IDS, 0.05))
+            fails++;
+
+    /* typical song tables only have a few hundred entries */
+    for (size_t shardCount : {2, 4, 8})
+        if (!testBalance(shardCount, 512, 0.25))
+            fails++;
+
+    /* a single shard contains everything */
+    for (size_t id = 0; id < NUM_IDS; id++) {
+        if (SoundExporter::GetShard(static_cast<uint16_t>(id), 1) != 0) {
+            fmt::print("single shard: FAIL (song {})\n", id);
+            fails++;
+            break;
+        }
+    }
+
+    /* fixed assignment, changing it breaks merging manifests of different versions */
+    struct Expected
+    {
+        uint16_t songId;
+        size_t shardCount;
+        size_t shard;
+    };
+    const Expected expected[] = {
+        {0, 2, 0},
+        {1, 2, 1},
+        {2, 4, 2},
+        {3, 4, 0},
+        {100, 3, 0},
+        {1000, 7, 0},
+        {12345, 16, 1},
+        {65535, 16, 5},
+    };
+    for (const Expected &e : expected) {
+        const size_t shard = SoundExporter::GetShard(e.songId, e.shardCount);
+        if (shard != e.shard) {
+            fmt::print("song {} of {} shards: FAIL (shard={} expected={})\n", e.songId, e.shardCount, shard, e.shard);
+            fails++;
+        }
+    }
+
+    return fails == 0 ? 0 : 1;
+}
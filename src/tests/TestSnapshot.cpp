@@ -0,0 +1,226 @@
+#include "Constants.hpp"
+#include "MP2KContext.hpp"
+#include "Rom.hpp"
+#include "Xcept.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fmt/core.h>
+#include <initializer_list>
+#include <span>
+#include <vector>
+
+/* Renders a synthetic song, takes a snapshot, renders part B, restores the snapshot
+ * and renders part B again. Both renderings of part B must be bit identical. */
+
+const uint32_t SAMPLERATE = 48000;
+const size_t RENDER_A_FRAMES = 1000;
+const size_t RENDER_B_FRAMES = 2000;
+
+const size_t SONG_POS = 0x4000;
+const size_t VOICEGROUP_POS = 0x2000;
+const size_t SAMPLE_POS = 0x8000;
+const size_t WAVE_POS = 0x9000;
+
+class RomBuilder
+{
+public:
+    RomBuilder() : data(0x10000, 0)
+    {
+        static const std::array<uint8_t, 156> logo{
+            0x24, 0xff, 0xae, 0x51, 0x69, 0x9a, 0xa2, 0x21, 0x3d, 0x84, 0x82, 0x0a, 0x84, 0xe4, 0x09, 0xad,    //
+            0x11, 0x24, 0x8b, 0x98, 0xc0, 0x81, 0x7f, 0x21, 0xa3, 0x52, 0xbe, 0x19, 0x93, 0x09, 0xce, 0x20,    //
+            0x10, 0x46, 0x4a, 0x4a, 0xf8, 0x27, 0x31, 0xec, 0x58, 0xc7, 0xe8, 0x33, 0x82, 0xe3, 0xce, 0xbf,    //
+            0x85, 0xf4, 0xdf, 0x94, 0xce, 0x4b, 0x09, 0xc1, 0x94, 0x56, 0x8a, 0xc0, 0x13, 0x72, 0xa7, 0xfc,    //
+            0x9f, 0x84, 0x4d, 0x73, 0xa3, 0xca, 0x9a, 0x61, 0x58, 0x97, 0xa3, 0x27, 0xfc, 0x03, 0x98, 0x76,    //
+            0x23, 0x1d, 0xc7, 0x61, 0x03, 0x04, 0xae, 0x56, 0xbf, 0x38, 0x84, 0x00, 0x40, 0xa7, 0x0e, 0xfd,    //
+            0xff, 0x52, 0xfe, 0x03, 0x6f, 0x95, 0x30, 0xf1, 0x97, 0xfb, 0xc0, 0x85, 0x60, 0xd6, 0x80, 0x25,    //
+            0xa9, 0x63, 0xbe, 0x03, 0x01, 0x4e, 0x38, 0xe2, 0xf9, 0xa2, 0x34, 0xff, 0xbb, 0x3e, 0x03, 0x44,    //
+            0x78, 0x00, 0x90, 0xcb, 0x88, 0x11, 0x3a, 0x94, 0x65, 0xc0, 0x7c, 0x63, 0x87, 0xf0, 0x3c, 0xaf,    //
+            0xd6, 0x25, 0xe4, 0x8b, 0x38, 0x0a, 0xac, 0x72, 0x21, 0xd4, 0xf8, 0x07                             //
+        };
+        std::memcpy(&data[4], logo.data(), logo.size());
+        data[0xBD] = 0xE7;    // header checksum of an otherwise empty header
+    }
+
+    void Seek(size_t pos) { this->pos = pos; }
+    size_t Tell() const { return pos; }
+
+    void Bytes(std::initializer_list<uint8_t> bytes)
+    {
+        for (uint8_t b : bytes)
+            data.at(pos++) = b;
+    }
+
+    void U32(uint32_t value)
+    {
+        Bytes({
+            static_cast<uint8_t>(value),
+            static_cast<uint8_t>(value >> 8),
+            static_cast<uint8_t>(value >> 16),
+            static_cast<uint8_t>(value >> 24),
+        });
+    }
+
+    void Ptr(size_t target) { U32(static_cast<uint32_t>(target + AGB_MAP_ROM)); }
+
+    std::vector<uint8_t> data;
+
+private:
+    size_t pos = 0;
+};
+
+static std::vector<uint8_t> buildRom()
+{
+    RomBuilder rb;
+
+    /* looped PCM sample */
+    rb.Seek(SAMPLE_POS);
+    rb.Bytes({0, 0, 0, 0x40});
+    rb.U32(44100 * 1024 / 2);
+    rb.U32(100);
+    rb.U32(2000);
+    for (int i = 0; i < 2000; i++)
+        rb.Bytes({static_cast<uint8_t>((i * 7 % 200) - 100)});
+
+    rb.Seek(WAVE_POS);
+    for (int i = 0; i < 16; i++)
+        rb.Bytes({static_cast<uint8_t>(i * 37)});
+
+    /* PCM, square with sweep, wave and noise instruments */
+    rb.Seek(VOICEGROUP_POS);
+    rb.Bytes({0x00, 60, 0, 0});
+    rb.Ptr(SAMPLE_POS);
+    rb.Bytes({0xFF, 0xE0, 0xC0, 0xA0});
+    rb.Bytes({0x01, 60, 0, 0x17});
+    rb.U32(2);
+    rb.Bytes({0, 2, 10, 3});
+    rb.Bytes({0x03, 60, 0, 0});
+    rb.Ptr(WAVE_POS);
+    rb.Bytes({0, 3, 9, 4});
+    rb.Bytes({0x04, 60, 0, 0});
+    rb.U32(0);
+    rb.Bytes({0, 1, 8, 1});
+
+    /* track 0: PCM melody with pitch bend */
+    const size_t track0 = 0x3000;
+    rb.Seek(track0);
+    rb.Bytes({0xBB, 75, 0xBD, 0, 0xBE, 100, 0xBF, 64});
+    const size_t track0Loop = rb.Tell();
+    rb.Bytes({0xD4, 60, 127, 0x8C, 62, 0x8C, 0xC0, 70, 0xE0, 64, 80, 0x90, 0xC0, 64, 0xD8, 67, 0x98});
+    rb.Bytes({0xB2});
+    rb.Ptr(track0Loop);
+
+    /* track 1: CGB instruments with LFO */
+    const size_t track1 = 0x3400;
+    rb.Seek(track1);
+    rb.Bytes({0xBE, 80, 0xBF, 40, 0xC2, 30, 0xC4, 20});
+    const size_t track1Loop = rb.Tell();
+    rb.Bytes({0xBD, 1, 0xDA, 60, 90, 0x8C, 0xBD, 2, 0xDA, 48, 0x8C, 0xBD, 3, 0xDA, 40, 0x8C, 0x90});
+    rb.Bytes({0xB2});
+    rb.Ptr(track1Loop);
+
+    rb.Seek(SONG_POS);
+    rb.Bytes({2, 0, 0, 0xC0 | 40});
+    rb.Ptr(VOICEGROUP_POS);
+    rb.Ptr(track0);
+    rb.Ptr(track1);
+
+    return rb.data;
+}
+
+static uint64_t hashBuffer(std::span<const sample> buffer, uint64_t hash)
+{
+    /* FNV-1a */
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(buffer.data());
+    for (size_t i = 0; i < buffer.size_bytes(); i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static uint64_t render(MP2KContext &ctx, size_t frames)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < frames; i++) {
+        ctx.m4aSoundMain();
+        hash = hashBuffer(ctx.masterAudioBuffer, hash);
+        for (const MP2KTrack &trk : ctx.players.at(0).tracks)
+            hash = hashBuffer(trk.audioBuffer, hash);
+    }
+    return hash;
+}
+
+static bool testRoundTrip(const Rom &rom, ReverbType reverbType, bool reverbBusMode)
+{
+    MP2KSoundMode mp2kSoundMode;
+    mp2kSoundMode.vol = 15;
+    mp2kSoundMode.freq = 4;
+    AgbplaySoundMode agbplaySoundMode;
+    agbplaySoundMode.reverbType = reverbType;
+    const SongTableInfo songTableInfo;
+    const PlayerTableInfo playerTableInfo{{8, 0}};
+
+    MP2KContext ctx(SAMPLERATE, 1, rom, mp2kSoundMode, agbplaySoundMode, songTableInfo, playerTableInfo);
+    ctx.mixer.SetReverbBusMode(reverbBusMode);
+    ctx.m4aMPlayStart(0, SONG_POS);
+
+    render(ctx, RENDER_A_FRAMES);
+    const std::vector<uint8_t> snapshot = ctx.Snapshot();
+    const uint64_t hashB = render(ctx, RENDER_B_FRAMES);
+
+    /* render some more to make sure nothing of the later state survives the restore */
+    render(ctx, RENDER_B_FRAMES);
+    ctx.Restore(snapshot);
+    const bool snapshotEqual = ctx.Snapshot() == snapshot;
+    const uint64_t hashRestored = render(ctx, RENDER_B_FRAMES);
+
+    /* restoring into a different context must give the same result */
+    MP2KContext ctx2(SAMPLERATE, 1, rom, mp2kSoundMode, agbplaySoundMode, songTableInfo, playerTableInfo);
+    ctx2.mixer.SetReverbBusMode(reverbBusMode);
+    ctx2.Restore(snapshot);
+    const uint64_t hashRestored2 = render(ctx2, RENDER_B_FRAMES);
+
+    /* snapshots must not be restored with a different configuration */
+    bool mismatchRejected = false;
+    MP2KContext ctx3(SAMPLERATE / 2, 1, rom, mp2kSoundMode, agbplaySoundMode, songTableInfo, playerTableInfo);
+    try {
+        ctx3.Restore(snapshot);
+    } catch (const Xcept &) {
+        mismatchRejected = true;
+    }
+
+    const bool ok = snapshotEqual && hashB == hashRestored && hashB == hashRestored2 && mismatchRejected;
+    fmt::print(
+        "reverb={} bus={} size={}: {} (B={:016x} restored={:016x} restored2={:016x}, snapshot equal={}, "
+        "mismatch rejected={})\n",
+        static_cast<int>(reverbType),
+        reverbBusMode,
+        snapshot.size(),
+        ok ? "OK" : "FAIL",
+        hashB,
+        hashRestored,
+        hashRestored2,
+        snapshotEqual,
+        mismatchRejected
+    );
+    return ok;
+}
+
+int main()
+{
+    std::vector<uint8_t> romData = buildRom();
+    const Rom rom = Rom::LoadFromBufferRef(romData);
+
+    int fails = 0;
+    for (ReverbType reverbType : {ReverbType::NORMAL, ReverbType::GS1, ReverbType::GS2}) {
+        for (bool reverbBusMode : {false, true}) {
+            if (!testRoundTrip(rom, reverbType, reverbBusMode))
+                fails++;
+        }
+    }
+
+    return fails == 0 ? 0 : 1;
+}